@@ -0,0 +1,141 @@
+#include "TreeGenerator.h"
+#include "MemoryFileSystem.h"
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <cmath>
+
+namespace {
+
+const QString kAlphabet = QStringLiteral("abcdefghijklmnopqrstuvwxyz0123456789");
+const QString kMixedAlphabet = QStringLiteral("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._- ");
+const QString kUnicodeAlphabet = QString::fromUtf8("abcdefxyzäöüßéèçñøåæœдлявгжзйкφψωλ日本語中文한국어");
+
+// Names the scanner must recognize, in the shapes they appear in real home directories
+const QStringList kCacheNames = {
+    QStringLiteral("cache"), QStringLiteral(".cache"), QStringLiteral("Cache"),
+    QStringLiteral("GPUCache"), QStringLiteral("Code Cache"), QStringLiteral("cache2"),
+    QStringLiteral("ShaderCache"), QStringLiteral("caches")
+};
+
+}
+
+TreeGenerator::TreeGenerator(const Spec &spec)
+    : m_spec(spec), m_random(spec.seed) {
+}
+
+bool TreeGenerator::generate(const QString &root, Stats &stats) {
+    m_random.seed(m_spec.seed);
+    stats = Stats();
+    return fillDirectory(root, 0, false, stats);
+}
+
+bool TreeGenerator::fillDirectory(const QString &path, int level, bool inCache, Stats &stats) {
+    const int files = m_spec.filesPerDir > 0
+        ? m_random.bounded(m_spec.filesPerDir / 2, m_spec.filesPerDir + m_spec.filesPerDir / 2 + 1)
+        : 0;
+    for (int i = 0; i < files; ++i) {
+        const quint64 size = m_spec.fileSize > 0 ? m_random.generate64() % (2 * m_spec.fileSize + 1) : 0;
+        if (!createFile(path + '/' + randomName(i) + ".dat", size)) return false;
+        ++stats.files;
+        stats.bytes += size;
+        if (inCache) {
+            ++stats.cacheFiles;
+            stats.cacheBytes += size;
+        }
+    }
+
+    const int maxLevel = inCache ? m_spec.cacheDepth : m_spec.depth;
+    if (level >= maxLevel) return true;
+
+    QDir dir(path);
+    for (int i = 0; i < m_spec.fanOut; ++i) {
+        const bool isCache = !inCache && m_random.generateDouble() < m_spec.cacheDensity;
+        const QString name = isCache ? cacheName(i) : randomName(i);
+        if (m_memory ? !m_memory->addDirectory(path + '/' + name) : !dir.mkdir(name)) return false;
+
+        ++stats.dirs;
+        if (isCache) ++stats.caches;
+        if (isCache || inCache) ++stats.cacheDirs;
+
+        // A cache starts its own, shallower subtree
+        if (!fillDirectory(path + '/' + name, isCache ? 0 : level + 1, inCache || isCache, stats)) return false;
+
+        // Drawn only when asked for, so trees without denied directories stay the same per seed
+        if (m_memory && m_spec.deniedDensity > 0 && m_random.generateDouble() < m_spec.deniedDensity) {
+            m_memory->setDenied(path + '/' + name);
+            ++stats.deniedDirs;
+        }
+    }
+    return true;
+}
+
+bool TreeGenerator::createFile(const QString &path, quint64 size) {
+    if (m_memory) return m_memory->addFile(path, size);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    if (m_spec.sparse) return file.resize(static_cast<qint64>(size));
+
+    QByteArray block(64 * 1024, 'x');
+    for (quint64 written = 0; written < size;) {
+        const qint64 chunk = static_cast<qint64>(qMin<quint64>(block.size(), size - written));
+        if (file.write(block.constData(), chunk) != chunk) return false;
+        written += static_cast<quint64>(chunk);
+    }
+    return true;
+}
+
+// The index suffix keeps names unique within a directory whatever the random part is
+QString TreeGenerator::randomName(int index) {
+    const QString *alphabet = &kAlphabet;
+    int length = 8;
+    switch (m_spec.names) {
+    case NameStyle::Short:
+        break;
+    case NameStyle::Long:
+        length = m_random.bounded(40, 81);
+        break;
+    case NameStyle::Mixed:
+        alphabet = &kMixedAlphabet;
+        // Mostly short names with a long tail, roughly like a real home directory
+        length = 1 + qMin(63, static_cast<int>(-8.0 * std::log(1.0 - m_random.generateDouble())));
+        break;
+    case NameStyle::Unicode:
+        alphabet = &kUnicodeAlphabet;
+        length = m_random.bounded(4, 25);
+        break;
+    }
+
+    QString name;
+    name.reserve(length + 6);
+    for (int i = 0; i < length; ++i) {
+        name.append(alphabet->at(m_random.bounded(0, static_cast<int>(alphabet->size()))));
+    }
+    // Leading/trailing spaces are legal but only make the output awkward to read
+    return name.trimmed() + '-' + QString::number(index);
+}
+
+QString TreeGenerator::cacheName(int index) {
+    const QString &base = kCacheNames.at(m_random.bounded(0, static_cast<int>(kCacheNames.size())));
+    return index == 0 ? base : base + '-' + QString::number(index);
+}
+
+bool TreeGenerator::parseNameStyle(const QString &text, NameStyle &style) {
+    const QString lower = text.toLower();
+    if (lower == "short") style = NameStyle::Short;
+    else if (lower == "long") style = NameStyle::Long;
+    else if (lower == "mixed") style = NameStyle::Mixed;
+    else if (lower == "unicode") style = NameStyle::Unicode;
+    else return false;
+    return true;
+}
+
+QString TreeGenerator::nameStyleName(NameStyle style) {
+    switch (style) {
+    case NameStyle::Short: return "short";
+    case NameStyle::Long: return "long";
+    case NameStyle::Mixed: return "mixed";
+    case NameStyle::Unicode: return "unicode";
+    }
+    return QString();
+}
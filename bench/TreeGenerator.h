@@ -0,0 +1,72 @@
+#ifndef TREEGENERATOR_H
+#define TREEGENERATOR_H
+
+#include <QRandomGenerator>
+#include <QString>
+
+class MemoryFileSystem;
+
+/*
+ * Builds reproducible synthetic directory trees for benchmarking.
+ * The same spec and seed always produce the same names, file counts and sizes.
+ *
+ * Every directory above `depth` gets `fanOut` subdirectories; each of them is a
+ * cache folder with probability `cacheDensity`. Cache folders get their own
+ * subtree of `cacheDepth` levels and are not expanded further, like the scanner
+ * treats them. Files are sparse by default (truncated, no data written), so large
+ * trees are cheap to create and the benchmark measures metadata work.
+ *
+ * With a MemoryFileSystem as the target the same tree is built there instead, and
+ * each new directory is denied with probability `deniedDensity`.
+ */
+class TreeGenerator {
+public:
+    enum class NameStyle { Short, Long, Mixed, Unicode };
+
+    struct Spec {
+        quint32 seed = 1;
+        int fanOut = 4;
+        int depth = 5;
+        int filesPerDir = 8;         // actual count varies in [n/2, 3n/2]
+        quint64 fileSize = 4096;     // actual size varies in [0, 2 * fileSize]
+        NameStyle names = NameStyle::Mixed;
+        double cacheDensity = 0.05;
+        int cacheDepth = 2;
+        bool sparse = true;
+        double deniedDensity = 0;    // memory targets only
+    };
+
+    struct Stats {
+        quint64 dirs = 0;
+        quint64 files = 0;
+        quint64 bytes = 0;
+        quint64 caches = 0;
+        quint64 cacheDirs = 0;       // inside caches, cache roots included
+        quint64 cacheFiles = 0;
+        quint64 cacheBytes = 0;
+        quint64 deniedDirs = 0;
+    };
+
+    explicit TreeGenerator(const Spec &spec);
+
+    // Not owned; null creates the tree on disk
+    void setTarget(MemoryFileSystem *memory) { m_memory = memory; }
+
+    // Creates the tree below `root`, which must exist and be empty
+    bool generate(const QString &root, Stats &stats);
+
+    static bool parseNameStyle(const QString &text, NameStyle &style);
+    static QString nameStyleName(NameStyle style);
+
+private:
+    Spec m_spec;
+    QRandomGenerator m_random;
+    MemoryFileSystem *m_memory = nullptr;
+
+    bool fillDirectory(const QString &path, int level, bool inCache, Stats &stats);
+    bool createFile(const QString &path, quint64 size);
+    QString randomName(int index);
+    QString cacheName(int index);
+};
+
+#endif // TREEGENERATOR_H
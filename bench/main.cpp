@@ -0,0 +1,413 @@
+#include "TreeGenerator.h"
+#include "CacheScanner.h"
+#include "DeletionService.h"
+#include "DirectorySizer.h"
+#include "MemoryFileSystem.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/*
+ * Benchmark driver: generates a synthetic tree, then times the scanner, the size
+ * calculator (both backends) and deletion against it and prints one JSON document.
+ * Every run regenerates the tree when the previous run deleted it. Results are
+ * warm-cache numbers; peak RSS is the process-wide peak at the end of each phase.
+ *
+ * With --memory the tree lives in a MemoryFileSystem instead, optionally with a
+ * per-call latency and denied directories, so runs measure the scanner's own
+ * overhead and behave the same on every machine.
+ */
+
+namespace {
+
+struct PhaseResult {
+    QString phase;
+    int run = 0;
+    double seconds = 0;
+    quint64 dirs = 0;
+    quint64 files = 0;
+    quint64 bytes = 0;
+    qint64 peakRssKb = 0;
+};
+
+qint64 peakRssKb() {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return -1;
+    return static_cast<qint64>(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef Q_OS_DARWIN
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+double rate(quint64 count, double seconds) {
+    return seconds > 0 ? count / seconds : 0.0;
+}
+
+QJsonObject toJson(const PhaseResult &result) {
+    QJsonObject object;
+    object["phase"] = result.phase;
+    object["run"] = result.run;
+    object["seconds"] = result.seconds;
+    object["dirs"] = static_cast<qint64>(result.dirs);
+    object["files"] = static_cast<qint64>(result.files);
+    object["bytes"] = static_cast<qint64>(result.bytes);
+    object["dirs_per_sec"] = rate(result.dirs, result.seconds);
+    object["files_per_sec"] = rate(result.files, result.seconds);
+    object["bytes_per_sec"] = rate(result.bytes, result.seconds);
+    object["peak_rss_kb"] = result.peakRssKb;
+    return object;
+}
+
+PhaseResult runScan(const QString &root, int threads, const FileSystem *fs, const TreeGenerator::Stats &tree) {
+    CacheScanner scanner(root, 0);
+    scanner.setThreadCount(threads);
+    scanner.setFileSystem(fs);
+
+    // Signals arrive on scanner threads; the last snapshot is the final, forced one
+    QMutex mutex;
+    ScanProgress last;
+    QObject::connect(&scanner, &CacheScanner::progress, [&](const ScanProgress &snapshot) {
+        QMutexLocker locker(&mutex);
+        last = snapshot;
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    scanner.start();
+    scanner.wait();
+
+    PhaseResult result;
+    result.phase = "scan";
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.dirs = last.dirsVisited;
+    result.files = tree.cacheFiles; // only files inside caches are stat'ed
+    result.bytes = last.bytesFound;
+    return result;
+}
+
+// Stops scans after 0, 1, 3, ... 127 ms; seconds is the slowest stop() to finished thread
+PhaseResult runCancel(const QString &root, int threads, const FileSystem *fs) {
+    constexpr int kAttempts = 8;
+    PhaseResult result;
+    result.phase = "cancel";
+    for (int attempt = 0; attempt < kAttempts; ++attempt) {
+        CacheScanner scanner(root, 0);
+        scanner.setThreadCount(threads);
+        scanner.setFileSystem(fs);
+        scanner.start();
+        QThread::msleep((1u << attempt) - 1);
+
+        QElapsedTimer timer;
+        timer.start();
+        scanner.stop();
+        scanner.wait();
+        result.seconds = qMax(result.seconds, timer.nsecsElapsed() / 1e9);
+    }
+    return result;
+}
+
+PhaseResult runSize(const QString &root, DirectorySizer::Backend backend, unsigned queueDepth,
+                    const FileSystem *fs, const TreeGenerator::Stats &tree) {
+    DirectorySizer sizer(backend);
+    sizer.setQueueDepth(queueDepth);
+    sizer.setFileSystem(fs);
+
+    QElapsedTimer timer;
+    timer.start();
+    const quint64 size = sizer.calculate(root);
+
+    PhaseResult result;
+    result.phase = fs ? QStringLiteral("size_memory") : QStringLiteral("size_") + DirectorySizer::backendName(backend);
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.dirs = tree.dirs;
+    result.files = tree.files;
+    result.bytes = size;
+    return result;
+}
+
+// Native walk with inode bookkeeping; bytes is the allocated total
+PhaseResult runMeasure(const QString &root, const TreeGenerator::Stats &tree) {
+    DirectorySizer sizer(DirectorySizer::Backend::Native);
+
+    QElapsedTimer timer;
+    timer.start();
+    const DirectorySizer::Usage usage = sizer.measure(root);
+
+    PhaseResult result;
+    result.phase = "size_allocated";
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.dirs = tree.dirs;
+    result.files = tree.files;
+    result.bytes = usage.allocatedBytes;
+    return result;
+}
+
+// Full size tree with the default backend; peak RSS shows what the nodes cost
+PhaseResult runTree(const QString &root, const FileSystem *fs, const TreeGenerator::Stats &tree) {
+    DirectorySizer sizer;
+    sizer.setFileSystem(fs);
+
+    QElapsedTimer timer;
+    timer.start();
+    const std::shared_ptr<SizeTree> sizeTree = sizer.buildTree(root);
+
+    PhaseResult result;
+    result.phase = "size_tree";
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.dirs = tree.dirs;
+    result.files = tree.files;
+    result.bytes = sizeTree->node(sizeTree->root()).sizeBytes;
+    return result;
+}
+
+PhaseResult runDelete(const QString &root, int threads, FileSystem *fs, const TreeGenerator::Stats &tree) {
+    DeletionService service;
+    service.setThreadCount(threads);
+    service.setFileSystem(fs);
+
+    DeletionResult outcome;
+    QEventLoop loop;
+    QObject::connect(&service, &DeletionService::pathFinished, &loop, [&](const DeletionResult &result) { outcome = result; });
+    QObject::connect(&service, &DeletionService::finished, &loop, &QEventLoop::quit);
+
+    QElapsedTimer timer;
+    timer.start();
+    service.start({root});
+    loop.exec();
+
+    PhaseResult result;
+    result.phase = "delete";
+    result.seconds = timer.nsecsElapsed() / 1e9;
+    result.dirs = tree.dirs;
+    result.files = outcome.filesFreed;
+    result.bytes = outcome.bytesFreed;
+    if (!outcome.success) std::fprintf(stderr, "delete failed: %s\n", qPrintable(outcome.error));
+    return result;
+}
+
+QJsonObject median(QList<PhaseResult> results) {
+    std::sort(results.begin(), results.end(),
+              [](const PhaseResult &a, const PhaseResult &b) { return a.seconds < b.seconds; });
+    QJsonObject object = toJson(results.at(results.size() / 2));
+    object.remove("run");
+    return object;
+}
+
+int usageError(const QString &message) {
+    std::fprintf(stderr, "%s\n", qPrintable(message));
+    return 2;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("DFCacheBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates a synthetic tree and benchmarks scanning, sizing and deletion on it.");
+    parser.addHelpOption();
+
+    QCommandLineOption seedOption("seed", "Random seed of the generated tree.", "n", "1");
+    QCommandLineOption fanOutOption("fanout", "Subdirectories per directory.", "n", "4");
+    QCommandLineOption depthOption("depth", "Directory levels below the root.", "n", "5");
+    QCommandLineOption filesOption("files", "Average files per directory.", "n", "8");
+    QCommandLineOption fileSizeOption("file-size", "Average file size in bytes.", "bytes", "4096");
+    QCommandLineOption namesOption("names", "Name distribution: short, long, mixed or unicode.", "style", "mixed");
+    QCommandLineOption cacheDensityOption("cache-density", "Probability that a new directory is a cache folder.", "p", "0.05");
+    QCommandLineOption cacheDepthOption("cache-depth", "Directory levels inside each cache folder.", "n", "2");
+    QCommandLineOption denseOption("dense", "Write file contents instead of creating sparse files.");
+    QCommandLineOption threadsOption({"j", "threads"}, "Worker threads, 0 = one per core.", "count", "0");
+    QCommandLineOption runsOption("runs", "Repetitions of every phase.", "n", "3");
+    QCommandLineOption phasesOption("phases", "Comma-separated phases: scan, cancel, size, delete.", "list", "scan,size,delete");
+    QCommandLineOption dirOption("dir", "Parent directory for the generated tree (default: system temp).", "path");
+    QCommandLineOption queueDepthOption("queue-depth", "Operations per io_uring batch in the size_uring phase.", "n",
+                                        QString::number(DirectorySizer::kDefaultQueueDepth));
+    QCommandLineOption labelOption("label", "Free text copied into the output, e.g. a commit hash.", "text");
+    QCommandLineOption memoryOption("memory", "Build the tree in memory instead of on disk.");
+    QCommandLineOption latencyOption("latency", "With --memory: delay of every list, stat and remove call.", "us", "0");
+    QCommandLineOption jitterOption("jitter", "With --memory: random extra delay, up to this much.", "us", "0");
+    QCommandLineOption deniedOption("denied", "With --memory: probability that a directory is unreadable.", "p", "0");
+    parser.addOptions({seedOption, fanOutOption, depthOption, filesOption, fileSizeOption, namesOption,
+                       cacheDensityOption, cacheDepthOption, denseOption, threadsOption, runsOption,
+                       phasesOption, dirOption, queueDepthOption, labelOption, memoryOption, latencyOption,
+                       jitterOption, deniedOption});
+    parser.process(app);
+
+    TreeGenerator::Spec spec;
+    spec.seed = parser.value(seedOption).toUInt();
+    spec.fanOut = parser.value(fanOutOption).toInt();
+    spec.depth = parser.value(depthOption).toInt();
+    spec.filesPerDir = parser.value(filesOption).toInt();
+    spec.fileSize = parser.value(fileSizeOption).toULongLong();
+    spec.cacheDensity = parser.value(cacheDensityOption).toDouble();
+    spec.cacheDepth = parser.value(cacheDepthOption).toInt();
+    spec.sparse = !parser.isSet(denseOption);
+    spec.deniedDensity = parser.value(deniedOption).toDouble();
+    if (!TreeGenerator::parseNameStyle(parser.value(namesOption), spec.names)) {
+        return usageError("Invalid --names: " + parser.value(namesOption));
+    }
+    if (spec.fanOut < 0 || spec.depth < 0 || spec.filesPerDir < 0 || spec.cacheDepth < 0) {
+        return usageError("Tree dimensions must not be negative.");
+    }
+    const bool inMemory = parser.isSet(memoryOption);
+    if (!inMemory && (parser.isSet(latencyOption) || parser.isSet(jitterOption) || parser.isSet(deniedOption))) {
+        return usageError("--latency, --jitter and --denied need --memory.");
+    }
+    const int latencyUs = qMax(0, parser.value(latencyOption).toInt());
+    const int jitterUs = qMax(0, parser.value(jitterOption).toInt());
+
+    const int threads = qMax(0, parser.value(threadsOption).toInt());
+    const int runs = qMax(1, parser.value(runsOption).toInt());
+    const unsigned queueDepth = qBound(1u, parser.value(queueDepthOption).toUInt(), 4096u);
+    const QStringList phases = parser.value(phasesOption).split(',', Qt::SkipEmptyParts);
+
+    std::unique_ptr<QTemporaryDir> tempDir;
+    std::unique_ptr<MemoryFileSystem> memory;
+    QString root;
+    if (inMemory) {
+        root = MemoryFileSystem().rootPath() + "/tree";
+    } else {
+        tempDir = parser.isSet(dirOption)
+            ? std::make_unique<QTemporaryDir>(parser.value(dirOption) + "/dfcache-bench-XXXXXX")
+            : std::make_unique<QTemporaryDir>();
+        if (!tempDir->isValid()) return usageError("Cannot create a temporary directory: " + tempDir->errorString());
+        root = tempDir->path() + "/tree";
+    }
+
+    TreeGenerator generator(spec);
+    TreeGenerator::Stats tree;
+    quint64 memoryBytes = 0;
+    QJsonArray generateRuns;
+    QList<PhaseResult> results;
+    bool haveTree = false;
+
+    for (int run = 1; run <= runs; ++run) {
+        if (!haveTree) {
+            QElapsedTimer timer;
+            timer.start();
+            // A fresh file system per tree, so deleted entries do not linger in the pools
+            if (inMemory) {
+                memory = std::make_unique<MemoryFileSystem>();
+                memory->setLatency(latencyUs, jitterUs, spec.seed);
+                generator.setTarget(memory.get());
+            }
+            if (!(inMemory ? memory->addDirectory(root) : QDir().mkpath(root)) || !generator.generate(root, tree)) {
+                std::fprintf(stderr, "Failed to generate the tree below %s\n", qPrintable(root));
+                return 1;
+            }
+            generateRuns.append(timer.nsecsElapsed() / 1e9);
+            if (memory) memoryBytes = memory->memoryBytes();
+            haveTree = true;
+        }
+
+        auto record = [&](PhaseResult result) {
+            result.run = run;
+            result.peakRssKb = peakRssKb();
+            results.append(result);
+        };
+
+        if (phases.contains("scan")) record(runScan(root, threads, memory.get(), tree));
+        if (phases.contains("cancel")) record(runCancel(root, threads, memory.get()));
+        if (phases.contains("size")) {
+            if (inMemory) {
+                // The backends only differ in how they read a real disk
+                record(runSize(root, DirectorySizer::Backend::QtIterator, queueDepth, memory.get(), tree));
+            } else {
+                if (DirectorySizer::isNativeAvailable()) {
+                    record(runSize(root, DirectorySizer::Backend::Native, queueDepth, nullptr, tree));
+                    record(runMeasure(root, tree));
+                }
+                // Skipped rather than silently measured as native when the kernel has no io_uring
+                if (DirectorySizer::isIoUringAvailable()) record(runSize(root, DirectorySizer::Backend::IoUring, queueDepth, nullptr, tree));
+                record(runSize(root, DirectorySizer::Backend::QtIterator, queueDepth, nullptr, tree));
+            }
+            record(runTree(root, memory.get(), tree));
+        }
+        if (phases.contains("delete")) {
+            record(runDelete(root, threads, memory.get(), tree));
+            haveTree = false;
+        }
+    }
+
+    QJsonObject specJson;
+    specJson["seed"] = static_cast<qint64>(spec.seed);
+    specJson["fanout"] = spec.fanOut;
+    specJson["depth"] = spec.depth;
+    specJson["files"] = spec.filesPerDir;
+    specJson["file_size"] = static_cast<qint64>(spec.fileSize);
+    specJson["names"] = TreeGenerator::nameStyleName(spec.names);
+    specJson["cache_density"] = spec.cacheDensity;
+    specJson["cache_depth"] = spec.cacheDepth;
+    specJson["sparse"] = spec.sparse;
+    if (inMemory) {
+        specJson["latency_us"] = latencyUs;
+        specJson["jitter_us"] = jitterUs;
+        specJson["denied_density"] = spec.deniedDensity;
+    }
+
+    QJsonObject treeJson;
+    treeJson["dirs"] = static_cast<qint64>(tree.dirs);
+    treeJson["files"] = static_cast<qint64>(tree.files);
+    treeJson["bytes"] = static_cast<qint64>(tree.bytes);
+    treeJson["caches"] = static_cast<qint64>(tree.caches);
+    treeJson["cache_dirs"] = static_cast<qint64>(tree.cacheDirs);
+    treeJson["cache_files"] = static_cast<qint64>(tree.cacheFiles);
+    treeJson["cache_bytes"] = static_cast<qint64>(tree.cacheBytes);
+    treeJson["denied_dirs"] = static_cast<qint64>(tree.deniedDirs);
+    if (inMemory) treeJson["memory_bytes"] = static_cast<qint64>(memoryBytes);
+    treeJson["generate_seconds"] = generateRuns;
+
+    QJsonArray runsJson;
+    QHash<QString, QList<PhaseResult>> byPhase;
+    QStringList phaseOrder;
+    for (const PhaseResult &result : results) {
+        runsJson.append(toJson(result));
+        if (!byPhase.contains(result.phase)) phaseOrder.append(result.phase);
+        byPhase[result.phase].append(result);
+    }
+
+    QJsonObject medians;
+    for (const QString &phase : phaseOrder) medians[phase] = median(byPhase.value(phase));
+
+    QJsonObject output;
+    output["label"] = parser.value(labelOption);
+    output["threads"] = threads > 0 ? threads : QThread::idealThreadCount();
+    output["queue_depth"] = static_cast<int>(queueDepth);
+    output["io_uring"] = DirectorySizer::isIoUringAvailable();
+    output["filesystem"] = inMemory ? "memory" : "disk";
+    output["spec"] = specJson;
+    output["tree"] = treeJson;
+    output["runs"] = runsJson;
+    output["median"] = medians;
+
+    const QByteArray json = QJsonDocument(output).toJson(QJsonDocument::Indented);
+    std::fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+    return 0;
+}
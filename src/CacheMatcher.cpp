@@ -0,0 +1,245 @@
+#include "CacheMatcher.h"
+#include <array>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DFCACHE_MATCHER_SSE2
+#endif
+
+namespace {
+
+inline char16_t fold(char16_t c) {
+    if (c < 0x80) return (c >= u'A' && c <= u'Z') ? char16_t(c | 0x20) : c;
+    return static_cast<char16_t>(QChar::toCaseFolded(static_cast<char32_t>(c)));
+}
+
+// Whether a non-ASCII unit folds to the ASCII character `c`, like U+212A KELVIN SIGN
+// to 'k' and U+017F LONG S to 's'; the table is built from the case data once
+bool foldsFromNonAscii(char16_t c) {
+    static const std::array<bool, 0x80> table = [] {
+        std::array<bool, 0x80> folds{};
+        for (char32_t u = 0x80; u <= 0xFFFF; ++u) {
+            const char16_t folded = fold(static_cast<char16_t>(u));
+            if (folded < 0x80) folds[folded] = true;
+        }
+        return folds;
+    }();
+    return c < 0x80 && table[c];
+}
+
+QString foldString(QStringView text) {
+    QString folded;
+    folded.reserve(text.size());
+    for (QChar c : text) folded.append(QChar(fold(c.unicode())));
+    return folded;
+}
+
+inline bool isGlob(QStringView text) {
+    return text.contains(u'*') || text.contains(u'?') || text.contains(u'[');
+}
+
+// Last path component and everything before it, for '/' and (on Windows) '\' separators
+inline qsizetype lastSeparator(QStringView path) {
+    for (qsizetype i = path.size() - 1; i >= 0; --i) {
+        if (path[i] == u'/' || path[i] == u'\\') return i;
+    }
+    return -1;
+}
+
+}
+
+QStringList CacheMatcher::defaultPatterns() {
+    return {QStringLiteral("cache")};
+}
+
+CacheMatcher::CacheMatcher(const QStringList &patterns)
+    : m_patterns(patterns) {
+    for (const QString &raw : patterns) {
+        const QString pattern = raw.trimmed();
+        if (pattern.isEmpty()) continue;
+
+        if (pattern.contains(u'/')) {
+            std::vector<Component> components;
+            for (const QString &part : pattern.split(u'/', Qt::SkipEmptyParts)) {
+                components.push_back({foldString(part), isGlob(part)});
+            }
+            if (!components.empty()) m_tails.push_back(std::move(components));
+        } else if (pattern.startsWith(u'=')) {
+            if (pattern.size() > 1) m_exactNames.push_back(foldString(QStringView(pattern).mid(1)));
+        } else if (isGlob(pattern)) {
+            m_globs.push_back(foldString(pattern));
+        } else {
+            Substring needle;
+            needle.folded = foldString(pattern);
+            needle.first = needle.folded.at(0).unicode();
+            needle.firstUpper = (needle.first >= u'a' && needle.first <= u'z') ? char16_t(needle.first & ~0x20) : needle.first;
+            // Case variants outside ASCII, of non-ASCII first characters and of 'k' and 's',
+            // would be missed by the two-way compare
+            needle.vectorizable = needle.first < 0x80 && !foldsFromNonAscii(needle.first);
+            m_substrings.push_back(needle);
+        }
+    }
+}
+
+bool CacheMatcher::isEmpty() const {
+    return m_substrings.empty() && m_exactNames.empty() && m_globs.empty() && m_tails.empty();
+}
+
+bool CacheMatcher::matches(QStringView name, QStringView parentPath) const {
+    for (const Substring &needle : m_substrings) {
+        if (containsFolded(name, needle)) return true;
+    }
+    for (const QString &exact : m_exactNames) {
+        if (equalsFolded(name, exact)) return true;
+    }
+    for (const QString &glob : m_globs) {
+        if (globMatch(name, glob)) return true;
+    }
+
+    for (const std::vector<Component> &tail : m_tails) {
+        if (!matchComponent(name, tail.back())) continue;
+
+        QStringView rest = parentPath;
+        bool matched = true;
+        for (auto it = tail.rbegin() + 1; it != tail.rend(); ++it) {
+            const qsizetype sep = lastSeparator(rest);
+            const QStringView component = rest.mid(sep + 1);
+            if (component.isEmpty() || !matchComponent(component, *it)) {
+                matched = false;
+                break;
+            }
+            rest = sep >= 0 ? rest.left(sep) : QStringView();
+        }
+        if (matched) return true;
+    }
+    return false;
+}
+
+bool CacheMatcher::matchesPath(QStringView path) const {
+    const qsizetype sep = lastSeparator(path);
+    return sep < 0 ? matches(path) : matches(path.mid(sep + 1), path.left(sep));
+}
+
+/*
+ * Finds candidate positions by the needle's first character (both ASCII cases,
+ * eight UTF-16 units at a time) and verifies the rest with folded compares.
+ */
+bool CacheMatcher::containsFolded(QStringView haystack, const Substring &needle) {
+    const qsizetype n = haystack.size();
+    const qsizetype m = needle.folded.size();
+    if (m > n) return false;
+
+    const char16_t *h = reinterpret_cast<const char16_t *>(haystack.utf16());
+    const char16_t *p = reinterpret_cast<const char16_t *>(needle.folded.utf16());
+    const qsizetype last = n - m; // last valid start position
+
+    auto verify = [&](qsizetype start) {
+        for (qsizetype j = 1; j < m; ++j) {
+            if (fold(h[start + j]) != p[j]) return false;
+        }
+        return true;
+    };
+
+    qsizetype i = 0;
+#ifdef DFCACHE_MATCHER_SSE2
+    if (needle.vectorizable) {
+        const __m128i lower = _mm_set1_epi16(static_cast<short>(needle.first));
+        const __m128i upper = _mm_set1_epi16(static_cast<short>(needle.firstUpper));
+        for (; i + 8 <= last + 1; i += 8) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + i));
+            const __m128i hits = _mm_or_si128(_mm_cmpeq_epi16(chunk, lower), _mm_cmpeq_epi16(chunk, upper));
+            // Two mask bits per 16-bit lane; keep one
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits)) & 0x5555u;
+            while (mask) {
+                const int bit = std::countr_zero(mask);
+                if (verify(i + bit / 2)) return true;
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        if (fold(h[i]) == needle.first && verify(i)) return true;
+    }
+    return false;
+}
+
+bool CacheMatcher::equalsFolded(QStringView text, QStringView folded) {
+    if (text.size() != folded.size()) return false;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        if (fold(text[i].unicode()) != folded[i].unicode()) return false;
+    }
+    return true;
+}
+
+// Iterative wildcard match; a '*' only ever needs the most recent backtrack point
+bool CacheMatcher::globMatch(QStringView text, QStringView pattern) {
+    qsizetype t = 0, p = 0;
+    qsizetype starP = -1, starT = 0;
+
+    auto matchClass = [&](qsizetype &pos, char16_t c) {
+        // pos is at '['; on success it moves past ']'
+        qsizetype i = pos + 1;
+        const bool negate = i < pattern.size() && (pattern[i] == u'!' || pattern[i] == u'^');
+        if (negate) ++i;
+        bool found = false;
+        const qsizetype first = i;
+        for (; i < pattern.size() && (pattern[i] != u']' || i == first); ++i) {
+            const char16_t lo = pattern[i].unicode();
+            if (i + 2 < pattern.size() && pattern[i + 1] == u'-' && pattern[i + 2] != u']') {
+                found |= c >= lo && c <= pattern[i + 2].unicode();
+                i += 2;
+            } else {
+                found |= c == lo;
+            }
+        }
+        if (i >= pattern.size()) return -1; // unterminated: '[' is a literal
+        pos = i + 1;
+        return found != negate ? 1 : 0;
+    };
+
+    while (t < text.size()) {
+        const char16_t c = fold(text[t].unicode());
+        if (p < pattern.size()) {
+            const char16_t pc = pattern[p].unicode();
+            if (pc == u'*') {
+                starP = p++;
+                starT = t;
+                continue;
+            }
+            if (pc == u'?') {
+                ++p;
+                ++t;
+                continue;
+            }
+            if (pc == u'[') {
+                qsizetype next = p;
+                const int result = matchClass(next, c);
+                if (result == 1) {
+                    p = next;
+                    ++t;
+                    continue;
+                }
+                if (result == -1 && c == u'[') {
+                    ++p;
+                    ++t;
+                    continue;
+                }
+            } else if (pc == c) {
+                ++p;
+                ++t;
+                continue;
+            }
+        }
+        if (starP < 0) return false;
+        p = starP + 1;
+        t = ++starT;
+    }
+    while (p < pattern.size() && pattern[p] == u'*') ++p;
+    return p == pattern.size();
+}
+
+bool CacheMatcher::matchComponent(QStringView text, const Component &component) {
+    return component.glob ? globMatch(text, component.folded) : equalsFolded(text, component.folded);
+}
@@ -0,0 +1,61 @@
+#ifndef CACHEMATCHER_H
+#define CACHEMATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <vector>
+
+/*
+ * Decides which folder names are caches. Patterns are compiled once; matching
+ * is case-insensitive and does not allocate.
+ *
+ *   cache                   substring of the folder name
+ *   =__pycache__            exact folder name
+ *   *.cache, cache-?        glob on the folder name (*, ?, [abc], [a-z], [!x])
+ *   .gradle/caches          path tail: the folder and its parents, last component
+ *   node_modules/.cache     first; each component exact or glob
+ *
+ * Substrings use an SSE2 scan for the needle's first character where available.
+ * Case folding is per UTF-16 unit, which is exact for everything but a handful
+ * of characters outside the BMP.
+ */
+class CacheMatcher {
+public:
+    static QStringList defaultPatterns();
+
+    explicit CacheMatcher(const QStringList &patterns = defaultPatterns());
+
+    // Empty patterns are ignored; a matcher without any rule matches nothing
+    bool isEmpty() const;
+    const QStringList &patterns() const { return m_patterns; }
+
+    // `parentPath` is only consulted by path-tail patterns
+    bool matches(QStringView name, QStringView parentPath = QStringView()) const;
+    bool matchesPath(QStringView path) const;
+
+private:
+    struct Substring {
+        QString folded;
+        char16_t first = 0;
+        char16_t firstUpper = 0; // == first unless it is an ASCII letter
+        bool vectorizable = false;
+    };
+    struct Component {
+        QString folded;
+        bool glob = false;
+    };
+
+    QStringList m_patterns;
+    std::vector<Substring> m_substrings;
+    std::vector<QString> m_exactNames;
+    std::vector<QString> m_globs;
+    std::vector<std::vector<Component>> m_tails; // components in path order
+
+    static bool containsFolded(QStringView haystack, const Substring &needle);
+    static bool equalsFolded(QStringView text, QStringView folded);
+    static bool globMatch(QStringView text, QStringView pattern);
+    static bool matchComponent(QStringView text, const Component &component);
+};
+
+#endif // CACHEMATCHER_H
@@ -1,85 +1,646 @@
 #include "CacheScanner.h"
+#include "IoThrottle.h"
+#include "ScanHistory.h"
+#include "ScanMetrics.h"
+#include "StagingPurger.h"
+#include <QDataStream>
+#include <QDateTime>
 #include <QDirIterator>
+#include <QElapsedTimer>
 #include <QDebug>
+#include <QSaveFile>
 
 CacheScanner::CacheScanner(const QString &rootPath, quint64 minSizeBytes, QObject *parent)
-    : QThread(parent), m_rootPath(rootPath), m_minSizeBytes(minSizeBytes), m_stopRequested(false) {
+    : QThread(parent), m_rootPath(rootPath), m_minSizeBytes(minSizeBytes), m_threadCount(0),
+      m_sizeBackend(DirectorySizer::Backend::Auto), m_queueDepth(DirectorySizer::kDefaultQueueDepth), m_accounting(DirectorySizer::Accounting::Apparent),
+      m_buildTrees(false), m_stopRequested(false),
+      m_oneFileSystem(false), m_perDeviceLimit(0), m_pendingDirs(0),
+      m_pauseRequested(false), m_liveWorkers(0), m_parkedWorkers(0),
+      m_checkpointIntervalNs(60LL * 1000 * 1000 * 1000), m_checkpointing(false), m_nextCheckpointNs(0) {
 }
 
 void CacheScanner::stop() {
+    QMutexLocker locker(&m_pauseMutex);
     m_stopRequested = true;
+    m_pauseCondition.wakeAll();
+}
+
+void CacheScanner::pause() {
+    m_pauseRequested = true;
+}
+
+void CacheScanner::resume() {
+    QMutexLocker locker(&m_pauseMutex);
+    m_pauseRequested = false;
+    m_pauseCondition.wakeAll();
+}
+
+void CacheScanner::setThreadCount(int count) {
+    m_threadCount = qMax(0, count);
+}
+
+void CacheScanner::setSizeBackend(DirectorySizer::Backend backend) {
+    m_sizeBackend = backend;
+}
+
+void CacheScanner::setQueueDepth(unsigned depth) {
+    m_queueDepth = qMax(1u, depth);
+}
+
+void CacheScanner::setAccounting(DirectorySizer::Accounting accounting) {
+    m_accounting = accounting;
+}
+
+void CacheScanner::setBuildTrees(bool enabled) {
+    m_buildTrees = enabled;
+}
+
+int CacheScanner::threadCount() const {
+    return m_threadCount > 0 ? m_threadCount : qMax(1, QThread::idealThreadCount());
+}
+
+void CacheScanner::setIndexPath(const QString &indexPath) {
+    m_indexPath = indexPath;
 }
 
 void CacheScanner::run() {
     m_stopRequested = false;
-    QDir rootDir(m_rootPath);
-    
-    if (rootDir.exists()) {
-        scanRecursive(rootDir);
+    m_batcher.start();
+    FileSystem::Entry root;
+    const bool rootExists = m_fs ? m_fs->stat(m_rootPath, root) == FileSystem::Error::None
+                                       && root.type == FileSystem::Type::Directory
+                                 : QDir(m_rootPath).exists();
+
+    if (rootExists) {
+        scanTree(threadCount());
     }
-    
+
+    flushReports(m_rootPath, true);
     emit scanFinished();
 }
 
-bool CacheScanner::isCacheFolder(const QString &folderName) {
-    return folderName.toLower().contains("cache");
+void CacheScanner::setCachePatterns(const QStringList &patterns) {
+    m_matcher = CacheMatcher(patterns);
+}
+
+void CacheScanner::setPruneRules(const QStringList &rules) {
+    m_pruneRules = PruneRules(rules);
+}
+
+void CacheScanner::setOneFileSystem(bool enabled) {
+    m_oneFileSystem = enabled;
+}
+
+void CacheScanner::setPerDeviceConcurrency(int count) {
+    m_perDeviceLimit = qMax(0, count);
+}
+
+void CacheScanner::setCheckpointPath(const QString &path) {
+    m_checkpointPath = path;
+}
+
+void CacheScanner::setCheckpointInterval(int seconds) {
+    m_checkpointIntervalNs = qMax(1, seconds) * 1000LL * 1000 * 1000;
+}
+
+void CacheScanner::setHistoryPath(const QString &path) {
+    m_historyPath = path;
+}
+
+void CacheScanner::setFileSystem(const FileSystem *fs) {
+    m_fs = FileSystem::virtualOrNull(fs);
+}
+
+/*
+ * Apparent accounting reuses the index where it can. Allocated accounting needs every
+ * file's inode and size trees every entry, so both always walk the cache and leave the
+ * cache's node unsized; the next scan then walks it again as well. Each walk also
+ * yields the newest modification and access times inside the cache.
+ */
+DirectorySizer::Usage CacheScanner::calculateDirectorySize(const QString &path, ScanIndexBuilder::Node *node, qint32 indexRecord,
+                                                           std::shared_ptr<SizeTree> &tree, DirectorySizer::EntryTimes &times) {
+    ScanMetrics::ScopedTimer timer(ScanMetrics::SizeCache);
+    ScanMetrics::add(ScanMetrics::CachesSized);
+    DirectorySizer sizer(m_sizeBackend, &m_stopRequested);
+    sizer.setOneFileSystem(m_oneFileSystem);
+    sizer.setPruneRules(&m_pruneRules);
+    sizer.setQueueDepth(m_queueDepth);
+    sizer.setFileSystem(m_fs);
+    if (m_accounting == DirectorySizer::Accounting::Allocated) {
+        if (m_buildTrees) tree = sizer.buildTree(path);
+        const DirectorySizer::Usage usage = sizer.measure(path);
+        times = sizer.entryTimes();
+        return usage;
+    }
+
+    DirectorySizer::Usage usage;
+    if (m_buildTrees) {
+        tree = sizer.buildTree(path);
+        usage.apparentBytes = tree->node(tree->root()).sizeBytes;
+    } else {
+        usage.apparentBytes = !node ? sizer.calculate(path)
+            : sizer.calculateIncremental(path, node, m_previousIndex.isOpen() ? &m_previousIndex : nullptr,
+                                         indexRecord, m_indexBuilder.get());
+    }
+    times = sizer.entryTimes();
+    return usage;
+}
+
+/*
+ * Traversal.
+ * Every directory still to be listed is a job. Each worker owns a queue, pushes the
+ * subdirectories it discovers onto it and steals from the others when it runs dry.
+ * m_pendingDirs counts jobs that are queued or being processed; when it drops to zero
+ * the whole tree has been visited and all workers exit.
+ * The scanner thread itself acts as worker 0, so only (workers - 1) extra threads are
+ * spawned; with a single worker this is a plain depth-first walk.
+ *
+ * Each job also belongs to a device. A worker must hold one of the device's slots
+ * while listing; jobs whose device is full are parked in that device's deferred
+ * queue, and the worker that frees a slot there continues with them.
+ *
+ * A scan that starts from a checkpoint seeds the queues with its pending directories
+ * instead of the root and runs without the index: the index it would write could
+ * not tell the restored part of the tree from the part never seen. A scan through
+ * a FileSystem other than the local one has no index either, since the index
+ * identifies directories by inode.
+ */
+void CacheScanner::scanTree(int workers) {
+    const QString rootPath = QDir(m_rootPath).absolutePath();
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    if (m_fs) {
+        m_devices.loadSingle(rootPath, workers, m_perDeviceLimit);
+    } else {
+        m_devices.load(rootPath, workers, m_perDeviceLimit, m_oneFileSystem);
+    }
+    m_pruneRules = PruneRules(m_pruneRules.rules()); // fresh counters
+    m_deferred.clear();
+    for (int i = 0; i < m_devices.deviceCount(); ++i) {
+        m_deferred.push_back(std::make_unique<WorkStealingQueue<ScanJob>>());
+    }
+
+    m_checkpointing = !m_checkpointPath.isEmpty();
+    QStringList restoredFrontier;
+    QList<CacheFolderInfo> restoredCaches;
+    const bool restored = m_checkpointing && readCheckpoint(rootPath, restoredFrontier, restoredCaches);
+
+    ScanJob root;
+    root.path = rootPath;
+    root.device = m_devices.rootDevice();
+    if (!m_indexPath.isEmpty() && !restored && !m_fs) {
+        if (m_previousIndex.open(m_indexPath)) {
+            root.indexRecord = m_previousIndex.findRoot(rootPath);
+        }
+        m_indexBuilder = std::make_unique<ScanIndexBuilder>();
+        root.indexNode = m_indexBuilder->addRoot(rootPath, ScanIndex::statDirectory(rootPath));
+    }
+
+    m_queues.clear();
+    for (int i = 0; i < workers; ++i) {
+        m_queues.push_back(std::make_unique<WorkStealingQueue<ScanJob>>());
+    }
+    m_liveWorkers = workers;
+    m_parkedWorkers = 0;
+    m_running.assign(workers, QString());
+    m_discovered.assign(workers, QList<ScanJob>());
+    m_found.clear();
+    m_restoredCaches.clear();
+    m_checkpointClock.start();
+    m_nextCheckpointNs = m_checkpointIntervalNs;
+
+    if (restored) {
+        emit resumedFromCheckpoint(static_cast<int>(restoredFrontier.size()), static_cast<int>(restoredCaches.size()));
+        for (const CacheFolderInfo &info : restoredCaches) {
+            m_restoredCaches.insert(info.pathId);
+            reportCache(info);
+        }
+        m_pendingDirs = 0;
+        for (const QString &path : restoredFrontier) {
+            ScanJob job;
+            job.path = path;
+            job.device = m_devices.deviceForPath(rootPath, path);
+            if (job.device == DeviceScheduler::NoDevice) continue;
+            m_pendingDirs.fetch_add(1);
+            m_queues[m_pendingDirs.load() % workers]->push(std::move(job));
+        }
+    } else {
+        m_pendingDirs = 1;
+        m_queues[0]->push(root);
+    }
+
+    QList<QThread *> threads;
+    for (int i = 1; i < workers; ++i) {
+        QThread *worker = QThread::create([this, i]() { workerLoop(i); });
+        threads.append(worker);
+        worker->start();
+    }
+
+    workerLoop(0);
+
+    for (QThread *worker : threads) {
+        worker->wait();
+        delete worker;
+    }
+    if (m_checkpointing) {
+        if (m_stopRequested) {
+            saveCheckpoint();
+        } else {
+            QFile::remove(m_checkpointPath);
+        }
+    }
+    m_queues.clear();
+    m_deferred.clear();
+    emit deviceStats(m_devices.stats(elapsed.nsecsElapsed()));
+    if (!m_pruneRules.isEmpty()) {
+        QList<PruneRuleStats> pruned;
+        const QList<quint64> counts = m_pruneRules.pruneCounts();
+        for (qsizetype i = 0; i < counts.size(); ++i) pruned.append({m_pruneRules.rules().at(i), counts.at(i)});
+        emit pruneStats(pruned);
+    }
+
+    // A stopped scan has holes in it; keep the previous index rather than saving those
+    m_previousIndex.close();
+    if (m_indexBuilder && !m_stopRequested) {
+        if (!m_indexBuilder->write(m_indexPath)) {
+            qWarning() << "Failed to write scan index" << m_indexPath;
+        }
+    }
+    m_indexBuilder.reset();
+
+    // Likewise the history only records complete scans, restored caches included
+    if (!m_historyPath.isEmpty() && !m_stopRequested) {
+        ScanHistory history;
+        if (!history.open(m_historyPath)) {
+            qWarning() << "Scan history" << m_historyPath << "is unreadable:" << history.errorString();
+        }
+        QMutexLocker locker(&m_foundMutex);
+        if (!history.append(QDateTime::currentSecsSinceEpoch(), m_found)) {
+            qWarning() << "Failed to write scan history" << m_historyPath << ":" << history.errorString();
+        }
+    }
+}
+
+void CacheScanner::workerLoop(int workerId) {
+    int idleRounds = 0;
+    ScanJob job;
+
+    while (!m_stopRequested) {
+        if (m_pauseRequested) {
+            waitWhilePaused();
+            continue;
+        }
+        if (m_checkpointing) maybeCheckpoint();
+
+        bool haveJob = false;
+        bool deferred = false;
+        {
+            QReadLocker frontier(m_checkpointing ? &m_frontierLock : nullptr);
+            if (nextJob(workerId, job)) {
+                haveJob = m_devices.tryAcquire(job.device);
+                if (!haveJob) {
+                    m_deferred[job.device]->push(std::move(job));
+                    deferred = true;
+                }
+            } else {
+                haveJob = takeDeferred(job);
+            }
+            if (haveJob && m_checkpointing) m_running[workerId] = job.path;
+        }
+
+        if (haveJob || deferred) {
+            idleRounds = 0;
+            if (haveJob) runJob(job, workerId);
+            continue;
+        }
+
+        if (m_pendingDirs.load() == 0) break;
+
+        // Other workers are still listing directories that may produce new jobs
+        if (++idleRounds < 64) {
+            QThread::yieldCurrentThread();
+        } else {
+            QThread::usleep(200);
+        }
+    }
+    leaveWorkerLoop();
+}
+
+// Called with a slot on job.device held; passes it on to parked jobs of that device before releasing it
+void CacheScanner::runJob(ScanJob &job, int workerId) {
+    const int device = job.device;
+    IoThrottle::pace(&m_stopRequested); // restarts this worker's busy clock after idling
+    for (;;) {
+        QElapsedTimer busy;
+        busy.start();
+        scanDirectory(job, workerId);
+        m_devices.recordDirectory(device, busy.nsecsElapsed());
+        // Outside the frontier lock, so a checkpoint never waits for a throttled worker
+        IoThrottle::pace(&m_stopRequested);
+
+        QReadLocker frontier(m_checkpointing ? &m_frontierLock : nullptr);
+        // Cut short: it stays the worker's running job, so the final checkpoint lists it again
+        if (m_stopRequested) break;
+        if (m_checkpointing) {
+            for (ScanJob &child : m_discovered[workerId]) m_queues[workerId]->push(std::move(child));
+            m_discovered[workerId].clear();
+            m_running[workerId].clear();
+        }
+        m_pendingDirs.fetch_sub(1);
+
+        if (m_pauseRequested || !m_deferred[device]->steal(job)) break;
+        if (m_checkpointing) m_running[workerId] = job.path;
+    }
+    m_devices.release(device);
+}
+
+bool CacheScanner::takeDeferred(ScanJob &job) {
+    for (int device = 0; device < static_cast<int>(m_deferred.size()); ++device) {
+        if (m_deferred[device]->size() == 0 || !m_devices.tryAcquire(device)) continue;
+        if (m_deferred[device]->steal(job)) return true;
+        m_devices.release(device);
+    }
+    return false;
+}
+
+bool CacheScanner::nextJob(int workerId, ScanJob &job) {
+    if (m_queues[workerId]->pop(job)) return true;
+
+    const int count = static_cast<int>(m_queues.size());
+    for (int offset = 1; offset < count; ++offset) {
+        if (m_queues[(workerId + offset) % count]->steal(job)) return true;
+    }
+    return false;
 }
 
 /*
- * Recursive scan logic.
- * We want to find folders that contain "cache" in their name.
+ * Lists a single directory (no recursion).
+ * We want to find folders whose name matches the cache patterns (by default: contains "cache").
  * If a folder IS a cache folder, add it and do NOT scan inside it (usually we delete the whole thing).
- * Or do we scan inside? The prompt says "Find ALL folders whose name CONTAINS...".
  * Usually if "AppData/Local/Temp/MyCache" is matches, we don't need to return "AppData/Local/Temp/MyCache/SubCache".
- * I will assume top-level match stops recursion for that branch.
+ * So a top-level match stops recursion for that branch.
  */
-void CacheScanner::scanRecursive(const QDir &dir) {
-    if (m_stopRequested) return;
+void CacheScanner::scanDirectory(const ScanJob &job, int workerId) {
+    // Unchanged since the previous scan: its subdirectories are exactly the recorded ones
+    if (job.indexNode && m_previousIndex.matches(job.indexRecord, job.indexNode->inode, job.indexNode->mtimeNs)) {
+        const ScanIndex::Record &rec = m_previousIndex.record(job.indexRecord);
+        if (rec.flags & ScanIndex::ListedFlag) {
+            for (quint32 i = 0; i < rec.childCount; ++i) {
+                if (m_stopRequested) return;
+                qint32 child = static_cast<qint32>(rec.firstChild + i);
+                visitSubdirectory(job, m_previousIndex.name(child), child, workerId);
+            }
+            job.indexNode->flags |= ScanIndex::ListedFlag;
+            return;
+        }
+    }
+
+    // Covers the listing only; cache folders found here are timed separately
+    ScanMetrics::ScopedTimer timer(ScanMetrics::ListDirectory);
+    if (m_fs) {
+        QList<FileSystem::Entry> entries;
+        const FileSystem::Error error = m_fs->list(job.path, entries);
+        if (error != FileSystem::Error::None) {
+            FileSystem::recordError(error);
+            return;
+        }
+        ScanMetrics::add(ScanMetrics::DirsOpened);
+        ScanMetrics::add(ScanMetrics::EntriesRead, entries.size());
+        for (const FileSystem::Entry &entry : std::as_const(entries)) {
+            if (m_stopRequested) return;
+            // Never followed, as below
+            if (entry.type != FileSystem::Type::Directory) continue;
+            visitSubdirectory(job, entry.name, ScanIndex::NoRecord, workerId);
+        }
+        return;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
 
     // Use QDirIterator for performance and explicit control
-    QDirIterator it(dir.absolutePath(), QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::NoIteratorFlags);
-    
+    QDirIterator it(job.path, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::NoIteratorFlags);
+
     while (it.hasNext()) {
         if (m_stopRequested) return;
-        
+
         it.next();
+        ScanMetrics::add(ScanMetrics::EntriesRead);
         QFileInfo info = it.fileInfo();
-        QString path = info.absoluteFilePath();
-        QString folderName = info.fileName();
-
-        emit progress(path);
 
         // Check if symbolic link - ignore
-        if (info.isSymLink()) continue;
-
-        if (isCacheFolder(folderName)) {
-            // Found a cache folder
-            // Calculate size
-            quint64 size = calculateDirectorySize(QDir(path));
-            
-            // Only report if size >= minimum configured size
-            if (size >= m_minSizeBytes) {
-                emit cacheFound({path, size});
-            }
-            // Do not recurse into a cache folder we are going to delete/flag
+        if (info.isSymLink()) {
+            reportDirectory(info.absoluteFilePath());
+            continue;
+        }
+
+        const QString name = info.fileName();
+        visitSubdirectory(job, name, m_previousIndex.findChild(job.indexRecord, name), workerId);
+    }
+
+    if (job.indexNode) job.indexNode->flags |= ScanIndex::ListedFlag;
+}
+
+void CacheScanner::visitSubdirectory(const ScanJob &parent, const QString &name, qint32 indexRecord, int workerId) {
+    // Folders waiting to be purged are already deleted as far as the user is concerned
+    if (name == QLatin1String(StagingPurger::StagingDirName)) return;
+
+    ScanJob child;
+    child.path = ScanIndex::joinPath(parent.path, name);
+    child.indexRecord = indexRecord;
+    child.device = m_devices.hasMounts() ? m_devices.deviceFor(child.path, parent.device) : parent.device;
+    if (child.device == DeviceScheduler::NoDevice) return; // pseudo filesystem, or another one with one-filesystem
+
+    reportDirectory(child.path);
+
+    if (parent.indexNode) {
+        ScanMetrics::add(ScanMetrics::StatCalls);
+        DirStat stat = ScanIndex::statDirectory(child.path);
+        if (!stat.valid) return; // vanished since it was listed
+        child.indexNode = m_indexBuilder->addChild(parent.indexNode, name, stat);
+    }
+
+    // Recorded in the index but never listed, so a scan without the rule lists it again
+    if (m_pruneRules.check(child.path) != PruneRules::NoRule) return;
+
+    if (m_matcher.matches(name, parent.path)) {
+        // Reported from the checkpoint this scan continues
+        if (!m_restoredCaches.isEmpty() && m_restoredCaches.contains(PathStore::shared().find(child.path))) return;
+
+        // Found a cache folder: size it, report it if big enough, do not recurse
+        std::shared_ptr<SizeTree> tree;
+        DirectorySizer::EntryTimes times;
+        const DirectorySizer::Usage usage = calculateDirectorySize(child.path, child.indexNode, child.indexRecord, tree, times);
+        if (m_stopRequested) return; // only partly sized
+        if (usage.apparentBytes >= m_minSizeBytes) {
+            m_devices.recordCache(child.device, usage.apparentBytes);
+            const bool allocated = m_accounting == DirectorySizer::Accounting::Allocated;
+            reportCache({PathStore::shared().intern(child.path), usage.apparentBytes,
+                         allocated ? usage.reclaimableBytes : CacheFolderInfo::UnknownSize, std::move(tree),
+                         times.modified, times.accessed});
+        }
+    } else if (m_fs || QDir(child.path).isReadable()) { // through m_fs, a denied listing is counted when it fails
+        m_pendingDirs.fetch_add(1);
+        if (m_checkpointing) {
+            m_discovered[workerId].append(std::move(child));
         } else {
-            // Recurse
-            // Check permissions roughly by seeing if we can open it?
-            // QDirIterator handles some of this, but if we can't read, usually we just skip.
-            if (QDir(path).isReadable()) {
-                scanRecursive(QDir(path));
-            }
+            m_queues[workerId]->push(std::move(child));
         }
+    } else {
+        ScanMetrics::add(ScanMetrics::PermissionErrors);
     }
 }
 
-quint64 CacheScanner::calculateDirectorySize(const QDir &dir) {
-    quint64 size = 0;
-    QDirIterator it(dir.absolutePath(), QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        if (m_stopRequested) return size;
-        it.next();
-        size += it.fileInfo().size();
+void CacheScanner::reportDirectory(const QString &path) {
+    m_batcher.directoryVisited();
+    flushReports(path, false);
+}
+
+void CacheScanner::reportCache(const CacheFolderInfo &info) {
+    if (m_checkpointing || !m_historyPath.isEmpty()) {
+        QMutexLocker locker(&m_foundMutex);
+        m_found.append({info.pathId, info.sizeBytes, info.reclaimableBytes, nullptr, info.lastModified, info.lastAccessed});
+    }
+    m_batcher.cacheFound(info);
+}
+
+void CacheScanner::flushReports(const QString &currentPath, bool force) {
+    ScanProgress snapshot;
+    QList<CacheFolderInfo> batch;
+    if (!m_batcher.takeBatch(currentPath, snapshot, batch, force)) return;
+
+    // Queued to the GUI thread; emitting never waits for the receiver
+    if (!batch.isEmpty()) {
+        ScanMetrics::uiBatchQueued(static_cast<int>(batch.size()));
+        emit cachesFound(batch);
+    }
+    ScanMetrics::add(ScanMetrics::UiProgressUpdates);
+    emit progress(snapshot);
+}
+
+/*
+ * Pause and checkpoints.
+ * A paused worker waits here until resume() or stop(). Once every worker still in
+ * workerLoop() has parked, a checkpoint is saved, so a paused scan survives being
+ * closed or killed. Workers that ran out of work and left count as parked.
+ */
+void CacheScanner::waitWhilePaused() {
+    QMutexLocker locker(&m_pauseMutex);
+    ++m_parkedWorkers;
+    checkpointIfAllParked(locker);
+    while (m_pauseRequested && !m_stopRequested) {
+        m_pauseCondition.wait(&m_pauseMutex);
+    }
+    --m_parkedWorkers;
+}
+
+void CacheScanner::leaveWorkerLoop() {
+    QMutexLocker locker(&m_pauseMutex);
+    --m_liveWorkers;
+    checkpointIfAllParked(locker);
+}
+
+// Called with m_pauseMutex held; the last worker to park or leave saves the checkpoint
+void CacheScanner::checkpointIfAllParked(QMutexLocker<QMutex> &locker) {
+    if (m_liveWorkers == 0 || m_parkedWorkers != m_liveWorkers) return;
+    if (!m_checkpointing || !m_pauseRequested || m_stopRequested) return;
+    locker.unlock();
+    saveCheckpoint();
+    locker.relock();
+}
+
+// Exactly one worker wins each interval, like ScanBatcher's flushes
+void CacheScanner::maybeCheckpoint() {
+    const qint64 now = m_checkpointClock.nsecsElapsed();
+    qint64 due = m_nextCheckpointNs.load(std::memory_order_relaxed);
+    if (now < due || !m_nextCheckpointNs.compare_exchange_strong(due, now + m_checkpointIntervalNs)) return;
+    saveCheckpoint();
+}
+
+namespace {
+constexpr quint32 kCheckpointMagic = 0x4446434b; // "DFCK"
+constexpr quint32 kCheckpointVersion = 2;
+}
+
+void CacheScanner::saveCheckpoint() {
+    QStringList frontier;
+    QList<CacheFolderInfo> found;
+    {
+        // Workers only wait here for the copy, never for the write
+        QWriteLocker locker(&m_frontierLock);
+        for (const auto &queue : m_queues) {
+            for (const ScanJob &job : queue->items()) frontier.append(job.path);
+        }
+        for (const auto &queue : m_deferred) {
+            for (const ScanJob &job : queue->items()) frontier.append(job.path);
+        }
+        for (const QString &path : m_running) {
+            if (!path.isEmpty()) frontier.append(path);
+        }
+        QMutexLocker foundLocker(&m_foundMutex);
+        found = m_found;
+    }
+
+    QMutexLocker writeLocker(&m_checkpointWriteMutex);
+    QDir().mkpath(QFileInfo(m_checkpointPath).absolutePath());
+    QSaveFile file(m_checkpointPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write scan checkpoint" << m_checkpointPath << ":" << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << kCheckpointMagic << kCheckpointVersion << checkpointKey(QDir(m_rootPath).absolutePath()) << frontier;
+    out << static_cast<quint32>(found.size());
+    for (const CacheFolderInfo &info : found) {
+        out << info.path() << info.sizeBytes << info.reclaimableBytes << info.lastModified << info.lastAccessed;
+    }
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "Failed to write scan checkpoint" << m_checkpointPath << ":" << file.errorString();
+    }
+}
+
+// Everything that decides what a scan reports; a checkpoint taken under other settings is ignored
+QString CacheScanner::checkpointKey(const QString &rootPath) const {
+    QStringList key{rootPath,
+                    QString::number(m_minSizeBytes),
+                    m_matcher.patterns().join('\n'),
+                    m_pruneRules.rules().join('\n'),
+                    m_oneFileSystem ? "one-fs" : "all-fs",
+                    m_accounting == DirectorySizer::Accounting::Allocated ? "allocated" : "apparent",
+                    m_buildTrees ? "trees" : "no-trees"};
+    // Never continues a scan of the disk, or the other way round
+    if (m_fs) key.append("virtual-fs");
+    return key.join('\x1f');
+}
+
+bool CacheScanner::readCheckpoint(const QString &rootPath, QStringList &frontier, QList<CacheFolderInfo> &found) const {
+    QFile file(m_checkpointPath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString key;
+    in >> magic >> version;
+    if (magic != kCheckpointMagic || version != kCheckpointVersion) return false;
+    in >> key;
+    if (key != checkpointKey(rootPath)) return false;
+
+    quint32 count = 0;
+    in >> frontier >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString path;
+        CacheFolderInfo info;
+        in >> path >> info.sizeBytes >> info.reclaimableBytes >> info.lastModified >> info.lastAccessed;
+        info.pathId = PathStore::shared().intern(path);
+        found.append(info);
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Ignoring damaged scan checkpoint" << m_checkpointPath;
+        frontier.clear();
+        found.clear();
+        return false;
     }
-    return size;
+    return true;
 }
@@ -4,24 +4,91 @@
 #include <QThread>
 #include <QString>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QWaitCondition>
 #include <atomic>
+#include <memory>
+#include <vector>
 
-struct CacheFolderInfo {
-    QString path;
-    quint64 sizeBytes;
-};
+#include "CacheMatcher.h"
+#include "DeviceScheduler.h"
+#include "DirectorySizer.h"
+#include "PruneRules.h"
+#include "ScanBatcher.h"
+#include "ScanIndex.h"
+#include "ScanTypes.h"
+#include "WorkStealingQueue.h"
 
 class CacheScanner : public QThread {
     Q_OBJECT
 public:
     explicit CacheScanner(const QString &rootPath, quint64 minSizeBytes = 0, QObject *parent = nullptr);
     void stop();
+    bool wasStopped() const { return m_stopRequested.load(); }
+
+    // Workers park between directories; a cache being sized is finished first
+    void pause();
+    void resume();
+    bool isPaused() const { return m_pauseRequested.load(); }
+
+    // 0 = one worker per core (the default, also for GUI scans), 1 = single-threaded
+    // depth-first walk, the traversal every scan used before the parallel one.
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    void setSizeBackend(DirectorySizer::Backend backend);
+    // Operations per io_uring batch with the IoUring size backend
+    void setQueueDepth(unsigned depth);
+    // Allocated also reports reclaimable bytes, at the cost of always walking caches in full
+    void setAccounting(DirectorySizer::Accounting accounting);
+    // Keep every entry below each reported cache as a SizeTree; caches are then walked in full
+    void setBuildTrees(bool enabled);
+
+    // Index of the previous scan; unchanged directories are not listed again and
+    // unchanged cache subtrees keep their sizes. Written back after a complete scan.
+    // Empty path disables it.
+    void setIndexPath(const QString &indexPath);
+
+    // Folder name rules, see CacheMatcher; defaults to any name containing "cache"
+    void setCachePatterns(const QStringList &patterns);
+    const QStringList &cachePatterns() const { return m_matcher.patterns(); }
+    // Subtrees neither scanned nor counted into cache sizes; see PruneRules for the syntax
+    void setPruneRules(const QStringList &rules);
+
+    // Stay on the root's filesystem, also while sizing caches
+    void setOneFileSystem(bool enabled);
+    bool isOneFileSystem() const { return m_oneFileSystem; }
+    // Workers allowed on one device at a time; 0 = by device kind (see DeviceScheduler)
+    void setPerDeviceConcurrency(int count);
+
+    // The directories still to be listed and the caches found so far are saved here
+    // every interval, once every worker still running has paused, and on stop(). A
+    // scan of the same root with the same settings continues from it; a completed
+    // scan removes it. Empty path disables it.
+    void setCheckpointPath(const QString &path);
+    void setCheckpointInterval(int seconds);
+
+    // Every completed scan's caches are appended to this ScanHistory file; empty path disables it
+    void setHistoryPath(const QString &path);
+
+    // Not owned, must outlive the scan. Anything but null or FileSystem::local() is
+    // listed and sized through the interface, as one device and without the index.
+    void setFileSystem(const FileSystem *fs);
 
 signals:
-    void progress(QString currentPath);
-    void cacheFound(CacheFolderInfo info);
+    // Both are rate-limited by ScanBatcher; a final flush precedes scanFinished()
+    void progress(ScanProgress snapshot);
+    void cachesFound(QList<CacheFolderInfo> batch);
+    // Once per completed traversal, right before the final flush
+    void deviceStats(QList<DeviceScanStats> devices);
+    // Same moment, per prune rule, when there are any
+    void pruneStats(QList<PruneRuleStats> rules);
+    // Before the caches restored from a checkpoint are reported
+    void resumedFromCheckpoint(int pendingDirs, int caches);
     void scanFinished();
 
 protected:
@@ -30,11 +97,81 @@ protected:
 private:
     QString m_rootPath;
     quint64 m_minSizeBytes;
+    int m_threadCount;
+    DirectorySizer::Backend m_sizeBackend;
+    unsigned m_queueDepth;
+    DirectorySizer::Accounting m_accounting;
+    bool m_buildTrees;
     std::atomic<bool> m_stopRequested;
-    
-    void scanRecursive(const QDir &dir);
-    quint64 calculateDirectorySize(const QDir &dir);
-    bool isCacheFolder(const QString &folderName);
+    ScanBatcher m_batcher;
+    CacheMatcher m_matcher;
+    PruneRules m_pruneRules;
+    bool m_oneFileSystem;
+    int m_perDeviceLimit;
+
+    struct ScanJob {
+        QString path;
+        qint32 indexRecord = ScanIndex::NoRecord;       // same directory in the previous index
+        ScanIndexBuilder::Node *indexNode = nullptr;    // same directory in the index being built
+        int device = 0;                                 // DeviceScheduler index
+    };
+
+    // Traversal state, only valid while scanTree() runs
+    std::vector<std::unique_ptr<WorkStealingQueue<ScanJob>>> m_queues;
+    std::atomic<qint64> m_pendingDirs;
+    DeviceScheduler m_devices;
+    std::vector<std::unique_ptr<WorkStealingQueue<ScanJob>>> m_deferred; // per device, waiting for a slot
+
+    std::atomic<bool> m_pauseRequested;
+    QMutex m_pauseMutex;
+    QWaitCondition m_pauseCondition;
+    int m_liveWorkers;   // still in workerLoop(), guarded by m_pauseMutex
+    int m_parkedWorkers; // guarded by m_pauseMutex
+
+    // Checkpointing. While it is on, a job moves between the queues and a worker's hands
+    // under the read side of m_frontierLock and a snapshot takes the write side, so every
+    // pending directory is in exactly one place. Subdirectories found by a running job are
+    // held back until it is done: a job cut short by a snapshot or stop() is listed again.
+    QString m_checkpointPath;
+    qint64 m_checkpointIntervalNs;
+    bool m_checkpointing;
+    QReadWriteLock m_frontierLock;
+    std::vector<QString> m_running;              // per worker, empty when idle
+    std::vector<QList<ScanJob>> m_discovered;    // per worker
+    QMutex m_foundMutex;
+    QList<CacheFolderInfo> m_found;              // without trees; also kept for the history
+    QSet<PathStore::Id> m_restoredCaches;        // already reported, never sized again
+    QElapsedTimer m_checkpointClock;
+    std::atomic<qint64> m_nextCheckpointNs;
+    QMutex m_checkpointWriteMutex;
+
+    QString m_indexPath;
+    ScanIndex m_previousIndex;
+    std::unique_ptr<ScanIndexBuilder> m_indexBuilder;
+
+    QString m_historyPath;
+    const FileSystem *m_fs = nullptr;
+
+    void scanTree(int workers);
+    void workerLoop(int workerId);
+    void runJob(ScanJob &job, int workerId);
+    bool takeDeferred(ScanJob &job);
+    void scanDirectory(const ScanJob &job, int workerId);
+    void visitSubdirectory(const ScanJob &parent, const QString &name, qint32 indexRecord, int workerId);
+    bool nextJob(int workerId, ScanJob &job);
+    DirectorySizer::Usage calculateDirectorySize(const QString &path, ScanIndexBuilder::Node *node, qint32 indexRecord,
+                                                 std::shared_ptr<SizeTree> &tree, DirectorySizer::EntryTimes &times);
+    void reportDirectory(const QString &path);
+    void reportCache(const CacheFolderInfo &info);
+    void flushReports(const QString &currentPath, bool force);
+
+    void waitWhilePaused();
+    void leaveWorkerLoop();
+    void checkpointIfAllParked(QMutexLocker<QMutex> &locker);
+    void maybeCheckpoint();
+    void saveCheckpoint();
+    QString checkpointKey(const QString &rootPath) const;
+    bool readCheckpoint(const QString &rootPath, QStringList &frontier, QList<CacheFolderInfo> &found) const;
 };
 
 #endif // CACHESCANNER_H
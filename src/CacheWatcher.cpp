@@ -0,0 +1,602 @@
+#include "CacheWatcher.h"
+#include "ScanIndex.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <algorithm>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+constexpr int kFlushDelayMs = 250;
+constexpr int kPollIntervalMs = 30000;
+constexpr int kSeedBatch = 64; // directories added per event loop turn while seeding
+
+#ifdef Q_OS_LINUX
+// Outside caches only directory entries coming and going matter (IN_ISDIR is checked on read)
+constexpr quint32 kTreeMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                            | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+constexpr quint32 kCacheMask = kTreeMask | IN_MODIFY;
+#endif
+}
+
+CacheWatcher::CacheWatcher(QObject *parent)
+    : QObject(parent), m_oneFileSystem(false), m_inotifyFd(-1), m_notifier(nullptr), m_flushTimer(this), m_pollTimer(this),
+      m_watchBudget(defaultWatchBudget()), m_minSizeBytes(0), m_resyncAll(false) {
+    // Single shot and never restarted by later events, so a storm is bounded to one flush per interval
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFlushDelayMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &CacheWatcher::flush);
+
+    m_pollTimer.setInterval(kPollIntervalMs);
+    connect(&m_pollTimer, &QTimer::timeout, this, &CacheWatcher::poll);
+
+    // Zero interval: runs whenever the event loop has nothing else to do
+    m_seedTimer.setInterval(0);
+    connect(&m_seedTimer, &QTimer::timeout, this, &CacheWatcher::seed);
+
+    // Caches are sized without their excluded subdirectories, like the scan sized them
+    m_sizer.setPruneRules(&m_pruneRules);
+}
+
+CacheWatcher::~CacheWatcher() {
+    stop();
+}
+
+void CacheWatcher::setCachePatterns(const QStringList &patterns) {
+    m_matcher = CacheMatcher(patterns);
+}
+
+void CacheWatcher::setPruneRules(const PruneRules &rules) {
+    m_pruneRules = rules;
+}
+
+void CacheWatcher::setOneFileSystem(bool enabled) {
+    m_oneFileSystem = enabled;
+}
+
+void CacheWatcher::start(const QString &rootPath, const QString &indexPath, const QStringList &caches, quint64 minSizeBytes) {
+    stop();
+    m_minSizeBytes = minSizeBytes;
+    m_sizer.setOneFileSystem(m_oneFileSystem);
+
+#ifdef Q_OS_LINUX
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd >= 0) {
+        m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &CacheWatcher::readEvents);
+    }
+#endif
+
+    const QString root = QDir::cleanPath(QDir(rootPath).absolutePath());
+    m_rootPrefix = root.endsWith('/') ? root : root + '/';
+    // One worker: only the mount table is of interest, for deviceForPath()
+    m_devices.load(root, 1, 0, m_oneFileSystem);
+    if (!indexPath.isEmpty()) loadFromIndex(root, indexPath);
+
+    // Known before the seed walk gets to them, so they are not measured twice
+    addCaches(caches);
+    if (!isKnown(root)) {
+        m_seedQueue.append(root);
+        m_seedTimer.start();
+    }
+}
+
+void CacheWatcher::addCaches(const QStringList &paths) {
+    for (const QString &path : paths) {
+        const QString cleanPath = QDir::cleanPath(path);
+        if (isKnown(cleanPath) || !QFileInfo(cleanPath).isDir()) continue;
+        addCache(cleanPath);
+        m_caches[cleanPath].reported = true; // explicitly asked for, so always kept current
+    }
+    publish();
+}
+
+void CacheWatcher::stop() {
+    m_flushTimer.stop();
+    m_pollTimer.stop();
+    m_seedTimer.stop();
+    m_seedQueue.clear();
+    delete m_notifier;
+    m_notifier = nullptr;
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) ::close(m_inotifyFd); // drops every watch at once
+#endif
+    m_inotifyFd = -1;
+
+    m_dirs.clear();
+    m_wdPaths.clear();
+    m_caches.clear();
+    m_polledDirs.clear();
+    m_dirtyDirs.clear();
+    m_changedCaches.clear();
+    m_removedCaches.clear();
+    m_resyncAll = false;
+}
+
+/*
+ * Drains the inotify queue. Events never touch the disk here; they only mark the
+ * directory they happened in, and flush() deals with each marked directory once.
+ */
+void CacheWatcher::readEvents() {
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[64 * 1024];
+
+    for (;;) {
+        ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) break; // EAGAIN: queue is empty
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // The kernel dropped events; compare everything against the disk once
+                m_resyncAll = true;
+                continue;
+            }
+
+            const QString path = m_wdPaths.value(event->wd);
+            if (path.isEmpty()) continue; // we removed this watch ourselves
+
+            if (event->mask & IN_IGNORED) {
+                // Directory deleted or unmounted, the kernel already dropped the watch
+                m_wdPaths.remove(event->wd);
+                forget(path);
+                continue;
+            }
+
+            auto it = m_dirs.constFind(path);
+            if (it == m_dirs.constEnd()) continue;
+            if (it->cacheRoot.isEmpty() && !(event->mask & IN_ISDIR)) continue;
+            m_dirtyDirs.insert(path);
+        }
+    }
+
+    if (m_resyncAll || !m_dirtyDirs.isEmpty() || !m_changedCaches.isEmpty() || !m_removedCaches.isEmpty()) {
+        scheduleFlush();
+    }
+#endif
+}
+
+void CacheWatcher::markDirty(const QString &path) {
+    m_dirtyDirs.insert(path);
+    scheduleFlush();
+}
+
+void CacheWatcher::scheduleFlush() {
+    if (!m_flushTimer.isActive()) m_flushTimer.start();
+}
+
+void CacheWatcher::flush() {
+    if (m_resyncAll) {
+        m_resyncAll = false;
+        // Watched caches are re-listed directory by directory, everything else is compared by mtime
+        for (auto it = m_dirs.cbegin(); it != m_dirs.cend(); ++it) {
+            if (!it->cacheRoot.isEmpty() || ScanIndex::statDirectory(it.key()).mtimeNs != it->mtimeNs) {
+                m_dirtyDirs.insert(it.key());
+            }
+        }
+    }
+
+    // Sorted, so a parent is handled before its children and removed subtrees are skipped
+    QStringList dirty(m_dirtyDirs.cbegin(), m_dirtyDirs.cend());
+    m_dirtyDirs.clear();
+    std::sort(dirty.begin(), dirty.end());
+
+    for (const QString &path : dirty) {
+        auto it = m_dirs.constFind(path);
+        if (it == m_dirs.constEnd()) continue;
+        if (it->cacheRoot.isEmpty()) {
+            rescanDirectory(path);
+        } else {
+            refreshCacheDirectory(path);
+        }
+    }
+
+    publish();
+}
+
+// Fallback for whatever could not be watched
+void CacheWatcher::poll() {
+    const QStringList polledDirs(m_polledDirs.cbegin(), m_polledDirs.cend());
+    for (const QString &path : polledDirs) {
+        auto it = m_dirs.constFind(path);
+        if (it == m_dirs.constEnd()) continue;
+        if (ScanIndex::statDirectory(path).mtimeNs != it->mtimeNs) rescanDirectory(path);
+    }
+
+    QStringList polledCaches;
+    for (auto it = m_caches.cbegin(); it != m_caches.cend(); ++it) {
+        if (it->polled) polledCaches.append(it.key());
+    }
+    for (const QString &path : polledCaches) {
+        if (!m_caches.contains(path)) continue;
+        if (!ScanIndex::statDirectory(path).valid) {
+            forget(path);
+            continue;
+        }
+        const quint64 size = m_sizer.calculate(path);
+        Cache &cache = m_caches[path];
+        if (size != cache.sizeBytes) {
+            cache.sizeBytes = size;
+            m_changedCaches.insert(path);
+        }
+    }
+
+    publish();
+}
+
+void CacheWatcher::publish() {
+    QList<CacheFolderInfo> batch;
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    for (const QString &path : std::as_const(m_changedCaches)) {
+        auto it = m_caches.find(path);
+        if (it == m_caches.end()) continue;
+        if (it->reported ? it->sizeBytes == it->publishedBytes : it->sizeBytes < m_minSizeBytes) continue;
+        it->reported = true;
+        it->publishedBytes = it->sizeBytes;
+        batch.append({PathStore::shared().intern(path), it->sizeBytes, CacheFolderInfo::UnknownSize, nullptr, now});
+    }
+    m_changedCaches.clear();
+
+    if (!batch.isEmpty()) emit cachesUpdated(batch);
+    if (!m_removedCaches.isEmpty()) emit cachesRemoved(std::exchange(m_removedCaches, QStringList()));
+
+    int polled = static_cast<int>(m_polledDirs.size());
+    for (const Cache &cache : std::as_const(m_caches)) {
+        if (cache.polled) ++polled;
+    }
+    if (polled == 0) {
+        m_pollTimer.stop();
+    } else if (!m_pollTimer.isActive()) {
+        m_pollTimer.start();
+    }
+    emit watchStatus(static_cast<int>(m_wdPaths.size()), polled);
+}
+
+/*
+ * Seeds the watch set from the index the scan just wrote, so subscribing costs one
+ * watch and one stat per directory instead of another walk. Directories whose mtime
+ * moved since the index was written are re-listed on the first flush.
+ */
+void CacheWatcher::loadFromIndex(const QString &rootPath, const QString &indexPath) {
+    ScanIndex index;
+    if (!index.open(indexPath)) return;
+    const qint32 rootRecord = index.findRoot(rootPath);
+    if (rootRecord == ScanIndex::NoRecord) return;
+
+    struct Pending {
+        qint32 record;
+        QString path;
+        QString cacheRoot;
+    };
+    QList<Pending> stack;
+    stack.append({rootRecord, rootPath, QString()});
+
+    while (!stack.isEmpty()) {
+        const Pending item = stack.takeLast();
+        const ScanIndex::Record &rec = index.record(item.record);
+        const DirStat stat = ScanIndex::statDirectory(item.path);
+        if (!stat.valid) continue; // gone since the scan; its parent shows up as changed
+
+        QString cacheRoot = item.cacheRoot;
+        if (cacheRoot.isEmpty() && item.record != rootRecord && m_matcher.matchesPath(item.path)) {
+            cacheRoot = item.path;
+            m_caches.insert(cacheRoot, Cache());
+        } else if (!cacheRoot.isEmpty() && m_caches.value(cacheRoot).polled) {
+            continue; // ran out of watches for this cache already
+        }
+
+        const bool inCache = !cacheRoot.isEmpty();
+        const bool complete = (rec.flags & ScanIndex::ListedFlag) && (!inCache || (rec.flags & ScanIndex::SizedFlag));
+        if (!complete) {
+            // Not recorded in full (e.g. unreadable during the scan): take it from the disk
+            if (!inCache) {
+                addDirectory(item.path);
+            } else if (!addCacheDirectory(item.path, cacheRoot)) {
+                pollCache(cacheRoot);
+            }
+            continue;
+        }
+
+        Dir dir;
+        dir.cacheRoot = cacheRoot;
+        dir.mtimeNs = rec.mtimeNs;
+        dir.wd = addWatch(item.path, inCache);
+        if (dir.wd < 0 && inCache) {
+            pollCache(cacheRoot);
+            continue;
+        }
+
+        quint64 childBytes = 0;
+        for (quint32 i = 0; i < rec.childCount; ++i) {
+            const qint32 child = static_cast<qint32>(rec.firstChild + i);
+            const QString name = index.name(child);
+            const QString childPath = ScanIndex::joinPath(item.path, name);
+            // Recorded but never listed by the scan; not part of the watched tree
+            if (pruned(childPath)) continue;
+            dir.children.append(name);
+            childBytes += index.record(child).totalBytes;
+            stack.append({child, childPath, cacheRoot});
+        }
+
+        if (inCache) {
+            // Own files plus the entries of its subdirectories, as DirectorySizer counts them
+            dir.localBytes = rec.totalBytes - childBytes;
+            m_caches[cacheRoot].sizeBytes += dir.localBytes;
+        } else if (dir.wd < 0) {
+            m_polledDirs.insert(item.path);
+        }
+        m_dirs.insert(item.path, dir);
+
+        if (!index.matches(item.record, stat.inode, stat.mtimeNs)) markDirty(item.path);
+    }
+
+    // The scan already reported these sizes
+    for (auto it = m_caches.begin(); it != m_caches.end(); ++it) {
+        it->reported = it->sizeBytes >= m_minSizeBytes;
+        it->publishedBytes = it->sizeBytes;
+    }
+}
+
+// Adds queued directories a batch at a time; caches they hold are reported as they turn up
+void CacheWatcher::seed() {
+    for (int i = 0; i < kSeedBatch && !m_seedQueue.isEmpty(); ++i) {
+        const QString path = m_seedQueue.takeLast();
+        if (!isKnown(path)) addDirectory(path);
+    }
+    if (m_seedQueue.isEmpty()) m_seedTimer.stop();
+    publish();
+}
+
+// Adds a directory outside caches; unknown subdirectories are queued for seed(), caches added at once.
+void CacheWatcher::addDirectory(const QString &path) {
+    const DirStat stat = ScanIndex::statDirectory(path);
+    if (!stat.valid) return;
+
+    Dir dir;
+    dir.wd = addWatch(path, false);
+    dir.mtimeNs = stat.mtimeNs;
+    // Listed after the watch is in place, so nothing created in between is missed
+    dir.children = listSubdirectories(path);
+    if (dir.wd < 0) m_polledDirs.insert(path);
+
+    const QStringList children = dir.children;
+    m_dirs.insert(path, dir);
+
+    for (const QString &name : children) {
+        const QString childPath = ScanIndex::joinPath(path, name);
+        if (isKnown(childPath)) continue;
+        if (m_matcher.matches(name, path)) {
+            addCache(childPath);
+        } else {
+            m_seedQueue.append(childPath);
+        }
+    }
+    if (!m_seedQueue.isEmpty() && !m_seedTimer.isActive()) m_seedTimer.start();
+}
+
+void CacheWatcher::addCache(const QString &path) {
+    m_caches.insert(path, Cache());
+    if (!addCacheDirectory(path, path)) pollCache(path);
+    m_changedCaches.insert(path);
+}
+
+// Returns false when the watch budget ran out somewhere in the subtree.
+bool CacheWatcher::addCacheDirectory(const QString &path, const QString &cacheRoot) {
+    Dir dir;
+    dir.cacheRoot = cacheRoot;
+    dir.wd = addWatch(path, true);
+    if (dir.wd < 0) {
+        // Vanished in the meantime is fine, the parent gets an event for it
+        return !ScanIndex::statDirectory(path).valid;
+    }
+    dir.mtimeNs = ScanIndex::statDirectory(path).mtimeNs;
+    dir.localBytes = measure(path, dir.children);
+    m_caches[cacheRoot].sizeBytes += dir.localBytes;
+
+    const QStringList children = dir.children;
+    m_dirs.insert(path, dir);
+
+    for (const QString &name : children) {
+        const QString childPath = ScanIndex::joinPath(path, name);
+        if (!m_dirs.contains(childPath) && !addCacheDirectory(childPath, cacheRoot)) return false;
+    }
+    return true;
+}
+
+void CacheWatcher::pollCache(const QString &cacheRoot) {
+    // Partly watched is worth nothing: give the watches back and re-size it as a whole on every poll
+    dropTree(cacheRoot, true);
+    Cache &cache = m_caches[cacheRoot];
+    cache.polled = true;
+    cache.sizeBytes = m_sizer.calculate(cacheRoot);
+    m_changedCaches.insert(cacheRoot);
+}
+
+// Directory outside caches changed: diff its subdirectories against the known ones.
+void CacheWatcher::rescanDirectory(const QString &path) {
+    auto it = m_dirs.find(path);
+    if (it == m_dirs.end()) return;
+
+    const DirStat stat = ScanIndex::statDirectory(path);
+    if (!stat.valid) {
+        forget(path);
+        return;
+    }
+
+    const QStringList previous = it->children;
+    const QStringList current = listSubdirectories(path);
+    it->children = current;
+    it->mtimeNs = stat.mtimeNs;
+
+    const QSet<QString> before(previous.cbegin(), previous.cend());
+    const QSet<QString> after(current.cbegin(), current.cend());
+
+    for (const QString &name : previous) {
+        if (!after.contains(name)) forget(ScanIndex::joinPath(path, name));
+    }
+    for (const QString &name : current) {
+        const QString childPath = ScanIndex::joinPath(path, name);
+        if (before.contains(name) || isKnown(childPath)) continue;
+        if (m_matcher.matches(name, path)) {
+            addCache(childPath);
+        } else {
+            addDirectory(childPath);
+        }
+    }
+}
+
+// Directory inside a cache changed: re-list that one directory and apply the difference.
+void CacheWatcher::refreshCacheDirectory(const QString &path) {
+    auto it = m_dirs.find(path);
+    if (it == m_dirs.end() || it->cacheRoot.isEmpty()) return;
+
+    const DirStat stat = ScanIndex::statDirectory(path);
+    if (!stat.valid) {
+        forget(path);
+        return;
+    }
+
+    const QString cacheRoot = it->cacheRoot;
+    const QStringList previous = it->children;
+    const quint64 previousBytes = it->localBytes;
+
+    QStringList current;
+    const quint64 bytes = measure(path, current);
+    it->children = current;
+    it->localBytes = bytes;
+    it->mtimeNs = stat.mtimeNs;
+
+    Cache &cache = m_caches[cacheRoot];
+    cache.sizeBytes = cache.sizeBytes - previousBytes + bytes;
+    m_changedCaches.insert(cacheRoot);
+
+    const QSet<QString> after(current.cbegin(), current.cend());
+    for (const QString &name : previous) {
+        if (!after.contains(name)) forget(ScanIndex::joinPath(path, name));
+    }
+    for (const QString &name : current) {
+        const QString childPath = ScanIndex::joinPath(path, name);
+        if (m_dirs.contains(childPath)) continue;
+        if (!addCacheDirectory(childPath, cacheRoot)) {
+            pollCache(cacheRoot);
+            return;
+        }
+    }
+}
+
+// Drops a directory (or cache) that no longer exists, with everything below it.
+void CacheWatcher::forget(const QString &path) {
+    const QString cacheRoot = m_dirs.value(path).cacheRoot;
+    const quint64 bytes = dropTree(path, true);
+
+    const QFileInfo info(path);
+    auto parent = m_dirs.find(info.path());
+    if (parent != m_dirs.end()) parent->children.removeOne(info.fileName());
+
+    if (m_caches.contains(path)) {
+        if (m_caches.take(path).reported) m_removedCaches.append(path);
+        m_changedCaches.remove(path);
+    } else if (!cacheRoot.isEmpty() && m_caches.contains(cacheRoot)) {
+        Cache &cache = m_caches[cacheRoot];
+        cache.sizeBytes -= qMin(bytes, cache.sizeBytes);
+        m_changedCaches.insert(cacheRoot);
+    }
+}
+
+// Removes the directory records (and watches) of a subtree; returns the cache bytes they held.
+quint64 CacheWatcher::dropTree(const QString &path, bool isTop) {
+    if (!isTop && m_caches.contains(path)) {
+        if (m_caches.take(path).reported) m_removedCaches.append(path);
+        m_changedCaches.remove(path);
+    }
+    m_polledDirs.remove(path);
+
+    const Dir dir = m_dirs.take(path);
+    if (dir.wd >= 0) removeWatch(dir.wd);
+
+    quint64 bytes = dir.localBytes;
+    for (const QString &name : dir.children) {
+        bytes += dropTree(ScanIndex::joinPath(path, name), false);
+    }
+    return bytes;
+}
+
+int CacheWatcher::addWatch(const QString &path, bool insideCache) {
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd < 0 || m_wdPaths.size() >= m_watchBudget) return -1;
+
+    int wd = inotify_add_watch(m_inotifyFd, QFile::encodeName(path).constData(), insideCache ? kCacheMask : kTreeMask);
+    if (wd < 0) {
+        // Out of watches system-wide: keep what we have and poll the rest
+        if (errno == ENOSPC) m_watchBudget = static_cast<int>(m_wdPaths.size());
+        return -1;
+    }
+    m_wdPaths.insert(wd, path);
+    return wd;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(insideCache);
+    return -1;
+#endif
+}
+
+void CacheWatcher::removeWatch(int wd) {
+#ifdef Q_OS_LINUX
+    if (m_wdPaths.remove(wd)) inotify_rm_watch(m_inotifyFd, wd);
+#else
+    Q_UNUSED(wd);
+#endif
+}
+
+// Bytes a single cache directory contributes: its files plus the entries of its subdirectories.
+quint64 CacheWatcher::measure(const QString &path, QStringList &subdirs) const {
+    quint64 bytes = 0;
+    subdirs.clear();
+    if (!m_sizer.listDirectory(path, bytes, subdirs)) return 0;
+
+    // Excluded subdirectories count for nothing, not even their entry
+    subdirs.removeIf([this, &path](const QString &name) { return excluded(ScanIndex::joinPath(path, name)); });
+    for (const QString &name : subdirs) {
+        const DirStat stat = ScanIndex::statDirectory(ScanIndex::joinPath(path, name));
+        if (stat.valid) bytes += stat.size;
+    }
+    return bytes;
+}
+
+// Excluded subdirectories are left out, so they are never watched or walked
+QStringList CacheWatcher::listSubdirectories(const QString &path) const {
+    QStringList names;
+    QDirIterator it(path, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::NoIteratorFlags);
+    while (it.hasNext()) {
+        it.next();
+        if (!it.fileInfo().isSymLink() && !excluded(it.filePath())) names.append(it.fileName());
+    }
+    return names;
+}
+
+// What the scan would not have entered. Mounts only matter below the root; favorites
+// outside it are watched wherever they are.
+bool CacheWatcher::excluded(const QString &path) const {
+    if (pruned(path)) return true;
+    if (!m_devices.hasMounts() || !path.startsWith(m_rootPrefix)) return false;
+    return m_devices.deviceForPath(m_rootPrefix.chopped(1), path) == DeviceScheduler::NoDevice;
+}
+
+int CacheWatcher::defaultWatchBudget() {
+    QFile file(QStringLiteral("/proc/sys/fs/inotify/max_user_watches"));
+    bool ok = false;
+    const int limit = file.open(QIODevice::ReadOnly) ? file.readAll().trimmed().toInt(&ok) : 0;
+    // Leave half of the per-user limit to editors, file managers and the like
+    return ok && limit > 0 ? limit / 2 : 4096;
+}
@@ -0,0 +1,136 @@
+#ifndef CACHEWATCHER_H
+#define CACHEWATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "CacheMatcher.h"
+#include "DeviceScheduler.h"
+#include "DirectorySizer.h"
+#include "PruneRules.h"
+#include "ScanTypes.h"
+
+class QSocketNotifier;
+
+/*
+ * Keeps cache sizes current after a scan without scanning again.
+ *
+ * Every directory of the scanned tree gets an inotify watch: directories outside
+ * caches only for subdirectories appearing or disappearing (new cache folders),
+ * directories inside caches for any change. Events only mark directories dirty;
+ * a short timer then re-lists each dirty directory once, however many events it
+ * got, and applies the difference to the size of the cache it belongs to.
+ *
+ * The initial tree (and per-directory byte counts) comes from the scan index when
+ * there is one, so subscribing does not walk the disk again. Without an index the
+ * caches the scan reported are watched right away and the rest of the tree is
+ * seeded in the background, a batch of directories per event loop turn, so the
+ * thread keeps handling events meanwhile. Directories the scan skipped (prune
+ * rules, pseudo filesystems, other filesystems with one-filesystem) are neither
+ * watched nor walked.
+ *
+ * When the watch budget runs out, the remaining directories are polled instead:
+ * directories outside caches by mtime, caches by re-sizing them as a whole.
+ * Without inotify (non-Linux) everything is polled.
+ *
+ * Lives on its own thread; all slots must be invoked through queued connections.
+ */
+class CacheWatcher : public QObject {
+    Q_OBJECT
+public:
+    explicit CacheWatcher(QObject *parent = nullptr);
+    ~CacheWatcher();
+
+public slots:
+    // The scan's settings; they apply from the next start()
+    void setCachePatterns(const QStringList &patterns);
+    void setPruneRules(const PruneRules &rules);
+    void setOneFileSystem(bool enabled);
+    // Replaces whatever was watched before. indexPath may be empty. `caches` are the
+    // ones the scan reported plus favorites; those the index already covers are skipped.
+    void start(const QString &rootPath, const QString &indexPath, const QStringList &caches, quint64 minSizeBytes);
+    // Caches outside the scanned tree, e.g. favorites added later
+    void addCaches(const QStringList &paths);
+    void stop();
+
+signals:
+    // Caches whose size changed, and newly created caches of at least the minimum size;
+    // both count as modified now, access times stay unknown
+    void cachesUpdated(QList<CacheFolderInfo> batch);
+    void cachesRemoved(QStringList paths);
+    void watchStatus(int watchedDirs, int polledDirs);
+
+private:
+    struct Dir {
+        int wd = -1;              // -1 when polled
+        QString cacheRoot;        // empty for directories outside caches
+        quint64 localBytes = 0;   // files + subdirectory entries, cache directories only
+        qint64 mtimeNs = 0;
+        QStringList children;
+    };
+
+    struct Cache {
+        quint64 sizeBytes = 0;
+        bool polled = false;      // not fully watched, re-sized as a whole
+        bool reported = false;
+        quint64 publishedBytes = 0;
+    };
+
+    DirectorySizer m_sizer;
+    CacheMatcher m_matcher;
+    PruneRules m_pruneRules;
+    DeviceScheduler m_devices;
+    QString m_rootPrefix;         // root with a trailing slash
+    bool m_oneFileSystem;
+    int m_inotifyFd;
+    QSocketNotifier *m_notifier;
+    QTimer m_flushTimer;
+    QTimer m_pollTimer;
+    QTimer m_seedTimer;
+    QStringList m_seedQueue;      // directories outside caches still to be added
+    int m_watchBudget;
+    quint64 m_minSizeBytes;
+
+    QHash<QString, Dir> m_dirs;
+    QHash<int, QString> m_wdPaths;
+    QHash<QString, Cache> m_caches;
+    QSet<QString> m_polledDirs;
+
+    QSet<QString> m_dirtyDirs;
+    QSet<QString> m_changedCaches;
+    QStringList m_removedCaches;
+    bool m_resyncAll;
+
+    void readEvents();
+    void markDirty(const QString &path);
+    void scheduleFlush();
+    void flush();
+    void poll();
+    void seed();
+    void publish();
+
+    void loadFromIndex(const QString &rootPath, const QString &indexPath);
+    void addDirectory(const QString &path);
+    void addCache(const QString &path);
+    bool addCacheDirectory(const QString &path, const QString &cacheRoot);
+    void pollCache(const QString &cacheRoot);
+    void rescanDirectory(const QString &path);
+    void refreshCacheDirectory(const QString &path);
+    void forget(const QString &path);
+    quint64 dropTree(const QString &path, bool isTop);
+    bool isKnown(const QString &path) const { return m_dirs.contains(path) || m_caches.contains(path); }
+    bool pruned(const QString &path) const { return m_pruneRules.check(path) != PruneRules::NoRule; }
+    bool excluded(const QString &path) const;
+
+    int addWatch(const QString &path, bool insideCache);
+    void removeWatch(int wd);
+    quint64 measure(const QString &path, QStringList &subdirs) const;
+    QStringList listSubdirectories(const QString &path) const;
+    static int defaultWatchBudget();
+};
+
+#endif // CACHEWATCHER_H
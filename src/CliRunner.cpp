@@ -0,0 +1,392 @@
+#include "CliRunner.h"
+#include "FavoritesManager.h"
+#include "ReclaimPlanner.h"
+#include "ScanHistory.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTimer>
+#include <chrono>
+#include <cstdio>
+
+CliRunner::CliRunner(const Options &options, QObject *parent)
+    : QObject(parent), m_options(options), m_scanner(nullptr), m_deletion(nullptr),
+      m_bytesFreed(0), m_filesFreed(0), m_failures(0), m_phaseThrottledNs(0), m_deadlineReached(false) {
+    m_out.open(stdout, QIODevice::WriteOnly);
+}
+
+void CliRunner::start() {
+    ScanMetrics::resetPeaks();
+    m_phaseStart = ScanMetrics::snapshot();
+    IoThrottle::shared().configure(m_options.throttle);
+    if (m_options.maxRuntimeSeconds > 0) {
+        QTimer::singleShot(std::chrono::seconds(m_options.maxRuntimeSeconds), this, &CliRunner::onDeadline);
+    }
+
+    m_scanner = new CacheScanner(m_options.rootPath, m_options.minSizeBytes, this);
+    m_scanner->setThreadCount(m_options.threads);
+    m_scanner->setSizeBackend(m_options.sizeBackend);
+    m_scanner->setQueueDepth(m_options.queueDepth);
+    m_scanner->setIndexPath(m_options.indexPath);
+    m_scanner->setCachePatterns(m_options.cachePatterns);
+    m_scanner->setPruneRules(m_options.pruneRules);
+    if (m_options.allocated) m_scanner->setAccounting(DirectorySizer::Accounting::Allocated);
+    m_scanner->setOneFileSystem(m_options.oneFileSystem);
+    m_scanner->setBuildTrees(m_options.treeDepth > 0);
+    m_scanner->setPerDeviceConcurrency(m_options.perDevice);
+    m_scanner->setCheckpointPath(m_options.checkpointPath);
+    m_scanner->setCheckpointInterval(m_options.checkpointInterval);
+    m_scanner->setHistoryPath(m_options.historyPath);
+
+    connect(m_scanner, &CacheScanner::progress, this, &CliRunner::onProgress);
+    connect(m_scanner, &CacheScanner::resumedFromCheckpoint, this, &CliRunner::onResumed);
+    connect(m_scanner, &CacheScanner::cachesFound, this, &CliRunner::onCachesFound);
+    connect(m_scanner, &CacheScanner::deviceStats, this, &CliRunner::onDeviceStats);
+    connect(m_scanner, &CacheScanner::pruneStats, this, &CliRunner::onPruneStats);
+    connect(m_scanner, &CacheScanner::scanFinished, this, &CliRunner::onScanFinished);
+
+    m_scanner->start();
+}
+
+void CliRunner::writeLine(const QJsonObject &object) {
+    m_out.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    m_out.write("\n", 1);
+    // Consumers read the stream while the scan is still running
+    m_out.flush();
+}
+
+// Largest children first, at most 20 per directory; the rest is summed up in "more"
+QJsonObject CliRunner::treeJson(const SizeTree &tree, quint32 node, int depth) const {
+    constexpr int kMaxChildren = 20;
+
+    const SizeTree::Node &entry = tree.node(node);
+    QJsonObject object;
+    object["name"] = node == tree.root() ? QString() : tree.name(node);
+    object["size"] = static_cast<qint64>(entry.sizeBytes);
+    if (!(entry.flags & SizeTree::Directory)) return object;
+
+    object["items"] = static_cast<qint64>(entry.items - 1);
+    if (entry.flags & SizeTree::Unreadable) object["unreadable"] = true;
+    if (depth <= 0 || entry.firstChild == SizeTree::NoNode) return object;
+
+    const QList<quint32> children = tree.children(node);
+    QJsonArray list;
+    quint64 moreBytes = 0;
+    for (int i = 0; i < children.size(); ++i) {
+        if (i < kMaxChildren) {
+            list.append(treeJson(tree, children[i], depth - 1));
+        } else {
+            moreBytes += tree.node(children[i]).sizeBytes;
+        }
+    }
+    object["children"] = list;
+    if (children.size() > kMaxChildren) {
+        QJsonObject more;
+        more["count"] = static_cast<qint64>(children.size() - kMaxChildren);
+        more["size"] = static_cast<qint64>(moreBytes);
+        object["more"] = more;
+    }
+    return object;
+}
+
+void CliRunner::writeMetrics(const QString &phase) {
+    const ScanMetrics::Snapshot now = ScanMetrics::snapshot();
+    if (m_options.metrics) {
+        QJsonObject line = ScanMetrics::toJson(now - m_phaseStart);
+        line["type"] = "metrics";
+        line["phase"] = phase;
+        writeLine(line);
+    }
+    m_phaseStart = now;
+    ScanMetrics::resetPeaks();
+
+    if (IoThrottle::shared().isEnabled()) {
+        const IoThrottle::Stats stats = IoThrottle::shared().stats();
+        QJsonObject line;
+        line["type"] = "throttle";
+        line["phase"] = phase;
+        line["rate"] = stats.rateFactor;
+        line["latency_ms"] = stats.latencyMs;
+        line["latency_target_ms"] = stats.latencyTargetMs;
+        // Summed over threads, so it can exceed the phase's wall time
+        line["throttled_ms"] = (stats.throttledNs - m_phaseThrottledNs) / 1000000;
+        writeLine(line);
+        m_phaseThrottledNs = stats.throttledNs;
+    }
+}
+
+void CliRunner::finish(int exitCode) {
+    // The file holds process totals, which is what a scraper of a one-shot run wants
+    if (!m_options.metricsFile.isEmpty() && !ScanMetrics::writeFile(m_options.metricsFile, ScanMetrics::snapshot())) {
+        std::fprintf(stderr, "Failed to write metrics to %s\n", qPrintable(m_options.metricsFile));
+    }
+    emit finished(exitCode);
+}
+
+void CliRunner::onProgress(const ScanProgress &snapshot) {
+    m_lastProgress = snapshot;
+    if (!m_options.progress) return;
+
+    QJsonObject line;
+    line["type"] = "progress";
+    line["path"] = snapshot.currentPath;
+    line["dirs"] = static_cast<qint64>(snapshot.dirsVisited);
+    line["dirs_per_sec"] = snapshot.dirsPerSecond;
+    line["caches"] = static_cast<qint64>(snapshot.cachesFound);
+    line["bytes"] = static_cast<qint64>(snapshot.bytesFound);
+    line["elapsed_ms"] = snapshot.elapsedMs;
+    writeLine(line);
+}
+
+void CliRunner::onResumed(int pendingDirs, int caches) {
+    QJsonObject line;
+    line["type"] = "resumed";
+    line["dirs"] = pendingDirs;
+    line["caches"] = caches;
+    writeLine(line);
+}
+
+void CliRunner::onCachesFound(const QList<CacheFolderInfo> &batch) {
+    ScanMetrics::uiBatchDelivered();
+    for (const CacheFolderInfo &info : batch) {
+        QJsonObject line;
+        line["type"] = "cache";
+        line["path"] = info.path();
+        line["size"] = static_cast<qint64>(info.sizeBytes);
+        if (info.reclaimableBytes != CacheFolderInfo::UnknownSize) {
+            line["reclaimable"] = static_cast<qint64>(info.reclaimableBytes);
+        }
+        if (info.lastModified > 0) line["modified"] = info.lastModified;
+        if (info.lastAccessed > 0) line["accessed"] = info.lastAccessed;
+        if (info.tree) line["tree"] = treeJson(*info.tree, info.tree->root(), m_options.treeDepth);
+        writeLine(line);
+    }
+    m_found.append(batch);
+}
+
+void CliRunner::onDeviceStats(const QList<DeviceScanStats> &devices) {
+    m_devices = devices;
+}
+
+void CliRunner::onPruneStats(const QList<PruneRuleStats> &rules) {
+    m_pruned = rules;
+}
+
+void CliRunner::onScanFinished() {
+    m_scanner->wait();
+
+    for (const DeviceScanStats &device : m_devices) {
+        QJsonObject line;
+        line["type"] = "device";
+        line["mount"] = device.mountPoint;
+        line["fs"] = device.fsType;
+        line["kind"] = device.kind;
+        line["concurrency"] = device.concurrency;
+        line["peak_concurrency"] = device.peakConcurrency;
+        line["dirs"] = static_cast<qint64>(device.dirs);
+        line["dirs_per_sec"] = device.dirsPerSecond;
+        line["caches"] = static_cast<qint64>(device.caches);
+        line["bytes"] = static_cast<qint64>(device.bytes);
+        line["skipped_mounts"] = static_cast<qint64>(device.skippedMounts);
+        line["busy_s"] = device.busySeconds;
+        writeLine(line);
+    }
+    for (const PruneRuleStats &rule : m_pruned) {
+        QJsonObject line;
+        line["type"] = "prune";
+        line["rule"] = rule.rule;
+        line["dirs"] = static_cast<qint64>(rule.dirs);
+        writeLine(line);
+    }
+
+    QJsonObject line;
+    line["type"] = "scan_done";
+    line["dirs"] = static_cast<qint64>(m_lastProgress.dirsVisited);
+    line["caches"] = static_cast<qint64>(m_lastProgress.cachesFound);
+    line["bytes"] = static_cast<qint64>(m_lastProgress.bytesFound);
+    line["elapsed_ms"] = m_lastProgress.elapsedMs;
+    line["complete"] = !m_scanner->wasStopped();
+    writeLine(line);
+    writeMetrics("scan");
+    if (m_options.trendDays > 0 && !m_scanner->wasStopped()) writeTrend();
+
+    // Only stopped by the runtime limit: the caches not reached yet may be just as old
+    if (!m_options.deleteFound || m_scanner->wasStopped()) {
+        finish(0);
+        return;
+    }
+    startDeletion();
+}
+
+// The scan just appended is the latest in the history; unchanged caches are left out
+void CliRunner::writeTrend() {
+    ScanHistory history;
+    if (!history.open(m_options.historyPath) || history.scans().size() < 2) return;
+    const int to = static_cast<int>(history.scans().size()) - 1;
+    const int from = qMin(to - 1, history.scanAt(history.scans().at(to).time - m_options.trendDays * 86400LL));
+
+    for (const ScanHistory::Change &change : history.compare(from, to)) {
+        if (change.status == ScanHistory::Status::Present && change.changeBytes() == 0) continue;
+        QJsonObject entry;
+        entry["type"] = "trend";
+        entry["path"] = change.path;
+        entry["status"] = change.status == ScanHistory::Status::New        ? "new"
+                        : change.status == ScanHistory::Status::Vanished ? "vanished"
+                                                                         : "present";
+        entry["before"] = static_cast<qint64>(change.beforeBytes);
+        entry["after"] = static_cast<qint64>(change.afterBytes);
+        entry["change"] = change.changeBytes();
+        if (change.samples >= 2) entry["bytes_per_day"] = qRound64(change.bytesPerDay);
+        writeLine(entry);
+    }
+}
+
+void CliRunner::writeKept(const CacheFolderInfo &info, const char *reason, qint64 ageDays) {
+    QJsonObject entry;
+    entry["type"] = "kept";
+    entry["path"] = info.path();
+    entry["size"] = static_cast<qint64>(info.sizeBytes);
+    entry["reason"] = reason;
+    if (ageDays >= 0) entry["age_days"] = ageDays;
+    writeLine(entry);
+}
+
+/*
+ * The age policy looks at the newest modification the scan saw inside each cache,
+ * and at the folder's own modification time where the scan reported none. A cache
+ * with neither (gone or unreadable by now) has no known age and is kept.
+ */
+void CliRunner::startDeletion() {
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    QList<CacheFolderInfo> eligible;
+    for (const CacheFolderInfo &info : std::as_const(m_found)) {
+        if (m_options.olderThanDays > 0) {
+            qint64 modified = info.lastModified;
+            if (modified <= 0) {
+                const QDateTime folderModified = QFileInfo(info.path()).lastModified();
+                if (!folderModified.isValid()) {
+                    writeKept(info, "age", -1);
+                    continue;
+                }
+                modified = folderModified.toSecsSinceEpoch();
+            }
+            const qint64 ageDays = (now - modified) / 86400;
+            if (ageDays < m_options.olderThanDays) {
+                writeKept(info, "age", ageDays);
+                continue;
+            }
+        }
+        eligible.append(info);
+    }
+    if (m_options.freeBytes > 0 || m_options.keepAvailableBytes > 0) eligible = planDeletion(eligible);
+
+    QStringList paths;
+    for (const CacheFolderInfo &info : std::as_const(eligible)) {
+        const QString path = info.path();
+        if (m_options.dryRun) {
+            QJsonObject entry;
+            entry["type"] = "would_delete";
+            entry["path"] = path;
+            entry["size"] = static_cast<qint64>(info.sizeBytes);
+            writeLine(entry);
+            continue;
+        }
+        paths.append(path);
+    }
+
+    if (paths.isEmpty()) {
+        finish(0);
+        return;
+    }
+
+    m_deletion = new DeletionService(this);
+    m_deletion->setThreadCount(m_options.threads);
+    connect(m_deletion, &DeletionService::pathFinished, this, &CliRunner::onPathDeleted);
+    connect(m_deletion, &DeletionService::finished, this, &CliRunner::onDeletionFinished);
+    m_deletion->start(paths);
+}
+
+// The caches the plan picks, in scan order; a kept line for each of the others
+QList<CacheFolderInfo> CliRunner::planDeletion(const QList<CacheFolderInfo> &eligible) {
+    const quint64 goal = m_options.keepAvailableBytes > 0
+        ? ReclaimPlanner::bytesUntilAvailable(m_options.rootPath, m_options.keepAvailableBytes)
+        : m_options.freeBytes;
+    const ReclaimPlanner::VolumeMap volumes;
+    const quint64 volume = volumes.volumeOf(m_options.rootPath, true);
+    const FavoritesManager favorites;
+
+    QList<CacheFolderInfo> candidates;
+    QList<ReclaimPlanner::Candidate> planned;
+    for (const CacheFolderInfo &info : eligible) {
+        // Freeing space on another volume brings this one no closer to the goal
+        if (volumes.volumeOf(info.path()) != volume) {
+            writeKept(info, "other_volume");
+            continue;
+        }
+        const quint64 bytes = info.reclaimableBytes != CacheFolderInfo::UnknownSize ? info.reclaimableBytes : info.sizeBytes;
+        candidates.append(info);
+        planned.append({info.pathId, bytes, info.lastUsed(), favorites.isFavorite(info.pathId)});
+    }
+
+    const ReclaimPlanner::Plan plan = ReclaimPlanner().plan(planned, goal);
+    QJsonObject line;
+    line["type"] = "plan";
+    line["goal"] = static_cast<qint64>(plan.goalBytes);
+    line["planned"] = static_cast<qint64>(plan.plannedBytes);
+    line["caches"] = static_cast<qint64>(plan.items.size());
+    line["reaches_goal"] = plan.reachesGoal();
+    line["protected"] = plan.protectedCount;
+    line["protected_bytes"] = static_cast<qint64>(plan.protectedBytes);
+    writeLine(line);
+
+    QSet<PathStore::Id> picked;
+    for (const ReclaimPlanner::Item &item : plan.items) picked.insert(item.pathId);
+    QList<CacheFolderInfo> result;
+    for (qsizetype i = 0; i < candidates.size(); ++i) {
+        if (picked.contains(candidates[i].pathId)) {
+            result.append(candidates[i]);
+        } else {
+            writeKept(candidates[i], planned[i].isProtected ? "favorite" : "not_needed");
+        }
+    }
+    return result;
+}
+
+void CliRunner::onPathDeleted(const DeletionResult &result) {
+    m_bytesFreed += result.bytesFreed;
+    m_filesFreed += result.filesFreed;
+    if (!result.success) ++m_failures;
+
+    QJsonObject line;
+    line["type"] = "deleted";
+    line["path"] = result.path;
+    line["ok"] = result.success;
+    line["bytes"] = static_cast<qint64>(result.bytesFreed);
+    line["files"] = static_cast<qint64>(result.filesFreed);
+    if (!result.success) line["error"] = result.error;
+    writeLine(line);
+}
+
+void CliRunner::onDeletionFinished(bool cancelled) {
+    QJsonObject line;
+    line["type"] = "delete_done";
+    line["bytes"] = static_cast<qint64>(m_bytesFreed);
+    line["files"] = static_cast<qint64>(m_filesFreed);
+    line["failed"] = m_failures;
+    line["cancelled"] = cancelled;
+    writeLine(line);
+    writeMetrics("delete");
+
+    // Cut short by the runtime limit, the rest is left for the next run
+    finish(m_failures > 0 || (cancelled && !m_deadlineReached) ? 1 : 0);
+}
+
+void CliRunner::onDeadline() {
+    m_deadlineReached = true;
+    if (m_deletion && m_deletion->isRunning()) {
+        m_deletion->cancel();
+    } else if (m_scanner && m_scanner->isRunning()) {
+        m_scanner->stop();
+    }
+}
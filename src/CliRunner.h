@@ -0,0 +1,122 @@
+#ifndef CLIRUNNER_H
+#define CLIRUNNER_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QObject>
+#include <QStringList>
+
+#include "CacheScanner.h"
+#include "DeletionService.h"
+#include "IoThrottle.h"
+#include "ScanMetrics.h"
+
+/*
+ * Drives one headless scan (and optionally the deletion of what it found) and
+ * streams every event to stdout as one JSON object per line, flushed as it happens:
+ *
+ *   {"type":"resumed","dirs":...,"caches":...}        with --checkpoint, when continuing a saved scan
+ *   {"type":"cache","path":...,"size":...[,"reclaimable":...][,"modified":...,"accessed":...][,"tree":...]}
+ *                                                      for each cache at or above the minimum size
+ *   {"type":"progress","dirs":...,...}                 with --progress, at the scanner's batch rate
+ *   {"type":"device","mount":...,"kind":...,"dirs":...,...}   per device the scan touched
+ *   {"type":"prune","rule":...,"dirs":...}            per prune rule, directories it skipped
+ *   {"type":"scan_done","dirs":...,"caches":...,"bytes":...,"elapsed_ms":...,"complete":...}
+ *   {"type":"trend","path":...,"status":...,"before":...,"after":...,"change":...[,"bytes_per_day":...]}
+ *                                                      with --trend, per cache that changed since the scan
+ *                                                      that many days ago: "present", "new" or "vanished"
+ *   {"type":"metrics","phase":"scan"|"delete",...}     with --metrics, counters of that phase
+ *   {"type":"throttle","phase":...,"rate":...,"latency_ms":...,"throttled_ms":...}   when throttled
+ *   {"type":"kept","path":...,"size":...,"reason":...[,"age_days":...]}   with --delete, caches left alone:
+ *                                                      "age" (--older-than), "favorite", "other_volume"
+ *                                                      or "not_needed" (--free, --keep-free)
+ *   {"type":"plan","goal":...,"planned":...,"caches":...,"reaches_goal":...,"protected":...}   with --free or --keep-free
+ *   {"type":"would_delete","path":...,"size":...}     with --delete --dry-run
+ *   {"type":"deleted","path":...,"ok":...,"bytes":...,"files":...[,"error":...]}
+ *   {"type":"delete_done","bytes":...,"files":...,"failed":...,"cancelled":...}
+ *
+ * A scan cut short by the runtime limit deletes nothing; with a checkpoint the next
+ * run continues it. Deletion still going at the limit is cancelled.
+ *
+ * With a reclaim goal only the caches a ReclaimPlanner picks are deleted: among those
+ * on the root's volume, old enough for --older-than and not favorites.
+ */
+class CliRunner : public QObject {
+    Q_OBJECT
+public:
+    struct Options {
+        QString rootPath;
+        quint64 minSizeBytes = 50ULL * 1024 * 1024;
+        int threads = 0;
+        bool progress = false;
+        bool deleteFound = false;
+        bool dryRun = false;
+        QString indexPath;
+        bool allocated = false; // also report reclaimable bytes per cache
+        int treeDepth = 0;      // levels of each cache's size tree to emit, 0 = none
+        bool oneFileSystem = false;
+        int perDevice = 0;      // worker limit per device, 0 = by device kind
+        DirectorySizer::Backend sizeBackend = DirectorySizer::Backend::Auto;
+        unsigned queueDepth = DirectorySizer::kDefaultQueueDepth;
+        QStringList cachePatterns = CacheMatcher::defaultPatterns();
+        QStringList pruneRules;
+        bool metrics = false;
+        QString metricsFile;    // written on exit; JSON for *.json, Prometheus text otherwise
+        QString checkpointPath; // scan state to continue from and save to, see CacheScanner
+        QString historyPath;    // ScanHistory every complete scan is appended to
+        int trendDays = 0;      // with historyPath, report growth since the scan this long ago; 0 = none
+        int checkpointInterval = 60; // seconds
+        IoThrottle::Limits throttle; // no ceilings = flat out
+        int olderThanDays = 0;  // with deleteFound, only caches with nothing inside changed this long
+        quint64 freeBytes = 0;  // with deleteFound, only the planned caches that free this much
+        quint64 keepAvailableBytes = 0; // same, for what is missing to this much available on the root's volume
+        int maxRuntimeSeconds = 0; // 0 = no limit
+    };
+
+    explicit CliRunner(const Options &options, QObject *parent = nullptr);
+
+    void start();
+
+signals:
+    // 0 on success, 1 when any deletion failed
+    void finished(int exitCode);
+
+private slots:
+    void onProgress(const ScanProgress &snapshot);
+    void onResumed(int pendingDirs, int caches);
+    void onCachesFound(const QList<CacheFolderInfo> &batch);
+    void onDeviceStats(const QList<DeviceScanStats> &devices);
+    void onPruneStats(const QList<PruneRuleStats> &rules);
+    void onScanFinished();
+    void onPathDeleted(const DeletionResult &result);
+    void onDeletionFinished(bool cancelled);
+    void onDeadline();
+
+private:
+    Options m_options;
+    CacheScanner *m_scanner;
+    DeletionService *m_deletion;
+    QFile m_out;
+
+    ScanProgress m_lastProgress;
+    QList<CacheFolderInfo> m_found;
+    QList<DeviceScanStats> m_devices;
+    QList<PruneRuleStats> m_pruned;
+    quint64 m_bytesFreed;
+    quint64 m_filesFreed;
+    int m_failures;
+    ScanMetrics::Snapshot m_phaseStart;
+    qint64 m_phaseThrottledNs;
+    bool m_deadlineReached;
+
+    void writeLine(const QJsonObject &object);
+    QJsonObject treeJson(const SizeTree &tree, quint32 node, int depth) const;
+    void writeMetrics(const QString &phase);
+    void writeTrend();
+    void startDeletion();
+    QList<CacheFolderInfo> planDeletion(const QList<CacheFolderInfo> &eligible);
+    void writeKept(const CacheFolderInfo &info, const char *reason, qint64 ageDays = -1);
+    void finish(int exitCode);
+};
+
+#endif // CLIRUNNER_H
@@ -0,0 +1,408 @@
+#include "DeletionService.h"
+#include "IoThrottle.h"
+#include "ScanIndex.h"
+#include "ScanMetrics.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+struct DeletionService::Job {
+    QString path;
+    QByteArray nativePath;
+    std::shared_ptr<std::atomic<bool>> cancel; // shared by the jobs of one batch
+    std::atomic<int> pending{1}; // listing of the top folder + one per dispatched subtree
+    std::atomic<quint64> bytesFreed{0};
+    std::atomic<quint64> filesFreed{0};
+    QElapsedTimer elapsed;
+
+    QMutex errorMutex;
+    QString error;
+
+    void fail(const QString &message) {
+        QMutexLocker locker(&errorMutex);
+        if (error.isEmpty()) error = message;
+    }
+    bool failed() {
+        QMutexLocker locker(&errorMutex);
+        return !error.isEmpty();
+    }
+};
+
+DeletionService::DeletionService(QObject *parent)
+    : QObject(parent), m_cancel(std::make_shared<std::atomic<bool>>(false)), m_activeJobs(0), m_bytesFreed(0), m_filesFreed(0),
+      m_lowPriority(false) {
+    setFileSystem(nullptr);
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+    m_progressTimer.setInterval(100);
+    connect(&m_progressTimer, &QTimer::timeout, this, [this]() {
+        emit progress(m_bytesFreed.load(), m_filesFreed.load());
+    });
+}
+
+DeletionService::~DeletionService() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+void DeletionService::setThreadCount(int count) {
+    m_pool.setMaxThreadCount(count > 0 ? count : qMax(2, QThread::idealThreadCount()));
+}
+
+void DeletionService::setFileSystem(FileSystem *fs) {
+    m_fs = FileSystem::virtualOrNull(fs);
+#ifndef Q_OS_UNIX
+    // No fd-relative walks here; the local disk is split into tasks through its FileSystem
+    if (!m_fs) m_fs = &FileSystem::local();
+#endif
+}
+
+void DeletionService::setLowPriority(bool enabled) {
+    m_lowPriority = enabled;
+    m_pool.setThreadPriority(enabled ? QThread::LowestPriority : QThread::InheritPriority);
+}
+
+// Per pool thread, once; the pool is private, so its threads never run anything else
+void DeletionService::applyIoPriority() const {
+    thread_local bool applied = false;
+    if (!m_lowPriority || applied) return;
+    applied = true;
+    IoThrottle::setIdleIoPriority();
+}
+
+void DeletionService::start(const QStringList &paths) {
+    if (paths.isEmpty()) return;
+
+    if (!isRunning()) {
+        m_bytesFreed = 0;
+        m_filesFreed = 0;
+        m_progressTimer.start();
+    }
+    // Paths queued while a cancelled batch drains start a batch of their own
+    if (m_cancel->load()) m_cancel = std::make_shared<std::atomic<bool>>(false);
+
+    m_activeJobs.fetch_add(static_cast<int>(paths.size()));
+    for (const QString &path : paths) {
+        auto job = std::make_shared<Job>();
+        job->cancel = m_cancel;
+        job->path = path;
+        job->nativePath = QFile::encodeName(QDir::cleanPath(path));
+        job->elapsed.start();
+        m_pool.start([this, job]() { runJob(job); });
+    }
+}
+
+// Earlier batches are either cancelled already or were joined by the current one
+void DeletionService::cancel() {
+    *m_cancel = true;
+}
+
+void DeletionService::runJob(const std::shared_ptr<Job> &job) {
+    applyIoPriority();
+    IoThrottle::pace(job->cancel.get()); // restarts this thread's busy clock after idling
+    if (*job->cancel) {
+        finishJobPart(job);
+        return;
+    }
+    if (m_fs) {
+        listTopWith(job);
+        finishJobPart(job);
+        return;
+    }
+
+#ifdef Q_OS_UNIX
+    int fd = ::open(job->nativePath.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        // Already gone counts as deleted
+        if (errno != ENOENT) {
+            ScanMetrics::addError(errno);
+            job->fail(qt_error_string(errno));
+        }
+        finishJobPart(job);
+        return;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+
+    DIR *dir = fdopendir(fd);
+    if (!dir) {
+        job->fail(qt_error_string(errno));
+        ::close(fd);
+        finishJobPart(job);
+        return;
+    }
+
+    // Files at the top level go right away, every subdirectory becomes its own task
+    QStringList subdirs;
+    while (struct dirent *entry = readdir(dir)) {
+        if (*job->cancel) break;
+
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        ScanMetrics::add(ScanMetrics::EntriesRead);
+        IoThrottle::pace(job->cancel.get());
+
+        bool isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            ScanMetrics::add(ScanMetrics::StatCalls);
+            struct stat st;
+            isDir = fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+
+        if (isDir) {
+            subdirs.append(QFile::decodeName(name));
+        } else {
+            unlinkEntry(dirfd(dir), name, *job);
+        }
+    }
+    closedir(dir);
+
+    job->pending.fetch_add(static_cast<int>(subdirs.size()));
+    for (const QString &name : subdirs) {
+        m_pool.start([this, job, name]() { runSubtree(job, name); });
+    }
+#endif
+
+    finishJobPart(job);
+}
+
+void DeletionService::runSubtree(const std::shared_ptr<Job> &job, const QString &name) {
+    applyIoPriority();
+    IoThrottle::pace(job->cancel.get());
+    if (m_fs) {
+        if (!*job->cancel) removeTreeWith(ScanIndex::joinPath(job->path, name), *job);
+        finishJobPart(job);
+        return;
+    }
+#ifdef Q_OS_UNIX
+    if (!*job->cancel) {
+        int parentFd = ::open(job->nativePath.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (parentFd < 0) {
+            job->fail(qt_error_string(errno));
+        } else {
+            removeAt(parentFd, QFile::encodeName(name).constData(), *job);
+            ::close(parentFd);
+        }
+    }
+#else
+    Q_UNUSED(name); // m_fs is always set here
+#endif
+    finishJobPart(job);
+}
+
+/*
+ * Called once per finished piece of a job; the last piece removes the (now empty)
+ * top folder and publishes the result.
+ */
+void DeletionService::finishJobPart(const std::shared_ptr<Job> &job) {
+    if (job->pending.fetch_sub(1) != 1) return;
+
+    if (*job->cancel) {
+        job->fail(QStringLiteral("Cancelled"));
+    } else if (m_fs) {
+        if (!job->failed()) removeEntryWith(job->path, {QString(), FileSystem::Type::Directory}, *job);
+    }
+#ifdef Q_OS_UNIX
+    else if (!job->failed()) {
+        if (::rmdir(job->nativePath.constData()) == 0) {
+            ScanMetrics::add(ScanMetrics::DirsRemoved);
+        } else if (errno != ENOENT) {
+            ScanMetrics::addError(errno);
+            job->fail(qt_error_string(errno));
+        }
+    }
+#endif
+    ScanMetrics::record(ScanMetrics::DeletePath, job->elapsed.nsecsElapsed());
+
+    DeletionResult result;
+    result.path = job->path;
+    result.error = job->error;
+    result.success = result.error.isEmpty();
+    result.bytesFreed = job->bytesFreed.load();
+    result.filesFreed = job->filesFreed.load();
+    emit pathFinished(result);
+
+    if (m_activeJobs.fetch_sub(1) == 1) {
+        // Queued behind the pathFinished() deliveries above
+        QMetaObject::invokeMethod(this, [this]() { onAllJobsDone(); }, Qt::QueuedConnection);
+    }
+}
+
+void DeletionService::onAllJobsDone() {
+    if (isRunning()) return; // new paths were queued in the meantime
+    m_progressTimer.stop();
+    emit progress(m_bytesFreed.load(), m_filesFreed.load());
+    emit finished(m_cancel->load());
+}
+
+#ifdef Q_OS_UNIX
+
+bool DeletionService::unlinkEntry(int dirFd, const char *name, Job &job) {
+    struct stat st;
+    ScanMetrics::add(ScanMetrics::StatCalls);
+    quint64 size = fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 ? static_cast<quint64>(st.st_size) : 0;
+
+    if (unlinkat(dirFd, name, 0) != 0) {
+        if (errno == ENOENT) return true;
+        ScanMetrics::addError(errno);
+        job.fail(QFile::decodeName(name) + ": " + qt_error_string(errno));
+        return false;
+    }
+
+    countFreed(job, size);
+    return true;
+}
+
+// Depth-first removal relative to the parent fd; one open fd per tree level.
+bool DeletionService::removeAt(int parentFd, const char *name, Job &job) {
+    for (int pass = 0; pass < 2; ++pass) {
+        int fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) return true;
+            // Symlink or file that raced in place of the directory: unlink it, never follow it
+            if (errno == ENOTDIR || errno == ELOOP) return unlinkEntry(parentFd, name, job);
+            ScanMetrics::addError(errno);
+            job.fail(QFile::decodeName(name) + ": " + qt_error_string(errno));
+            return false;
+        }
+        ScanMetrics::add(ScanMetrics::DirsOpened);
+
+        DIR *dir = fdopendir(fd);
+        if (!dir) {
+            job.fail(QFile::decodeName(name) + ": " + qt_error_string(errno));
+            ::close(fd);
+            return false;
+        }
+
+        bool ok = true;
+        while (struct dirent *entry = readdir(dir)) {
+            if (*job.cancel) {
+                closedir(dir);
+                return false;
+            }
+
+            const char *child = entry->d_name;
+            if (child[0] == '.' && (child[1] == '\0' || (child[1] == '.' && child[2] == '\0'))) continue;
+            ScanMetrics::add(ScanMetrics::EntriesRead);
+            IoThrottle::pace(job.cancel.get());
+
+            bool isDir = entry->d_type == DT_DIR;
+            if (entry->d_type == DT_UNKNOWN) {
+                ScanMetrics::add(ScanMetrics::StatCalls);
+                struct stat st;
+                isDir = fstatat(dirfd(dir), child, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+            }
+            ok &= isDir ? removeAt(dirfd(dir), child, job) : unlinkEntry(dirfd(dir), child, job);
+        }
+        closedir(dir);
+
+        if (unlinkat(parentFd, name, AT_REMOVEDIR) == 0) {
+            ScanMetrics::add(ScanMetrics::DirsRemoved);
+            return true;
+        }
+        if (errno == ENOENT) return true;
+        // Some filesystems skip entries when unlinking while listing; one more pass picks them up
+        if (errno == ENOTEMPTY && ok && pass == 0) continue;
+
+        ScanMetrics::addError(errno);
+        job.fail(QFile::decodeName(name) + ": " + qt_error_string(errno));
+        return false;
+    }
+    return false;
+}
+
+#endif // Q_OS_UNIX
+
+
+void DeletionService::countFreed(Job &job, quint64 size) {
+    ScanMetrics::add(ScanMetrics::FilesUnlinked);
+    ScanMetrics::add(ScanMetrics::BytesFreed, size);
+    job.bytesFreed.fetch_add(size, std::memory_order_relaxed);
+    job.filesFreed.fetch_add(1, std::memory_order_relaxed);
+    m_bytesFreed.fetch_add(size, std::memory_order_relaxed);
+    m_filesFreed.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The FileSystem counterpart of runJob()'s listing: files at the top go right away, every subdirectory becomes its own task.
+// Also how the local disk is deleted where there are no fd-relative walks.
+void DeletionService::listTopWith(const std::shared_ptr<Job> &job) {
+    QList<FileSystem::Entry> entries;
+    const FileSystem::Error error = m_fs->list(job->path, entries);
+    if (error != FileSystem::Error::None) {
+        // Already gone counts as deleted
+        if (error != FileSystem::Error::NotFound) {
+            FileSystem::recordError(error);
+            job->fail(FileSystem::errorString(error));
+        }
+        return;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+
+    QStringList subdirs;
+    for (const FileSystem::Entry &entry : std::as_const(entries)) {
+        if (*job->cancel) break;
+        ScanMetrics::add(ScanMetrics::EntriesRead);
+        IoThrottle::pace(job->cancel.get());
+        if (entry.type == FileSystem::Type::Directory) {
+            subdirs.append(entry.name);
+        } else {
+            removeEntryWith(ScanIndex::joinPath(job->path, entry.name), entry, *job);
+        }
+    }
+
+    job->pending.fetch_add(static_cast<int>(subdirs.size()));
+    for (const QString &name : subdirs) {
+        m_pool.start([this, job, name]() { runSubtree(job, name); });
+    }
+}
+
+// Depth-first like removeAt(), one listing per directory
+bool DeletionService::removeTreeWith(const QString &path, Job &job) {
+    QList<FileSystem::Entry> entries;
+    const FileSystem::Error error = m_fs->list(path, entries);
+    if (error == FileSystem::Error::NotFound) return true;
+    // Not a directory after all: removed like any other entry
+    if (error == FileSystem::Error::NotDirectory) return removeEntryWith(path, {}, job);
+    if (error != FileSystem::Error::None) {
+        FileSystem::recordError(error);
+        job.fail(path + ": " + FileSystem::errorString(error));
+        return false;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+
+    bool ok = true;
+    for (const FileSystem::Entry &entry : std::as_const(entries)) {
+        if (*job.cancel) return false;
+        ScanMetrics::add(ScanMetrics::EntriesRead);
+        IoThrottle::pace(job.cancel.get());
+        const QString child = ScanIndex::joinPath(path, entry.name);
+        ok &= entry.type == FileSystem::Type::Directory ? removeTreeWith(child, job) : removeEntryWith(child, entry, job);
+    }
+    return ok && removeEntryWith(path, {QString(), FileSystem::Type::Directory}, job);
+}
+
+// `entry` as listed; its size is what removing a file frees
+bool DeletionService::removeEntryWith(const QString &path, const FileSystem::Entry &entry, Job &job) {
+    const FileSystem::Error error = m_fs->remove(path);
+    if (error == FileSystem::Error::NotFound) return true;
+    if (error != FileSystem::Error::None) {
+        FileSystem::recordError(error);
+        job.fail(path + ": " + FileSystem::errorString(error));
+        return false;
+    }
+    if (entry.type == FileSystem::Type::Directory) {
+        ScanMetrics::add(ScanMetrics::DirsRemoved);
+    } else {
+        countFreed(job, entry.size);
+    }
+    return true;
+}
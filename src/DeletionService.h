@@ -0,0 +1,82 @@
+#ifndef DELETIONSERVICE_H
+#define DELETIONSERVICE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+
+#include "FileSystem.h"
+
+struct DeletionResult {
+    QString path;
+    bool success = false;
+    QString error;
+    quint64 bytesFreed = 0;
+    quint64 filesFreed = 0;
+};
+
+/*
+ * Deletes folders on a private thread pool so the GUI never blocks.
+ * Each requested path is listed once; its immediate subdirectories are then removed
+ * as independent pool tasks, and the last task to finish removes the now-empty top
+ * folder and reports the result. On POSIX the local disk is walked fd-relative
+ * (openat/unlinkat); elsewhere, and through any other FileSystem, the same split
+ * runs on the FileSystem's list() and remove() calls.
+ * Progress is sampled from atomic counters by a timer, so workers never wait on it.
+ */
+class DeletionService : public QObject {
+    Q_OBJECT
+public:
+    explicit DeletionService(QObject *parent = nullptr);
+    ~DeletionService();
+
+    void setThreadCount(int count);
+    // Lowest thread priority, and on Linux the idle I/O class, for background purging
+    void setLowPriority(bool enabled);
+    // Not owned, must outlive the deletions; null or FileSystem::local() deletes from the disk
+    void setFileSystem(FileSystem *fs);
+    bool isRunning() const { return m_activeJobs.load() > 0; }
+
+public slots:
+    void start(const QStringList &paths);
+    void cancel();
+
+signals:
+    void progress(quint64 bytesFreed, quint64 filesFreed);
+    void pathFinished(DeletionResult result);
+    void finished(bool cancelled);
+
+private:
+    struct Job;
+
+    QThreadPool m_pool;
+    QTimer m_progressTimer;
+    std::shared_ptr<std::atomic<bool>> m_cancel; // the latest batch's; each job holds its own batch's
+    std::atomic<int> m_activeJobs;
+    std::atomic<quint64> m_bytesFreed;
+    std::atomic<quint64> m_filesFreed;
+    bool m_lowPriority;
+    FileSystem *m_fs = nullptr; // null for the local disk on POSIX only
+
+    void runJob(const std::shared_ptr<Job> &job);
+    void runSubtree(const std::shared_ptr<Job> &job, const QString &name);
+    void finishJobPart(const std::shared_ptr<Job> &job);
+    void onAllJobsDone();
+    void applyIoPriority() const;
+    void countFreed(Job &job, quint64 size);
+
+    void listTopWith(const std::shared_ptr<Job> &job);
+    bool removeTreeWith(const QString &path, Job &job);
+    bool removeEntryWith(const QString &path, const FileSystem::Entry &entry, Job &job);
+
+#ifdef Q_OS_UNIX
+    bool removeAt(int parentFd, const char *name, Job &job);
+    bool unlinkEntry(int dirFd, const char *name, Job &job);
+#endif
+};
+
+#endif // DELETIONSERVICE_H
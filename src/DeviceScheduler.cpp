@@ -0,0 +1,253 @@
+#include "DeviceScheduler.h"
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QStorageInfo>
+
+namespace {
+
+using Mount = DeviceScheduler::Mount;
+
+const QSet<QString> kPseudoFileSystems = {
+    "proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "securityfs", "debugfs", "tracefs",
+    "pstore", "bpf", "configfs", "fusectl", "mqueue", "hugetlbfs", "autofs", "binfmt_misc",
+    "efivarfs", "rpc_pipefs", "nsfs", "selinuxfs"
+};
+
+const QSet<QString> kNetworkFileSystems = {
+    "nfs", "nfs4", "cifs", "smb3", "smbfs", "9p", "afs", "ceph", "glusterfs", "lustre", "davfs",
+    "fuse.sshfs", "fuse.rclone", "fuse.s3fs", "fuse.gvfsd-fuse", "fuse.glusterfs"
+};
+
+bool isUnder(const QString &path, const QString &dir) {
+    if (dir == QLatin1String("/")) return path.startsWith('/');
+    return path == dir || (path.startsWith(dir) && path.at(dir.size()) == '/');
+}
+
+#ifdef Q_OS_LINUX
+// mountinfo escapes space, tab, newline and backslash as \ooo
+QString unescapeMountField(const QByteArray &field) {
+    QByteArray out;
+    out.reserve(field.size());
+    for (qsizetype i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size()) {
+            bool ok = false;
+            const int code = field.mid(i + 1, 3).toInt(&ok, 8);
+            if (ok) {
+                out.append(static_cast<char>(code));
+                i += 3;
+                continue;
+            }
+        }
+        out.append(field[i]);
+    }
+    return QFile::decodeName(out);
+}
+
+// Fields: id parent major:minor root mountpoint options [optional...] - fstype source superoptions
+QList<Mount> readMounts() {
+    QList<Mount> mounts;
+    QFile file(QStringLiteral("/proc/self/mountinfo"));
+    if (!file.open(QIODevice::ReadOnly)) return mounts;
+
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        const QList<QByteArray> fields = line.split(' ');
+        const qsizetype separator = fields.indexOf(QByteArray("-"));
+        if (fields.size() < 5 || separator < 0 || separator + 1 >= fields.size()) continue;
+        mounts.append({QString::fromLatin1(fields[2]), unescapeMountField(fields[4]),
+                       QString::fromLatin1(fields[separator + 1])});
+    }
+    return mounts;
+}
+#else
+QList<Mount> readMounts() {
+    QList<Mount> mounts;
+    for (const QStorageInfo &volume : QStorageInfo::mountedVolumes()) {
+        mounts.append({QString::fromLocal8Bit(volume.device()), QDir::cleanPath(volume.rootPath()),
+                       QString::fromLatin1(volume.fileSystemType())});
+    }
+    return mounts;
+}
+#endif
+
+}
+
+DeviceScheduler::DeviceScheduler()
+    : m_rootDevice(0), m_oneFileSystem(false) {
+}
+
+QList<DeviceScheduler::Mount> DeviceScheduler::mountTable() {
+    return readMounts();
+}
+
+void DeviceScheduler::load(const QString &rootPath, int workers, int perDeviceLimit, bool oneFileSystem) {
+    m_devices.clear();
+    m_mountPoints.clear();
+    m_oneFileSystem = oneFileSystem;
+
+    const QString root = QDir::cleanPath(rootPath);
+    const QList<Mount> mounts = readMounts();
+
+    // The root lives on the innermost mount containing it
+    const Mount *rootMount = nullptr;
+    for (const Mount &mount : mounts) {
+        if (isUnder(root, mount.mountPoint) && (!rootMount || mount.mountPoint.size() >= rootMount->mountPoint.size())) {
+            rootMount = &mount;
+        }
+    }
+    m_rootDevice = rootMount
+        ? addDevice(rootMount->id, rootMount->mountPoint, rootMount->fsType, workers, perDeviceLimit)
+        : addDevice(QStringLiteral("root"), root, QString(), workers, perDeviceLimit);
+    // Asked to scan a pseudo filesystem itself: allowed, just not into further ones
+    Device &rootDevice = *m_devices[m_rootDevice];
+    rootDevice.limit = qMax(1, rootDevice.limit);
+
+    // Later entries are mounted over earlier ones at the same point, so they win
+    for (const Mount &mount : mounts) {
+        if (mount.mountPoint == root || !isUnder(mount.mountPoint, root)) continue;
+        m_mountPoints.insert(mount.mountPoint, addDevice(mount.id, mount.mountPoint, mount.fsType, workers, perDeviceLimit));
+    }
+}
+
+void DeviceScheduler::loadSingle(const QString &rootPath, int workers, int perDeviceLimit) {
+    m_devices.clear();
+    m_mountPoints.clear();
+    m_oneFileSystem = false;
+    m_rootDevice = addDevice(QStringLiteral("virtual"), QDir::cleanPath(rootPath), QStringLiteral("virtual"), workers, perDeviceLimit);
+}
+
+int DeviceScheduler::addDevice(const QString &id, const QString &mountPoint, const QString &fsType,
+                               int workers, int perDeviceLimit) {
+    for (size_t i = 0; i < m_devices.size(); ++i) {
+        if (m_devices[i]->id == id) return static_cast<int>(i);
+    }
+
+    auto device = std::make_unique<Device>();
+    device->id = id;
+    device->mountPoint = mountPoint;
+    device->fsType = fsType;
+    device->kind = classify(id, fsType);
+    switch (device->kind) {
+    case Kind::Pseudo: device->limit = 0; break;
+    case Kind::Rotational:
+    case Kind::Network: device->limit = qMin(2, workers); break;
+    case Kind::Solid:
+    case Kind::Unknown: device->limit = workers; break;
+    }
+    if (perDeviceLimit > 0 && device->kind != Kind::Pseudo) device->limit = qMin(perDeviceLimit, workers);
+    device->limit = qMax(device->kind == Kind::Pseudo ? 0 : 1, device->limit);
+
+    m_devices.push_back(std::move(device));
+    return static_cast<int>(m_devices.size() - 1);
+}
+
+DeviceScheduler::Kind DeviceScheduler::classify(const QString &id, const QString &fsType) {
+    if (kPseudoFileSystems.contains(fsType)) return Kind::Pseudo;
+    if (kNetworkFileSystems.contains(fsType)) return Kind::Network;
+#ifdef Q_OS_LINUX
+    // Block devices expose queue/rotational; partitions only through their parent disk
+    if (!id.startsWith(QLatin1String("0:"))) {
+        for (const QString &path : {QStringLiteral("/sys/dev/block/%1/queue/rotational"),
+                                    QStringLiteral("/sys/dev/block/%1/../queue/rotational")}) {
+            QFile file(path.arg(id));
+            if (!file.open(QIODevice::ReadOnly)) continue;
+            return file.readAll().trimmed() == "1" ? Kind::Rotational : Kind::Solid;
+        }
+    }
+#else
+    Q_UNUSED(id);
+#endif
+    return Kind::Unknown;
+}
+
+int DeviceScheduler::deviceFor(const QString &path, int parentDevice) const {
+    auto it = m_mountPoints.constFind(path);
+    if (it == m_mountPoints.constEnd()) return parentDevice;
+
+    const Device &device = *m_devices[it.value()];
+    if (device.kind == Kind::Pseudo || (m_oneFileSystem && it.value() != m_rootDevice)) {
+        device.skippedMounts.fetch_add(1, std::memory_order_relaxed);
+        return NoDevice;
+    }
+    return it.value();
+}
+
+int DeviceScheduler::deviceForPath(const QString &rootPath, const QString &path) const {
+    int device = m_rootDevice;
+    if (!hasMounts()) return device;
+
+    // Every directory between the root and `path`, as the walk would have met them
+    qsizetype slash = rootPath.size();
+    while ((slash = path.indexOf('/', slash + 1)) != -1) {
+        device = deviceFor(path.left(slash), device);
+        if (device == NoDevice) return NoDevice;
+    }
+    return deviceFor(path, device);
+}
+
+bool DeviceScheduler::tryAcquire(int index) {
+    Device &device = *m_devices[index];
+    int active = device.active.load(std::memory_order_relaxed);
+    do {
+        if (active >= device.limit) return false;
+    } while (!device.active.compare_exchange_weak(active, active + 1, std::memory_order_acquire));
+
+    int peak = device.peakActive.load(std::memory_order_relaxed);
+    while (active + 1 > peak && !device.peakActive.compare_exchange_weak(peak, active + 1, std::memory_order_relaxed)) {}
+    return true;
+}
+
+void DeviceScheduler::release(int index) {
+    m_devices[index]->active.fetch_sub(1, std::memory_order_release);
+}
+
+void DeviceScheduler::recordDirectory(int index, qint64 busyNs) {
+    Device &device = *m_devices[index];
+    device.dirs.fetch_add(1, std::memory_order_relaxed);
+    device.busyNs.fetch_add(static_cast<quint64>(qMax<qint64>(0, busyNs)), std::memory_order_relaxed);
+}
+
+// Sizing time is already part of the listing job that found the cache
+void DeviceScheduler::recordCache(int index, quint64 bytes) {
+    Device &device = *m_devices[index];
+    device.caches.fetch_add(1, std::memory_order_relaxed);
+    device.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+QList<DeviceScanStats> DeviceScheduler::stats(qint64 elapsedNs) const {
+    QList<DeviceScanStats> result;
+    const double elapsed = elapsedNs / 1e9;
+    for (size_t i = 0; i < m_devices.size(); ++i) {
+        const Device &device = *m_devices[i];
+        const quint64 dirs = device.dirs.load();
+        const quint64 skipped = device.skippedMounts.load();
+        if (static_cast<int>(i) != m_rootDevice && dirs == 0 && device.caches.load() == 0 && skipped == 0) continue;
+
+        DeviceScanStats stats;
+        stats.mountPoint = device.mountPoint;
+        stats.fsType = device.fsType;
+        stats.kind = kindName(device.kind);
+        stats.concurrency = device.limit;
+        stats.peakConcurrency = device.peakActive.load();
+        stats.dirs = dirs;
+        stats.caches = device.caches.load();
+        stats.bytes = device.bytes.load();
+        stats.skippedMounts = skipped;
+        stats.busySeconds = device.busyNs.load() / 1e9;
+        stats.dirsPerSecond = elapsed > 0 ? dirs / elapsed : 0.0;
+        result.append(stats);
+    }
+    return result;
+}
+
+QString DeviceScheduler::kindName(Kind kind) {
+    switch (kind) {
+    case Kind::Solid: return QStringLiteral("ssd");
+    case Kind::Rotational: return QStringLiteral("hdd");
+    case Kind::Network: return QStringLiteral("network");
+    case Kind::Pseudo: return QStringLiteral("pseudo");
+    case Kind::Unknown: return QStringLiteral("unknown");
+    }
+    return QString();
+}
@@ -0,0 +1,92 @@
+#ifndef DEVICESCHEDULER_H
+#define DEVICESCHEDULER_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "ScanTypes.h"
+
+/*
+ * Mount-aware bookkeeping for one scan.
+ *
+ * load() snapshots the mount table once (/proc/self/mountinfo on Linux,
+ * QStorageInfo elsewhere) and groups mounts by the device behind them, so bind
+ * mounts and subvolumes of one disk share a device. The table is read-only while
+ * workers run: a directory is a device boundary exactly when its path is one of
+ * the recorded mount points, which costs a hash lookup and no syscall.
+ *
+ * Every device gets its own concurrency limit, picked by kind unless overridden:
+ * SSDs and unknown devices may use every worker, spinning disks and network mounts
+ * two, so a slow device ends up with few workers while the others keep going.
+ * Pseudo filesystems (proc, sysfs, cgroup, ...) are never entered.
+ */
+class DeviceScheduler {
+public:
+    enum class Kind { Solid, Rotational, Network, Pseudo, Unknown };
+    static constexpr int NoDevice = -1;
+
+    struct Mount {
+        QString id;          // "major:minor" on Linux, the volume's device name elsewhere
+        QString mountPoint;
+        QString fsType;
+    };
+    // In mount order: a later entry is mounted over an earlier one at the same point
+    static QList<Mount> mountTable();
+
+    DeviceScheduler();
+
+    // perDeviceLimit 0 = by kind; oneFileSystem stops at every mount of another device
+    void load(const QString &rootPath, int workers, int perDeviceLimit, bool oneFileSystem);
+    // A single device of unknown kind and no mounts, for a FileSystem that is not the local disk
+    void loadSingle(const QString &rootPath, int workers, int perDeviceLimit);
+
+    int rootDevice() const { return m_rootDevice; }
+    bool hasMounts() const { return !m_mountPoints.isEmpty(); }
+
+    // Device the job for `path` belongs to, given its parent's; NoDevice when it must not be entered
+    int deviceFor(const QString &path, int parentDevice) const;
+    // Same for a directory below the root that was not reached by walking down to it
+    int deviceForPath(const QString &rootPath, const QString &path) const;
+
+    bool tryAcquire(int device);
+    void release(int device);
+    int deviceCount() const { return static_cast<int>(m_devices.size()); }
+
+    void recordDirectory(int device, qint64 busyNs);
+    void recordCache(int device, quint64 bytes);
+
+    QList<DeviceScanStats> stats(qint64 elapsedNs) const;
+
+    static QString kindName(Kind kind);
+
+private:
+    struct Device {
+        QString id;          // "major:minor" or the volume's device name
+        QString mountPoint;  // shortest mount point of this device seen below or above the root
+        QString fsType;
+        Kind kind = Kind::Unknown;
+        int limit = 1;
+
+        std::atomic<int> active{0};
+        std::atomic<int> peakActive{0};
+        std::atomic<quint64> dirs{0};
+        std::atomic<quint64> caches{0};
+        std::atomic<quint64> bytes{0};
+        std::atomic<quint64> busyNs{0};
+        mutable std::atomic<quint64> skippedMounts{0}; // counted by the const lookups
+    };
+
+    std::vector<std::unique_ptr<Device>> m_devices;
+    QHash<QString, int> m_mountPoints; // mount point below the root -> device
+    int m_rootDevice;
+    bool m_oneFileSystem;
+
+    int addDevice(const QString &id, const QString &mountPoint, const QString &fsType, int workers, int perDeviceLimit);
+    static Kind classify(const QString &id, const QString &fsType);
+};
+
+#endif // DEVICESCHEDULER_H
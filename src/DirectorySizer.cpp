@@ -0,0 +1,902 @@
+#include "DirectorySizer.h"
+#include "InodeSet.h"
+#include "IoThrottle.h"
+#include "IoUring.h"
+#include "ScanMetrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#endif
+
+namespace {
+
+qint64 secondsOf(const QDateTime &time) {
+    return time.isValid() ? time.toSecsSinceEpoch() : 0;
+}
+
+// Subdirectories by mtime only, see EntryTimes
+void addEntryTimes(DirectorySizer::EntryTimes &times, const QFileInfo &info) {
+    if (info.isDir() && !info.isSymLink()) {
+        times.addDirectory(secondsOf(info.lastModified()));
+    } else {
+        times.addFile(secondsOf(info.lastModified()), secondsOf(info.lastRead()));
+    }
+}
+
+}
+
+DirectorySizer::DirectorySizer(Backend backend, const std::atomic<bool> *stopFlag)
+    : m_backend(resolve(backend)), m_stopFlag(stopFlag) {
+}
+
+bool DirectorySizer::isNativeAvailable() {
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DirectorySizer::isIoUringAvailable() {
+#if defined(Q_OS_LINUX) && defined(STATX_SIZE)
+    return IoUring::isAvailable();
+#else
+    return false;
+#endif
+}
+
+DirectorySizer::Backend DirectorySizer::resolve(Backend requested) {
+    if (requested == Backend::IoUring && !isIoUringAvailable()) requested = Backend::Native;
+    if (requested == Backend::Native && !isNativeAvailable()) return Backend::QtIterator;
+    if (requested != Backend::Auto) return requested;
+
+    const QByteArray forced = qgetenv("DFCACHE_SIZE_BACKEND").toLower();
+    if (forced == "qt") return Backend::QtIterator;
+    if (forced == "uring") return resolve(Backend::IoUring);
+    return isNativeAvailable() ? Backend::Native : Backend::QtIterator;
+}
+
+const char *DirectorySizer::backendName(Backend backend) {
+    switch (backend) {
+    case Backend::Auto: return "auto";
+    case Backend::QtIterator: return "qt";
+    case Backend::Native: return "native";
+    case Backend::IoUring: return "uring";
+    }
+    return "auto";
+}
+
+quint64 DirectorySizer::calculate(const QString &path) const {
+    m_times = EntryTimes();
+    if (m_fs) {
+        addRootTimes(path);
+        return calculateWith(path);
+    }
+#ifdef Q_OS_LINUX
+    if (nativeWalks(path)) {
+        quint64 size = 0;
+#ifdef STATX_SIZE
+        if (m_backend == Backend::IoUring && calculateUring(path, size)) return size;
+#endif
+        if (calculateNative(path, size)) return size;
+        // Native walk could not complete (e.g. out of file descriptors), redo it portably
+    }
+#endif
+    return calculateQt(path);
+}
+
+DirectorySizer::Usage DirectorySizer::measure(const QString &path) const {
+    Usage usage;
+    m_times = EntryTimes();
+#ifdef Q_OS_LINUX
+    if (!m_fs && nativeWalks(path) && measureNative(path, usage)) return usage;
+#endif
+    if (m_fs) {
+        addRootTimes(path);
+        usage.apparentBytes = calculateWith(path);
+    } else {
+        usage.apparentBytes = calculateQt(path);
+    }
+    usage.allocatedBytes = usage.apparentBytes;
+    usage.reclaimableBytes = usage.apparentBytes;
+    return usage;
+}
+
+std::shared_ptr<SizeTree> DirectorySizer::buildTree(const QString &path) const {
+    auto tree = std::make_shared<SizeTree>(path);
+    m_times = EntryTimes();
+    if (m_fs) {
+        addRootTimes(path);
+        treeWith(path, *tree, tree->root());
+        tree->setComplete(!stopRequested());
+        return tree;
+    }
+#ifdef Q_OS_LINUX
+    if (nativeWalks(path)) {
+        if (buildTreeNative(path, *tree)) {
+            tree->setComplete(!stopRequested());
+            return tree;
+        }
+        tree = std::make_shared<SizeTree>(path);
+    }
+#endif
+    m_times.addDirectory(secondsOf(QFileInfo(path).lastModified()));
+    treeQt(path, *tree, tree->root());
+    tree->setComplete(!stopRequested());
+    return tree;
+}
+
+quint64 DirectorySizer::calculateQt(const QString &path) const {
+    m_times.addDirectory(secondsOf(QFileInfo(path).lastModified()));
+    if ((m_rules && !m_rules->isEmpty()) || IoThrottle::shared().isEnabled()) return calculateQtPerDirectory(path);
+
+    quint64 size = 0;
+    quint64 entries = 0;
+    quint64 dirs = 1;
+    QDirIterator it(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (stopRequested()) break;
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        size += info.size();
+        addEntryTimes(m_times, info);
+        ++entries;
+        if (info.isDir()) ++dirs;
+    }
+
+    // Each entry costs one stat behind QFileInfo
+    ScanMetrics::add(ScanMetrics::DirsOpened, dirs);
+    ScanMetrics::add(ScanMetrics::EntriesRead, entries);
+    ScanMetrics::add(ScanMetrics::StatCalls, entries);
+    return size;
+}
+
+// One QDir listing per directory, so excluded subdirectories are never entered and
+// a throttled walk is paced between directories
+quint64 DirectorySizer::calculateQtPerDirectory(const QString &path) const {
+    IoThrottle::pace(m_stopFlag);
+    const QFileInfoList entries = QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot
+                                                           | QDir::Hidden | QDir::System);
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+    ScanMetrics::add(ScanMetrics::EntriesRead, entries.size());
+    ScanMetrics::add(ScanMetrics::StatCalls, entries.size());
+
+    quint64 size = 0;
+    for (const QFileInfo &info : entries) {
+        if (stopRequested()) break;
+        if (info.isDir() && !info.isSymLink()) {
+            if (pruned(info.filePath())) continue;
+            addEntryTimes(m_times, info);
+            size += info.size() + calculateQtPerDirectory(info.filePath());
+        } else {
+            size += info.size();
+            addEntryTimes(m_times, info);
+        }
+    }
+    return size;
+}
+
+// Depth-first like calculateQt, one QDir listing per directory so totals can be rolled up
+void DirectorySizer::treeQt(const QString &path, SizeTree &tree, quint32 dir) const {
+    IoThrottle::pace(m_stopFlag);
+    const QFileInfoList entries = QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot
+                                                           | QDir::Hidden | QDir::System);
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+    ScanMetrics::add(ScanMetrics::EntriesRead, entries.size());
+    ScanMetrics::add(ScanMetrics::StatCalls, entries.size());
+
+    for (const QFileInfo &info : entries) {
+        if (stopRequested()) return;
+        const QByteArray name = QFile::encodeName(info.fileName());
+        if (info.isDir() && !info.isSymLink()) {
+            if (pruned(info.filePath())) continue;
+            addEntryTimes(m_times, info);
+            const quint32 child = tree.addNode(dir, name.constData(), name.size(), info.size(), SizeTree::Directory);
+            treeQt(info.filePath(), tree, child);
+            tree.addToSubtree(dir, tree.node(child).sizeBytes, tree.node(child).items);
+        } else {
+            addEntryTimes(m_times, info);
+            tree.addNode(dir, name.constData(), name.size(), info.size(), 0);
+            tree.addToSubtree(dir, info.size(), 1);
+        }
+    }
+}
+
+void DirectorySizer::addRootTimes(const QString &path) const {
+    FileSystem::Entry root;
+    ScanMetrics::add(ScanMetrics::StatCalls);
+    if (m_fs->stat(path, root) == FileSystem::Error::None) m_times.addDirectory(root.modified);
+}
+
+// Entries come with their stat, like a QFileInfo listing
+bool DirectorySizer::listWith(const QString &path, QList<FileSystem::Entry> &entries) const {
+    const FileSystem::Error error = m_fs->list(path, entries);
+    if (error != FileSystem::Error::None) {
+        FileSystem::recordError(error);
+        return false;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+    ScanMetrics::add(ScanMetrics::EntriesRead, entries.size());
+    ScanMetrics::add(ScanMetrics::StatCalls, entries.size());
+    return true;
+}
+
+// Same walk as calculateQtPerDirectory, through m_fs
+quint64 DirectorySizer::calculateWith(const QString &path) const {
+    IoThrottle::pace(m_stopFlag);
+    QList<FileSystem::Entry> entries;
+    if (!listWith(path, entries)) return 0;
+
+    quint64 size = 0;
+    for (const FileSystem::Entry &entry : std::as_const(entries)) {
+        if (stopRequested()) break;
+        if (entry.type == FileSystem::Type::Directory) {
+            const QString childPath = ScanIndex::joinPath(path, entry.name);
+            if (pruned(childPath)) continue;
+            m_times.addDirectory(entry.modified);
+            size += entry.size + calculateWith(childPath);
+        } else {
+            m_times.addFile(entry.modified, entry.accessed);
+            size += entry.size;
+        }
+    }
+    return size;
+}
+
+void DirectorySizer::treeWith(const QString &path, SizeTree &tree, quint32 dir) const {
+    IoThrottle::pace(m_stopFlag);
+    QList<FileSystem::Entry> entries;
+    if (!listWith(path, entries)) return;
+
+    for (const FileSystem::Entry &entry : std::as_const(entries)) {
+        if (stopRequested()) return;
+        const QByteArray name = QFile::encodeName(entry.name);
+        if (entry.type == FileSystem::Type::Directory) {
+            const QString childPath = ScanIndex::joinPath(path, entry.name);
+            if (pruned(childPath)) continue;
+            m_times.addDirectory(entry.modified);
+            const quint32 child = tree.addNode(dir, name.constData(), name.size(), entry.size, SizeTree::Directory);
+            treeWith(childPath, tree, child);
+            tree.addToSubtree(dir, tree.node(child).sizeBytes, tree.node(child).items);
+        } else {
+            m_times.addFile(entry.modified, entry.accessed);
+            tree.addNode(dir, name.constData(), name.size(), entry.size, 0);
+            tree.addToSubtree(dir, entry.size, 1);
+        }
+    }
+}
+
+#ifdef Q_OS_LINUX
+
+namespace {
+
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+constexpr size_t kDentsBufferSize = 64 * 1024;
+constexpr int kOpenDirFlags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+std::atomic<bool> g_statxUnsupported{false};
+
+inline bool isDotOrDotDot(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+struct EntryStat {
+    quint64 size = 0;
+    quint64 allocated = 0; // st_blocks * 512
+    quint64 device = 0;
+    quint64 inode = 0;
+    quint64 links = 1;
+    mode_t mode = 0;
+    qint64 modified = 0;   // seconds since the epoch
+    qint64 accessed = 0;
+};
+
+// Size, type and identity of an entry relative to its parent directory fd, without following symlinks.
+// The extra statx fields come with the same call; filesystems that cannot provide them cheaply
+// leave them out of stx_mask and we treat the file as unlinked.
+bool statEntry(int dirFd, const char *name, EntryStat &entry) {
+#ifdef STATX_SIZE
+    if (!g_statxUnsupported.load(std::memory_order_relaxed)) {
+        struct statx stx;
+        if (statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC,
+                  STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_NLINK | STATX_INO | STATX_MTIME | STATX_ATIME,
+                  &stx) == 0) {
+            entry.size = stx.stx_size;
+            entry.mode = stx.stx_mode;
+            entry.allocated = (stx.stx_mask & STATX_BLOCKS) ? stx.stx_blocks * 512 : stx.stx_size;
+            entry.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+            entry.inode = stx.stx_ino;
+            entry.links = (stx.stx_mask & STATX_NLINK) && (stx.stx_mask & STATX_INO) ? stx.stx_nlink : 1;
+            entry.modified = (stx.stx_mask & STATX_MTIME) ? stx.stx_mtime.tv_sec : 0;
+            entry.accessed = (stx.stx_mask & STATX_ATIME) ? stx.stx_atime.tv_sec : 0;
+            return true;
+        }
+        if (errno != ENOSYS) return false;
+        g_statxUnsupported = true;
+    }
+#endif
+    struct stat st;
+    if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return false;
+    entry.size = static_cast<quint64>(st.st_size);
+    entry.mode = st.st_mode;
+    entry.allocated = static_cast<quint64>(st.st_blocks) * 512;
+    entry.device = st.st_dev;
+    entry.inode = st.st_ino;
+    entry.links = st.st_nlink;
+    entry.modified = st.st_mtim.tv_sec;
+    entry.accessed = st.st_atim.tv_sec;
+    return true;
+}
+
+} // namespace
+
+struct DirectorySizer::NativeWalkState {
+    std::vector<char> buffer = std::vector<char>(kDentsBufferSize);
+    bool failed = false;
+    dev_t rootDevice = 0; // only set with one-filesystem
+    const PruneRules *rules = nullptr; // only set when it has name rules
+    DirectorySizer::EntryTimes times;
+
+    // ASCII names, nearly all of them, are widened on the stack; only the others are decoded
+    bool prunedName(const char *name) const {
+        if (!rules) return false;
+        char16_t wide[256];
+        qsizetype length = 0;
+        for (; name[length] != '\0'; ++length) {
+            const auto c = static_cast<unsigned char>(name[length]);
+            if (c >= 0x80 || length == qsizetype(std::size(wide))) {
+                return rules->checkName(QFile::decodeName(name)) != PruneRules::NoRule;
+            }
+            wide[length] = c;
+        }
+        return rules->checkName(QStringView(wide, length)) != PruneRules::NoRule;
+    }
+
+    // Allocated-size accounting, only when measuring
+    InodeSet *inodes = nullptr;
+    quint64 allocatedBytes = 0;
+    quint64 unlinkedBytes = 0; // allocated bytes of files with a single link, and of directories
+
+    void account(quint64 allocated, quint64 device, quint64 inode, quint64 links) {
+        if (links <= 1) {
+            allocatedBytes += allocated;
+            unlinkedBytes += allocated;
+        } else if (inodes->visit(device, inode, links, allocated)) {
+            allocatedBytes += allocated;
+        }
+    }
+};
+
+// The root's device for one-filesystem and its own mtime, and the name rules
+void DirectorySizer::startWalk(int rootFd, NativeWalkState &state) const {
+    struct stat st;
+    ScanMetrics::add(ScanMetrics::StatCalls);
+    if (fstat(rootFd, &st) == 0) {
+        if (m_oneFileSystem) state.rootDevice = st.st_dev;
+        state.times.addDirectory(st.st_mtim.tv_sec);
+    }
+    if (m_rules && m_rules->hasNameRules()) state.rules = m_rules;
+}
+
+bool DirectorySizer::calculateNative(const QString &path, quint64 &size) const {
+    int rootFd = ::open(QFile::encodeName(path).constData(), kOpenDirFlags);
+    if (rootFd < 0) {
+        ScanMetrics::addError(errno);
+        // Unreadable root: same result as the Qt walk, which simply yields nothing
+        size = 0;
+        return errno != EMFILE && errno != ENFILE;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+
+    NativeWalkState state;
+    startWalk(rootFd, state);
+    size = walkFd(rootFd, state);
+    ::close(rootFd);
+    m_times.merge(state.times);
+    return !state.failed;
+}
+
+bool DirectorySizer::measureNative(const QString &path, Usage &usage) const {
+    int rootFd = ::open(QFile::encodeName(path).constData(), kOpenDirFlags);
+    if (rootFd < 0) {
+        ScanMetrics::addError(errno);
+        usage = Usage();
+        return errno != EMFILE && errno != ENFILE;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+
+    InodeSet inodes;
+    NativeWalkState state;
+    state.inodes = &inodes;
+    startWalk(rootFd, state);
+    usage.apparentBytes = walkFd(rootFd, state);
+    ::close(rootFd);
+    m_times.merge(state.times);
+
+    usage.allocatedBytes = state.allocatedBytes;
+    usage.reclaimableBytes = state.unlinkedBytes + inodes.fullyLinkedBytes();
+    return !state.failed;
+}
+
+/*
+ * Lists one directory by fd. Regular entries are sized on the spot; subdirectory
+ * names are collected and only opened once the listing is done, so at most one
+ * fd per tree level is held open and the getdents buffer can be shared.
+ * Symlinks are sized as links (like du), never followed.
+ */
+quint64 DirectorySizer::walkFd(int dirFd, NativeWalkState &state) const {
+    quint64 total = 0;
+    std::string subdirs; // NUL-separated names
+    listFd(dirFd, state, total, subdirs);
+
+    for (size_t pos = 0; pos < subdirs.size(); pos += std::strlen(subdirs.c_str() + pos) + 1) {
+        if (stopRequested() || state.failed) return total;
+        if (state.prunedName(subdirs.c_str() + pos)) continue;
+        IoThrottle::pace(m_stopFlag);
+
+        int childFd = ::openat(dirFd, subdirs.c_str() + pos, kOpenDirFlags);
+        if (childFd < 0) {
+            ScanMetrics::addError(errno);
+            if (errno == EMFILE || errno == ENFILE) state.failed = true;
+            continue;
+        }
+        ScanMetrics::add(ScanMetrics::DirsOpened);
+
+        struct stat st;
+        ScanMetrics::add(ScanMetrics::StatCalls);
+        const bool statted = fstat(childFd, &st) == 0;
+        // A mount point: with one-filesystem neither it nor anything below it counts
+        if (statted && m_oneFileSystem && st.st_dev != state.rootDevice) {
+            ::close(childFd);
+            continue;
+        }
+        if (statted) {
+            total += static_cast<quint64>(st.st_size);
+            state.times.addDirectory(st.st_mtim.tv_sec);
+            if (state.inodes) state.account(static_cast<quint64>(st.st_blocks) * 512, st.st_dev, st.st_ino, 1);
+        }
+        total += walkFd(childFd, state);
+        ::close(childFd);
+    }
+
+    return total;
+}
+
+void DirectorySizer::listFd(int dirFd, NativeWalkState &state, quint64 &total, std::string &subdirs) const {
+    // Counted locally and published once per directory to keep the entry loop tight
+    quint64 entries = 0;
+    quint64 stats = 0;
+    for (;;) {
+        if (stopRequested()) break;
+
+        long bytes = syscall(SYS_getdents64, dirFd, state.buffer.data(), state.buffer.size());
+        if (bytes < 0) ScanMetrics::addError(errno);
+        if (bytes <= 0) break;
+
+        for (long offset = 0; offset < bytes;) {
+            auto *entry = reinterpret_cast<LinuxDirent64 *>(state.buffer.data() + offset);
+            offset += entry->d_reclen;
+
+            const char *name = entry->d_name;
+            if (isDotOrDotDot(name)) continue;
+            ++entries;
+
+            if (entry->d_type == DT_DIR) {
+                subdirs.append(name, std::strlen(name) + 1);
+                continue;
+            }
+
+            EntryStat st;
+            ++stats;
+            if (!statEntry(dirFd, name, st)) {
+                if (errno != ENOENT) ScanMetrics::addError(errno);
+                continue;
+            }
+
+            if (entry->d_type == DT_UNKNOWN && S_ISDIR(st.mode)) {
+                subdirs.append(name, std::strlen(name) + 1);
+            } else {
+                total += st.size;
+                state.times.addFile(st.modified, st.accessed);
+                if (state.inodes) state.account(st.allocated, st.device, st.inode, st.links);
+            }
+        }
+    }
+
+    ScanMetrics::add(ScanMetrics::EntriesRead, entries);
+    ScanMetrics::add(ScanMetrics::StatCalls, stats);
+}
+
+bool DirectorySizer::buildTreeNative(const QString &path, SizeTree &tree) const {
+    int rootFd = ::open(QFile::encodeName(path).constData(), kOpenDirFlags);
+    if (rootFd < 0) {
+        ScanMetrics::addError(errno);
+        return errno != EMFILE && errno != ENFILE;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+
+    NativeWalkState state;
+    startWalk(rootFd, state);
+    treeFd(rootFd, state, tree, tree.root());
+    ::close(rootFd);
+    m_times.merge(state.times);
+    return !state.failed;
+}
+
+/*
+ * walkFd() that keeps every entry: files become leaves while the directory is listed,
+ * subdirectories are opened afterwards and their totals added once they are done.
+ * Directories that cannot be opened stay in the tree as empty, unreadable nodes.
+ */
+void DirectorySizer::treeFd(int dirFd, NativeWalkState &state, SizeTree &tree, quint32 dir) const {
+    std::string subdirs; // NUL-separated names
+    quint64 ownBytes = 0;
+    quint32 files = 0;
+    quint64 entries = 0;
+    quint64 stats = 0;
+    for (;;) {
+        if (stopRequested()) break;
+
+        long bytes = syscall(SYS_getdents64, dirFd, state.buffer.data(), state.buffer.size());
+        if (bytes < 0) ScanMetrics::addError(errno);
+        if (bytes <= 0) break;
+
+        for (long offset = 0; offset < bytes;) {
+            auto *entry = reinterpret_cast<LinuxDirent64 *>(state.buffer.data() + offset);
+            offset += entry->d_reclen;
+
+            const char *name = entry->d_name;
+            if (isDotOrDotDot(name)) continue;
+            ++entries;
+
+            if (entry->d_type == DT_DIR) {
+                subdirs.append(name, std::strlen(name) + 1);
+                continue;
+            }
+
+            EntryStat st;
+            ++stats;
+            if (!statEntry(dirFd, name, st)) {
+                if (errno != ENOENT) ScanMetrics::addError(errno);
+                continue;
+            }
+
+            if (entry->d_type == DT_UNKNOWN && S_ISDIR(st.mode)) {
+                subdirs.append(name, std::strlen(name) + 1);
+            } else {
+                tree.addNode(dir, name, std::strlen(name), st.size, 0);
+                state.times.addFile(st.modified, st.accessed);
+                ownBytes += st.size;
+                ++files;
+            }
+        }
+    }
+    ScanMetrics::add(ScanMetrics::EntriesRead, entries);
+    ScanMetrics::add(ScanMetrics::StatCalls, stats);
+    tree.addToSubtree(dir, ownBytes, files);
+
+    for (size_t pos = 0; pos < subdirs.size(); pos += std::strlen(subdirs.c_str() + pos) + 1) {
+        if (stopRequested() || state.failed) return;
+
+        const char *name = subdirs.c_str() + pos;
+        if (state.prunedName(name)) continue;
+        IoThrottle::pace(m_stopFlag);
+        const size_t length = std::strlen(name);
+        int childFd = ::openat(dirFd, name, kOpenDirFlags);
+        if (childFd < 0) {
+            ScanMetrics::addError(errno);
+            if (errno == EMFILE || errno == ENFILE) state.failed = true;
+            tree.addNode(dir, name, length, 0, SizeTree::Directory | SizeTree::Unreadable);
+            tree.addToSubtree(dir, 0, 1);
+            continue;
+        }
+        ScanMetrics::add(ScanMetrics::DirsOpened);
+
+        struct stat st;
+        ScanMetrics::add(ScanMetrics::StatCalls);
+        const bool statted = fstat(childFd, &st) == 0;
+        if (statted && m_oneFileSystem && st.st_dev != state.rootDevice) {
+            ::close(childFd);
+            continue;
+        }
+        if (statted) state.times.addDirectory(st.st_mtim.tv_sec);
+
+        const quint32 child = tree.addNode(dir, name, length, statted ? static_cast<quint64>(st.st_size) : 0,
+                                           SizeTree::Directory);
+        treeFd(childFd, state, tree, child);
+        ::close(childFd);
+        tree.addToSubtree(dir, tree.node(child).sizeBytes, tree.node(child).items);
+    }
+}
+
+#ifdef STATX_SIZE
+
+namespace {
+
+constexpr unsigned kUringStatxMask = STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_ATIME;
+// Subdirectories opened per batch; each level of the walk can hold this many fds
+constexpr size_t kUringOpenWindow = 8;
+
+}
+
+struct DirectorySizer::UringWalkState : NativeWalkState {
+    IoUring *ring = nullptr;
+    std::vector<struct statx> stats; // one per queue slot, reused by every batch
+    std::vector<IoUring::Completion> completions;
+};
+
+bool DirectorySizer::calculateUring(const QString &path, quint64 &size) const {
+    // One ring per thread: a batch is always complete before the walk moves on, so nested
+    // directories share it
+    thread_local std::unique_ptr<IoUring> ring;
+    thread_local unsigned ringDepth = 0;
+    if (!ring || ringDepth != m_queueDepth) {
+        ring = IoUring::create(m_queueDepth);
+        ringDepth = m_queueDepth;
+    }
+    if (!ring) return false;
+
+    int rootFd = ::open(QFile::encodeName(path).constData(), kOpenDirFlags);
+    if (rootFd < 0) {
+        ScanMetrics::addError(errno);
+        size = 0;
+        return errno != EMFILE && errno != ENFILE;
+    }
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+
+    UringWalkState state;
+    state.ring = ring.get();
+    state.stats.resize(ring->queueDepth());
+    startWalk(rootFd, state);
+    size = walkUring(rootFd, state);
+    ::close(rootFd);
+    m_times.merge(state.times);
+    // A ring the kernel refused may be broken for good; the next walk gets a fresh one
+    if (state.failed) ring.reset();
+    return !state.failed;
+}
+
+/*
+ * walkFd() with the per-entry syscalls batched. The listing is read in full first,
+ * then every entry, subdirectories included, is statx'ed in batches of queueDepth.
+ * Subdirectories are opened a window at a time and walked in order. Any failure of
+ * the ring itself fails the walk, and calculate() starts over with the Native walk.
+ */
+quint64 DirectorySizer::walkUring(int dirFd, UringWalkState &state) const {
+    std::string names; // NUL-separated, all entries
+    std::vector<quint32> offsets;
+    for (;;) {
+        if (stopRequested()) return 0;
+
+        long bytes = syscall(SYS_getdents64, dirFd, state.buffer.data(), state.buffer.size());
+        if (bytes < 0) ScanMetrics::addError(errno);
+        if (bytes <= 0) break;
+
+        for (long offset = 0; offset < bytes;) {
+            auto *entry = reinterpret_cast<LinuxDirent64 *>(state.buffer.data() + offset);
+            offset += entry->d_reclen;
+            if (isDotOrDotDot(entry->d_name)) continue;
+            offsets.push_back(static_cast<quint32>(names.size()));
+            names.append(entry->d_name, std::strlen(entry->d_name) + 1);
+        }
+    }
+    ScanMetrics::add(ScanMetrics::EntriesRead, offsets.size());
+    ScanMetrics::add(ScanMetrics::StatCalls, offsets.size());
+
+    quint64 total = 0;
+    std::vector<quint32> subdirs;      // offsets into names
+    std::vector<quint64> subdirSizes;  // only counted once the directory opens, like walkFd()
+    for (size_t first = 0; first < offsets.size();) {
+        IoThrottle::pace(m_stopFlag);
+        if (stopRequested()) return total;
+
+        size_t next = first;
+        while (next < offsets.size()
+               && state.ring->queueStatx(dirFd, names.data() + offsets[next], kUringStatxMask,
+                                         &state.stats[next - first], next)) {
+            ++next;
+        }
+        state.completions.clear();
+        if (!state.ring->submitAndWait(state.completions)) {
+            state.failed = true;
+            return total;
+        }
+
+        for (const IoUring::Completion &completion : state.completions) {
+            if (completion.result < 0) {
+                if (completion.result != -ENOENT) ScanMetrics::addError(-completion.result);
+                continue;
+            }
+            const struct statx &stx = state.stats[completion.tag - first];
+            const qint64 mtime = (stx.stx_mask & STATX_MTIME) ? stx.stx_mtime.tv_sec : 0;
+            if (!S_ISDIR(stx.stx_mode)) {
+                total += stx.stx_size;
+                state.times.addFile(mtime, (stx.stx_mask & STATX_ATIME) ? stx.stx_atime.tv_sec : 0);
+            } else if ((!m_oneFileSystem || makedev(stx.stx_dev_major, stx.stx_dev_minor) == state.rootDevice)
+                       && !state.prunedName(names.data() + offsets[completion.tag])) {
+                subdirs.push_back(offsets[completion.tag]);
+                subdirSizes.push_back(stx.stx_size);
+                state.times.addDirectory(mtime);
+            }
+        }
+        first = next;
+    }
+
+    const size_t window = qMin<size_t>(kUringOpenWindow, state.ring->queueDepth());
+    int fds[kUringOpenWindow];
+    for (size_t first = 0; first < subdirs.size(); first += window) {
+        IoThrottle::pace(m_stopFlag);
+        if (stopRequested() || state.failed) return total;
+
+        const size_t count = qMin(window, subdirs.size() - first);
+        if (state.ring->canOpen() && count > 1) {
+            std::fill(fds, fds + count, -ECANCELED);
+            for (size_t i = 0; i < count; ++i) {
+                state.ring->queueOpenat(dirFd, names.data() + subdirs[first + i], kOpenDirFlags, i);
+            }
+            state.completions.clear();
+            // On failure whatever did open is still closed below
+            if (!state.ring->submitAndWait(state.completions)) state.failed = true;
+            for (const IoUring::Completion &completion : state.completions) fds[completion.tag] = completion.result;
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                fds[i] = ::openat(dirFd, names.data() + subdirs[first + i], kOpenDirFlags);
+                if (fds[i] < 0) fds[i] = -errno;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            if (fds[i] < 0) {
+                if (fds[i] == -ECANCELED) continue;
+                ScanMetrics::addError(-fds[i]);
+                if (fds[i] == -EMFILE || fds[i] == -ENFILE) state.failed = true;
+                continue;
+            }
+            ScanMetrics::add(ScanMetrics::DirsOpened);
+            if (!stopRequested() && !state.failed) total += subdirSizes[first + i] + walkUring(fds[i], state);
+            ::close(fds[i]);
+        }
+    }
+    return total;
+}
+
+#endif // STATX_SIZE
+
+#endif // Q_OS_LINUX
+
+/*
+ * Sizes one directory against the previous index and records it into the builder.
+ * The caller has already created `node` from the directory's current DirStat.
+ */
+quint64 DirectorySizer::calculateIncremental(const QString &path, ScanIndexBuilder::Node *node,
+                                             const ScanIndex *previous, qint32 previousRecord,
+                                             ScanIndexBuilder *builder) const {
+    const bool reuse = previous && previous->matches(previousRecord, node->inode, node->mtimeNs)
+        && (previous->record(previousRecord).flags & ScanIndex::SizedFlag);
+
+    quint64 ownBytes = 0;
+    EntryTimes ownTimes;
+    QStringList subdirs;
+    QList<qint32> subdirRecords;
+
+    if (reuse) {
+        const ScanIndex::Record &rec = previous->record(previousRecord);
+        ownBytes = rec.ownBytes;
+        // As of the scan that listed it: rewriting or reading a file leaves the directory's mtime alone
+        ownTimes.addFile(rec.ownModified, rec.ownAccessed);
+        for (quint32 i = 0; i < rec.childCount; ++i) {
+            subdirs.append(previous->name(static_cast<qint32>(rec.firstChild + i)));
+            subdirRecords.append(static_cast<qint32>(rec.firstChild + i));
+        }
+    } else {
+        if (!listDirectory(path, ownBytes, subdirs, &ownTimes)) return 0;
+        for (const QString &name : subdirs) {
+            subdirRecords.append(previous ? previous->findChild(previousRecord, name) : ScanIndex::NoRecord);
+        }
+    }
+
+    node->ownModified = ownTimes.modified;
+    node->ownAccessed = ownTimes.accessed;
+    m_times.merge(ownTimes);
+    m_times.addDirectory(node->mtimeNs / 1000000000);
+
+    const quint64 ownDevice = m_oneFileSystem ? ScanIndex::statDirectory(path).device : 0;
+    quint64 total = ownBytes;
+    for (qsizetype i = 0; i < subdirs.size(); ++i) {
+        IoThrottle::pace(m_stopFlag);
+        if (stopRequested()) return total;
+
+        const QString childPath = ScanIndex::joinPath(path, subdirs[i]);
+        ScanMetrics::add(ScanMetrics::StatCalls);
+        DirStat childStat = ScanIndex::statDirectory(childPath);
+        if (!childStat.valid) continue; // vanished or replaced by a non-directory
+        if (m_oneFileSystem && childStat.device != ownDevice) continue;
+
+        ScanIndexBuilder::Node *child = builder->addChild(node, subdirs[i], childStat);
+        // Recorded but left unsized, so a scan without the rule lists it again
+        if (pruned(childPath)) continue;
+        total += childStat.size + calculateIncremental(childPath, child, previous, subdirRecords[i], builder);
+    }
+
+    node->ownBytes = ownBytes;
+    node->totalBytes = total;
+    node->flags |= ScanIndex::ListedFlag | ScanIndex::SizedFlag;
+    return total;
+}
+
+bool DirectorySizer::listDirectory(const QString &path, quint64 &ownBytes, QStringList &subdirs, EntryTimes *times) const {
+    if (m_fs) {
+        QList<FileSystem::Entry> entries;
+        if (!listWith(path, entries)) return false;
+        for (const FileSystem::Entry &entry : std::as_const(entries)) {
+            if (entry.type == FileSystem::Type::Directory) {
+                subdirs.append(entry.name);
+            } else {
+                ownBytes += entry.size;
+                if (times) times->addFile(entry.modified, entry.accessed);
+            }
+        }
+        return true;
+    }
+#ifdef Q_OS_LINUX
+    if (nativeWalks()) {
+        int fd = ::open(QFile::encodeName(path).constData(), kOpenDirFlags);
+        if (fd < 0) {
+            ScanMetrics::addError(errno);
+            return false;
+        }
+        ScanMetrics::add(ScanMetrics::DirsOpened);
+
+        NativeWalkState state;
+        std::string names;
+        listFd(fd, state, ownBytes, names);
+        ::close(fd);
+        if (times) times->merge(state.times);
+
+        for (size_t pos = 0; pos < names.size(); pos += std::strlen(names.c_str() + pos) + 1) {
+            subdirs.append(QFile::decodeName(names.c_str() + pos));
+        }
+        return true;
+    }
+#endif
+    ScanMetrics::add(ScanMetrics::DirsOpened);
+    quint64 entries = 0;
+    QDirIterator it(path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDirIterator::NoIteratorFlags);
+    while (it.hasNext()) {
+        if (stopRequested()) return false;
+        it.next();
+        ++entries;
+        QFileInfo info = it.fileInfo();
+        if (info.isDir() && !info.isSymLink()) {
+            subdirs.append(info.fileName());
+        } else {
+            ownBytes += info.size();
+            if (times) addEntryTimes(*times, info);
+        }
+    }
+    ScanMetrics::add(ScanMetrics::EntriesRead, entries);
+    ScanMetrics::add(ScanMetrics::StatCalls, entries);
+    return true;
+}
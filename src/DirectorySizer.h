@@ -0,0 +1,149 @@
+#ifndef DIRECTORYSIZER_H
+#define DIRECTORYSIZER_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+
+#include "FileSystem.h"
+#include "PruneRules.h"
+#include "ScanIndex.h"
+#include "SizeTree.h"
+
+/*
+ * Computes the total size of a directory tree.
+ * Three backends are available:
+ *  - QtIterator: portable QDirIterator walk (one QFileInfo + path string per entry).
+ *  - Native:     Linux only, walks by directory file descriptor with getdents64 and
+ *                statx/fstatat relative to the parent fd, so no full path is ever built.
+ *  - IoUring:    Native, but calculate() submits each directory's statx calls, and
+ *                its subdirectory opens where the kernel supports that, as io_uring
+ *                batches of up to queueDepth. Resolves to Native when io_uring is not
+ *                usable; everything but calculate() runs the Native code.
+ * Auto picks Native when it is compiled in; DFCACHE_SIZE_BACKEND=qt or =uring overrides it.
+ *
+ * measure() additionally reports allocated and reclaimable bytes (see Usage); it
+ * always walks the whole tree, since hardlinks cannot be deduplicated from per-directory
+ * totals in the index. buildTree() walks it too and keeps every entry (see SizeTree);
+ * its root size equals calculate().
+ *
+ * calculateIncremental() sizes the same tree one directory at a time against the
+ * previous ScanIndex: unchanged directories reuse their recorded file bytes and child
+ * list instead of being listed again, and every directory is recorded into the builder.
+ *
+ * Every walk also notes the newest modification and access time it comes across
+ * (see EntryTimes); calculate(), measure() and buildTree() start that over, while
+ * calculateIncremental() adds to it, reusing the times recorded for unchanged
+ * directories.
+ *
+ * With prune rules set, excluded subdirectories are neither opened nor counted. The
+ * native walks never build paths and match names only; a root that has tail or path
+ * rules at or below it is walked with the Qt backend instead.
+ *
+ * Every walk calls IoThrottle::pace() between directories, which costs nothing
+ * unless a throttle is configured.
+ *
+ * Given a FileSystem other than the local one, every walk but calculateIncremental()
+ * lists through it instead, one directory at a time like the Qt backend, and
+ * reports the apparent size for all three Usage fields.
+ */
+class DirectorySizer {
+public:
+    enum class Backend { Auto, QtIterator, Native, IoUring };
+    // What a scan reports per cache: apparent size only, or also what a delete frees
+    enum class Accounting { Apparent, Allocated };
+
+    // apparentBytes is what calculate() returns. allocatedBytes counts st_blocks, each
+    // hardlinked file once; reclaimableBytes leaves out files that still have links
+    // outside the tree. The Qt backend has no block or link counts and reports the
+    // apparent size for all three.
+    struct Usage {
+        quint64 apparentBytes = 0;
+        quint64 allocatedBytes = 0;
+        quint64 reclaimableBytes = 0;
+    };
+
+    // Newest times among the entries walked, in seconds since the epoch, 0 = none seen.
+    // Directories only count with their mtime: listing one bumps its atime, so every
+    // scan would otherwise find the cache just used.
+    struct EntryTimes {
+        qint64 modified = 0;
+        qint64 accessed = 0;
+
+        void addFile(qint64 mtime, qint64 atime) {
+            modified = qMax(modified, mtime);
+            accessed = qMax(accessed, atime);
+        }
+        void addDirectory(qint64 mtime) { modified = qMax(modified, mtime); }
+        void merge(const EntryTimes &other) { addFile(other.modified, other.accessed); }
+    };
+
+    explicit DirectorySizer(Backend backend = Backend::Auto, const std::atomic<bool> *stopFlag = nullptr);
+
+    quint64 calculate(const QString &path) const;
+    Usage measure(const QString &path) const;
+    // Never null; incomplete when stopped part way
+    std::shared_ptr<SizeTree> buildTree(const QString &path) const;
+    quint64 calculateIncremental(const QString &path, ScanIndexBuilder::Node *node,
+                                 const ScanIndex *previous, qint32 previousRecord,
+                                 ScanIndexBuilder *builder) const;
+    Backend backend() const { return m_backend; }
+    EntryTimes entryTimes() const { return m_times; }
+
+    // Do not descend into directories on another device than the starting one
+    // (native walks and calculateIncremental; the Qt walk ignores it)
+    void setOneFileSystem(bool enabled) { m_oneFileSystem = enabled; }
+    // Operations per io_uring batch (IoUring backend only)
+    void setQueueDepth(unsigned depth) { m_queueDepth = depth; }
+    // Not owned; null or empty rules prune nothing
+    void setPruneRules(const PruneRules *rules) { m_rules = rules; }
+    // Not owned; null or FileSystem::local() walks the disk with the backend
+    void setFileSystem(const FileSystem *fs) { m_fs = FileSystem::virtualOrNull(fs); }
+
+    // One level only: bytes of non-directory entries plus the names of real subdirectories;
+    // `times` gets those of the non-directory entries
+    bool listDirectory(const QString &path, quint64 &ownBytes, QStringList &subdirs, EntryTimes *times = nullptr) const;
+
+    static bool isNativeAvailable();
+    static bool isIoUringAvailable();
+    static Backend resolve(Backend requested);
+    static const char *backendName(Backend backend);
+    static constexpr unsigned kDefaultQueueDepth = 256;
+
+private:
+    Backend m_backend;
+    const std::atomic<bool> *m_stopFlag;
+    bool m_oneFileSystem = false;
+    unsigned m_queueDepth = kDefaultQueueDepth;
+    const PruneRules *m_rules = nullptr;
+    const FileSystem *m_fs = nullptr;
+    mutable EntryTimes m_times;
+
+    bool nativeWalks() const { return m_backend == Backend::Native || m_backend == Backend::IoUring; }
+    bool nativeWalks(const QString &root) const { return nativeWalks() && !(m_rules && m_rules->needsPathsBelow(root)); }
+    bool pruned(const QString &path) const { return m_rules && m_rules->check(path) != PruneRules::NoRule; }
+    bool stopRequested() const { return m_stopFlag && m_stopFlag->load(std::memory_order_relaxed); }
+    quint64 calculateQt(const QString &path) const;
+    quint64 calculateQtPerDirectory(const QString &path) const;
+    void treeQt(const QString &path, SizeTree &tree, quint32 dir) const;
+    bool listWith(const QString &path, QList<FileSystem::Entry> &entries) const;
+    quint64 calculateWith(const QString &path) const;
+    void treeWith(const QString &path, SizeTree &tree, quint32 dir) const;
+    void addRootTimes(const QString &path) const;
+#ifdef Q_OS_LINUX
+    struct NativeWalkState;
+    void startWalk(int rootFd, NativeWalkState &state) const;
+    bool calculateNative(const QString &path, quint64 &size) const;
+    bool measureNative(const QString &path, Usage &usage) const;
+    quint64 walkFd(int dirFd, NativeWalkState &state) const;
+    void listFd(int dirFd, NativeWalkState &state, quint64 &ownBytes, std::string &subdirs) const;
+    bool buildTreeNative(const QString &path, SizeTree &tree) const;
+    void treeFd(int dirFd, NativeWalkState &state, SizeTree &tree, quint32 dir) const;
+    struct UringWalkState;
+    bool calculateUring(const QString &path, quint64 &size) const;
+    quint64 walkUring(int dirFd, UringWalkState &state) const;
+#endif
+};
+
+#endif // DIRECTORYSIZER_H
@@ -1,5 +1,7 @@
 #include "FavoritesManager.h"
 #include <QDebug>
+#include <QFileInfo>
+#include <QSaveFile>
 
 FavoritesManager::FavoritesManager(QObject *parent) : QObject(parent) {
     QString appDataLocation = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -12,18 +14,23 @@ FavoritesManager::FavoritesManager(QObject *parent) : QObject(parent) {
     // We will set OrganizationName in main.cpp.
     
     m_configPath = appDataLocation + "/favorites.json";
+
+    m_writer.setMaxThreadCount(1);
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(500);
+    connect(&m_saveTimer, &QTimer::timeout, this, &FavoritesManager::writeSnapshot);
     load();
 }
 
 FavoritesManager::~FavoritesManager() {
-    save();
+    flush();
 }
 
 void FavoritesManager::addFavorite(const QString &path) {
+    const PathStore::Id id = idFor(path);
     QMutexLocker locker(&m_mutex);
-    QString cleanPath = QDir::toNativeSeparators(path);
-    if (!m_favorites.contains(cleanPath)) {
-        m_favorites.insert(cleanPath);
+    if (!m_favorites.contains(id)) {
+        m_favorites.insert(id, FavoriteInfo());
         locker.unlock();
         save();
         emit favoritesChanged();
@@ -31,10 +38,10 @@ void FavoritesManager::addFavorite(const QString &path) {
 }
 
 void FavoritesManager::removeFavorite(const QString &path) {
+    const PathStore::Id id = PathStore::shared().find(QDir::fromNativeSeparators(path));
     QMutexLocker locker(&m_mutex);
-    QString cleanPath = QDir::toNativeSeparators(path);
-    if (m_favorites.contains(cleanPath)) {
-        m_favorites.remove(cleanPath);
+    if (m_favorites.contains(id)) {
+        m_favorites.remove(id);
         locker.unlock();
         save();
         emit favoritesChanged();
@@ -42,29 +49,79 @@ void FavoritesManager::removeFavorite(const QString &path) {
 }
 
 bool FavoritesManager::isFavorite(const QString &path) const {
+    return isFavorite(PathStore::shared().find(QDir::fromNativeSeparators(path)));
+}
+
+bool FavoritesManager::isFavorite(PathStore::Id path) const {
     QMutexLocker locker(&m_mutex);
-    return m_favorites.contains(QDir::toNativeSeparators(path));
+    return m_favorites.contains(path);
 }
 
 QSet<QString> FavoritesManager::getFavorites() const {
+    QMutexLocker locker(&m_mutex);
+    QSet<QString> paths;
+    for (auto it = m_favorites.constBegin(); it != m_favorites.constEnd(); ++it) {
+        paths.insert(PathStore::shared().path(it.key()));
+    }
+    return paths;
+}
+
+QHash<PathStore::Id, FavoriteInfo> FavoritesManager::getFavoriteInfos() const {
     QMutexLocker locker(&m_mutex);
     return m_favorites;
 }
 
-void FavoritesManager::ensureConfigDirExists() {
-    QFileInfo info(m_configPath);
-    QDir dir = info.absoluteDir();
-    if (!dir.exists()) {
-        dir.mkpath(".");
-    }
+void FavoritesManager::updateSize(const QString &path, quint64 sizeBytes, const QDateTime &measuredAt) {
+    updateSize(PathStore::shared().find(QDir::fromNativeSeparators(path)), sizeBytes, measuredAt);
+}
+
+void FavoritesManager::updateSize(PathStore::Id path, quint64 sizeBytes, const QDateTime &measuredAt) {
+    QMutexLocker locker(&m_mutex);
+    auto it = m_favorites.find(path);
+    if (it == m_favorites.end()) return;
+    it->sizeBytes = sizeBytes;
+    it->measuredAt = measuredAt;
+    locker.unlock();
+    save();
 }
 
 void FavoritesManager::save() {
-    ensureConfigDirExists();
+    // Not restarted by later changes, so a steady stream of them still gets written
+    if (!m_saveTimer.isActive()) m_saveTimer.start();
+}
+
+void FavoritesManager::flush() {
+    if (m_saveTimer.isActive()) {
+        m_saveTimer.stop();
+        writeSnapshot();
+    }
+    m_writer.waitForDone();
+}
+
+void FavoritesManager::writeSnapshot() {
     QMutexLocker locker(&m_mutex);
+    // Implicitly shared: the copy is free until the next change detaches it
+    const QHash<PathStore::Id, FavoriteInfo> favorites = m_favorites;
+    locker.unlock();
+
+    const QString path = m_configPath;
+    m_writer.start([path, favorites]() { writeFile(path, favorites); });
+}
+
+void FavoritesManager::writeFile(const QString &path, const QHash<PathStore::Id, FavoriteInfo> &favorites) {
+    QDir dir = QFileInfo(path).absoluteDir();
+    if (!dir.exists()) {
+        dir.mkpath(".");
+    }
 
     QJsonArray array;
-    for (const auto &fav : m_favorites) {
+    for (auto it = favorites.constBegin(); it != favorites.constEnd(); ++it) {
+        QJsonObject fav;
+        fav["path"] = QDir::toNativeSeparators(PathStore::shared().path(it.key()));
+        if (it->measuredAt.isValid()) {
+            fav["size"] = static_cast<qint64>(it->sizeBytes);
+            fav["measured"] = it->measuredAt.toMSecsSinceEpoch();
+        }
         array.append(fav);
     }
 
@@ -72,10 +129,9 @@ void FavoritesManager::save() {
     root["favorites"] = array;
 
     QJsonDocument doc(root);
-    QFile file(m_configPath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(doc.toJson());
-        file.close();
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(doc.toJson()) < 0 || !file.commit()) {
+        qWarning() << "Failed to save favorites to" << path << ":" << file.errorString();
     }
 }
 
@@ -94,7 +150,18 @@ void FavoritesManager::load() {
             if (root.contains("favorites") && root["favorites"].isArray()) {
                 QJsonArray array = root["favorites"].toArray();
                 for (const auto &val : array) {
-                    m_favorites.insert(val.toString());
+                    // Older files list bare paths
+                    if (val.isString()) {
+                        m_favorites.insert(idFor(val.toString()), FavoriteInfo());
+                        continue;
+                    }
+                    QJsonObject fav = val.toObject();
+                    FavoriteInfo info;
+                    if (fav.contains("measured")) {
+                        info.sizeBytes = static_cast<quint64>(fav["size"].toInteger());
+                        info.measuredAt = QDateTime::fromMSecsSinceEpoch(fav["measured"].toInteger());
+                    }
+                    if (!fav["path"].toString().isEmpty()) m_favorites.insert(idFor(fav["path"].toString()), info);
                 }
             }
         }
@@ -11,7 +11,28 @@
 #include <QJsonObject>
 #include <QFile>
 #include <QMutex>
+#include <QDateTime>
+#include <QHash>
+#include <QThreadPool>
+#include <QTimer>
 
+#include "PathStore.h"
+
+// Last size measured for a favorite; measuredAt is invalid when it never was
+struct FavoriteInfo {
+    quint64 sizeBytes = 0;
+    QDateTime measuredAt;
+};
+
+/*
+ * Starred folders and their last known sizes, persisted to favorites.json.
+ * Changes only mark the set dirty; a coalescing timer snapshots it at most every
+ * 500 ms and a single background thread serializes and writes it, through a
+ * QSaveFile so a crash mid-write leaves the previous file intact. Starring
+ * thousands of paths in a burst therefore costs a handful of writes.
+ * Favorites are kept by PathStore id, the same ids scan results carry, and written
+ * with native separators.
+ */
 class FavoritesManager : public QObject {
     Q_OBJECT
 public:
@@ -21,20 +42,32 @@ public:
     void addFavorite(const QString &path);
     void removeFavorite(const QString &path);
     bool isFavorite(const QString &path) const;
+    bool isFavorite(PathStore::Id path) const;
     QSet<QString> getFavorites() const;
+    QHash<PathStore::Id, FavoriteInfo> getFavoriteInfos() const;
+    // Remembers a measured size
+    void updateSize(const QString &path, quint64 sizeBytes, const QDateTime &measuredAt = QDateTime::currentDateTime());
+    void updateSize(PathStore::Id path, quint64 sizeBytes, const QDateTime &measuredAt = QDateTime::currentDateTime());
 
+    // Schedules a write of the current set; cheap enough to call on every change
     void save();
+    // Writes pending changes now and waits for every write to finish
+    void flush();
     void load();
 
 signals:
     void favoritesChanged();
 
 private:
-    QSet<QString> m_favorites;
+    QHash<PathStore::Id, FavoriteInfo> m_favorites;
     QString m_configPath;
     mutable QMutex m_mutex;
+    QTimer m_saveTimer;
+    QThreadPool m_writer; // one thread, so snapshots land in the order they were taken
 
-    void ensureConfigDirExists();
+    void writeSnapshot();
+    static PathStore::Id idFor(const QString &path) { return PathStore::shared().intern(QDir::fromNativeSeparators(path)); }
+    static void writeFile(const QString &path, const QHash<PathStore::Id, FavoriteInfo> &favorites);
 };
 
 #endif // FAVORITESMANAGER_H
@@ -0,0 +1,41 @@
+#include "FavoritesSizer.h"
+#include "DirectorySizer.h"
+#include "ScanMetrics.h"
+#include <QFileInfo>
+#include <QThread>
+
+FavoritesSizer::FavoritesSizer(QObject *parent)
+    : QObject(parent), m_cancel(std::make_shared<std::atomic<bool>>(false)), m_activeJobs(0) {
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+FavoritesSizer::~FavoritesSizer() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+void FavoritesSizer::start(const QStringList &paths) {
+    if (paths.isEmpty()) return;
+    // Paths queued while a cancelled batch drains are measured all the same
+    if (m_cancel->load()) m_cancel = std::make_shared<std::atomic<bool>>(false);
+
+    m_activeJobs.fetch_add(static_cast<int>(paths.size()));
+    for (const QString &path : paths) {
+        m_pool.start([this, path, cancel = m_cancel]() { measure(path, *cancel); });
+    }
+}
+
+void FavoritesSizer::cancel() {
+    *m_cancel = true;
+}
+
+void FavoritesSizer::measure(const QString &path, const std::atomic<bool> &cancel) {
+    if (!cancel && QFileInfo(path).isDir()) {
+        ScanMetrics::ScopedTimer timer(ScanMetrics::SizeCache);
+        ScanMetrics::add(ScanMetrics::CachesSized);
+        const quint64 size = DirectorySizer(DirectorySizer::Backend::Auto, &cancel).calculate(path);
+        // A cancelled walk stopped part way; its total would replace the stored size with less
+        if (!cancel) emit sized(path, size);
+    }
+    if (m_activeJobs.fetch_sub(1) == 1) emit finished();
+}
@@ -0,0 +1,41 @@
+#ifndef FAVORITESSIZER_H
+#define FAVORITESSIZER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+
+/*
+ * Re-measures favorite folders on a private thread pool, one task per folder,
+ * so the stored sizes shown at startup get replaced without a full scan and
+ * without the caller's thread ever walking a tree. Results arrive one per
+ * folder as they complete; folders that no longer exist are skipped.
+ */
+class FavoritesSizer : public QObject {
+    Q_OBJECT
+public:
+    explicit FavoritesSizer(QObject *parent = nullptr);
+    ~FavoritesSizer();
+
+    bool isRunning() const { return m_activeJobs.load() > 0; }
+
+public slots:
+    void start(const QStringList &paths);
+    void cancel();
+
+signals:
+    void sized(QString path, quint64 sizeBytes);
+    void finished();
+
+private:
+    QThreadPool m_pool;
+    std::shared_ptr<std::atomic<bool>> m_cancel; // the latest batch's; each task holds its own batch's
+    std::atomic<int> m_activeJobs;
+
+    void measure(const QString &path, const std::atomic<bool> &cancel);
+};
+
+#endif // FAVORITESSIZER_H
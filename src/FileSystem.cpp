@@ -0,0 +1,98 @@
+#include "FileSystem.h"
+#include "ScanMetrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+
+qint64 secondsOf(const QDateTime &time) {
+    return time.isValid() ? time.toSecsSinceEpoch() : 0;
+}
+
+FileSystem::Entry entryOf(const QFileInfo &info) {
+    FileSystem::Entry entry;
+    entry.name = info.fileName();
+    // A junction is removed as the link it is, never walked into
+    entry.type = info.isSymLink() || info.isJunction() ? FileSystem::Type::Symlink
+               : info.isDir()     ? FileSystem::Type::Directory
+                                  : FileSystem::Type::File;
+    entry.size = static_cast<quint64>(qMax<qint64>(0, info.size()));
+    entry.modified = secondsOf(info.lastModified());
+    entry.accessed = secondsOf(info.lastRead());
+    return entry;
+}
+
+bool exists(const QFileInfo &info) {
+    return info.exists() || info.isSymLink(); // a dangling symlink is still there to remove
+}
+
+// QDir and QFile report no error codes; the cause is worked out afterwards where it can be
+class LocalFileSystem : public FileSystem {
+public:
+    Error list(const QString &path, QList<Entry> &entries) const override {
+        const QFileInfo dir(path);
+        if (!exists(dir)) return Error::NotFound;
+        if (!dir.isDir() || dir.isSymLink() || dir.isJunction()) return Error::NotDirectory;
+        if (!dir.isReadable()) return Error::PermissionDenied;
+
+        QDirIterator it(path, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                        QDirIterator::NoIteratorFlags);
+        while (it.hasNext()) {
+            it.next();
+            entries.append(entryOf(it.fileInfo()));
+        }
+        return Error::None;
+    }
+
+    Error stat(const QString &path, Entry &entry) const override {
+        const QFileInfo info(path);
+        if (!exists(info)) return Error::NotFound;
+        entry = entryOf(info);
+        return Error::None;
+    }
+
+    Error remove(const QString &path) override {
+        const QFileInfo info(path);
+        if (!exists(info)) return Error::NotFound;
+        const bool isDir = info.isDir() && !info.isSymLink();
+        bool removed = isDir ? QDir().rmdir(path) : QFile::remove(path);
+#ifdef Q_OS_WIN
+        // Read-only files cannot be removed here; like QDir::removeRecursively(), allow writing first
+        if (!removed && !isDir && !(info.permissions() & QFile::WriteUser)) {
+            removed = QFile::setPermissions(path, info.permissions() | QFile::WriteUser) && QFile::remove(path);
+        }
+#endif
+        if (removed) return Error::None;
+        if (isDir && !QDir(path).isEmpty()) return Error::NotEmpty;
+        return QFileInfo(info.absolutePath()).isWritable() ? Error::Other : Error::PermissionDenied;
+    }
+
+    bool isLocal() const override { return true; }
+};
+
+}
+
+FileSystem &FileSystem::local() {
+    static LocalFileSystem fs;
+    return fs;
+}
+
+QString FileSystem::errorString(Error error) {
+    switch (error) {
+    case Error::None: return QString();
+    case Error::NotFound: return QStringLiteral("No such file or directory");
+    case Error::PermissionDenied: return QStringLiteral("Permission denied");
+    case Error::NotDirectory: return QStringLiteral("Not a directory");
+    case Error::NotEmpty: return QStringLiteral("Directory not empty");
+    case Error::Other: break;
+    }
+    return QStringLiteral("Input/output error");
+}
+
+void FileSystem::recordError(Error error) {
+    if (error == Error::None) return;
+    ScanMetrics::add(error == Error::PermissionDenied ? ScanMetrics::PermissionErrors : ScanMetrics::OtherErrors);
+}
@@ -0,0 +1,52 @@
+#ifndef FILESYSTEM_H
+#define FILESYSTEM_H
+
+#include <QList>
+#include <QString>
+
+/*
+ * What scanning, sizing and deletion need from a filesystem, by path: list one
+ * directory, stat one entry, remove one entry. Implementations must allow calls
+ * from any number of threads at once.
+ *
+ * CacheScanner, DirectorySizer and DeletionService only go through a FileSystem
+ * when given one that is not local(): on the local disk they keep their own walks
+ * (getdents, statx, io_uring, fd-relative unlinks), which an interface by path
+ * cannot match. local() is the portable QDir implementation of the same disk for
+ * everything else; MemoryFileSystem stands in for a disk in benchmarks and stress
+ * runs.
+ */
+class FileSystem {
+public:
+    enum class Error { None, NotFound, PermissionDenied, NotDirectory, NotEmpty, Other };
+    enum class Type : quint8 { File, Directory, Symlink };
+
+    struct Entry {
+        QString name;
+        Type type = Type::File;
+        quint64 size = 0;       // apparent bytes
+        qint64 modified = 0;    // seconds since the epoch, 0 = unknown
+        qint64 accessed = 0;
+    };
+
+    virtual ~FileSystem() = default;
+
+    // The entries of one directory, without "." and ".."
+    virtual Error list(const QString &path, QList<Entry> &entries) const = 0;
+    // Does not follow a final symlink; `entry.name` is the last path component
+    virtual Error stat(const QString &path, Entry &entry) const = 0;
+    // A file, a symlink or an empty directory
+    virtual Error remove(const QString &path) = 0;
+    virtual bool isLocal() const { return false; }
+
+    static FileSystem &local();
+    // Null for local(), so callers can keep their native code for the local disk
+    static const FileSystem *virtualOrNull(const FileSystem *fs) { return fs && !fs->isLocal() ? fs : nullptr; }
+    static FileSystem *virtualOrNull(FileSystem *fs) { return fs && !fs->isLocal() ? fs : nullptr; }
+
+    static QString errorString(Error error);
+    // Into ScanMetrics' error counters
+    static void recordError(Error error);
+};
+
+#endif // FILESYSTEM_H
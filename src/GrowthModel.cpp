@@ -0,0 +1,119 @@
+#include "GrowthModel.h"
+#include "ResultsModel.h"
+#include <QBrush>
+#include <QColor>
+#include <algorithm>
+
+GrowthModel::GrowthModel(QObject *parent) : QAbstractTableModel(parent) {
+}
+
+int GrowthModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(m_changes.size());
+}
+
+int GrowthModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant GrowthModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_changes.size()) return QVariant();
+    const ScanHistory::Change &change = m_changes.at(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case PathColumn: return change.path;
+        case StatusColumn: return statusName(change.status);
+        case SizeColumn:
+            return ResultsModel::formatSize(change.status == ScanHistory::Status::Vanished ? change.beforeBytes : change.afterBytes);
+        case ChangeColumn: return formatChange(change.changeBytes());
+        case PerDayColumn:
+            return change.samples >= 2 ? formatChange(qRound64(change.bytesPerDay)) + QStringLiteral("/day") : QStringLiteral("—");
+        }
+        break;
+    case Qt::TextAlignmentRole:
+        if (index.column() >= SizeColumn) return int(Qt::AlignRight | Qt::AlignVCenter);
+        break;
+    case Qt::ToolTipRole:
+        if (index.column() == SizeColumn && change.status == ScanHistory::Status::Present) {
+            return QStringLiteral("Was %1").arg(ResultsModel::formatSize(change.beforeBytes));
+        }
+        if (index.column() == SizeColumn && change.status == ScanHistory::Status::Vanished) {
+            return QStringLiteral("Size when last seen");
+        }
+        if (index.column() == PerDayColumn) {
+            return QStringLiteral("Fitted over the %1 scans that saw this cache").arg(change.samples);
+        }
+        break;
+    case Qt::ForegroundRole:
+        if (index.column() == ChangeColumn || index.column() == PerDayColumn) {
+            const double growth = index.column() == ChangeColumn ? double(change.changeBytes()) : change.bytesPerDay;
+            if (growth > 0) return QBrush(QColor(230, 150, 90));
+            if (growth < 0) return QBrush(QColor(110, 190, 120));
+        }
+        if (change.status == ScanHistory::Status::Vanished) return QBrush(QColor(140, 140, 140));
+        break;
+    }
+    return QVariant();
+}
+
+QVariant GrowthModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+    switch (section) {
+    case PathColumn: return QStringLiteral("Path");
+    case StatusColumn: return QStringLiteral("Status");
+    case SizeColumn: return QStringLiteral("Size");
+    case ChangeColumn: return QStringLiteral("Change");
+    case PerDayColumn: return QStringLiteral("Per Day");
+    }
+    return QVariant();
+}
+
+void GrowthModel::sort(int column, Qt::SortOrder order) {
+    m_sortColumn = column;
+    m_sortOrder = order;
+
+    // Caches without a fitted rate sort by their change instead
+    auto growthOf = [](const ScanHistory::Change &change) {
+        return change.samples >= 2 ? change.bytesPerDay : double(change.changeBytes());
+    };
+    auto less = [column, growthOf](const ScanHistory::Change &a, const ScanHistory::Change &b) {
+        switch (column) {
+        case PathColumn: return a.path < b.path;
+        case StatusColumn: return a.status < b.status;
+        case SizeColumn: return qMax(a.beforeBytes, a.afterBytes) < qMax(b.beforeBytes, b.afterBytes);
+        case ChangeColumn: return a.changeBytes() < b.changeBytes();
+        default: return growthOf(a) < growthOf(b);
+        }
+    };
+
+    emit layoutAboutToBeChanged();
+    if (order == Qt::AscendingOrder) {
+        std::stable_sort(m_changes.begin(), m_changes.end(), less);
+    } else {
+        std::stable_sort(m_changes.begin(), m_changes.end(), [&less](const auto &a, const auto &b) { return less(b, a); });
+    }
+    emit layoutChanged();
+}
+
+void GrowthModel::setChanges(const QList<ScanHistory::Change> &changes) {
+    beginResetModel();
+    m_changes = changes;
+    endResetModel();
+    sort(m_sortColumn, m_sortOrder);
+}
+
+QString GrowthModel::formatChange(qint64 bytes) {
+    if (bytes == 0) return QStringLiteral("0 B");
+    const QString size = ResultsModel::formatSize(static_cast<quint64>(bytes < 0 ? -bytes : bytes));
+    return (bytes < 0 ? QStringLiteral("-") : QStringLiteral("+")) + size;
+}
+
+QString GrowthModel::statusName(ScanHistory::Status status) {
+    switch (status) {
+    case ScanHistory::Status::New: return QStringLiteral("New");
+    case ScanHistory::Status::Vanished: return QStringLiteral("Vanished");
+    case ScanHistory::Status::Present: break;
+    }
+    return QString();
+}
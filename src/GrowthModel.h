@@ -0,0 +1,41 @@
+#ifndef GROWTHMODEL_H
+#define GROWTHMODEL_H
+
+#include <QAbstractTableModel>
+#include <QList>
+
+#include "ScanHistory.h"
+
+/*
+ * The caches of a root compared between two scans of its ScanHistory: size then
+ * and now, the change, and the growth per day fitted over the scans in between.
+ * Fastest growing first; new caches count as growing by their size and vanished
+ * ones as shrinking by theirs.
+ */
+class GrowthModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    enum Column { PathColumn = 0, StatusColumn, SizeColumn, ChangeColumn, PerDayColumn, ColumnCount };
+
+    explicit GrowthModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    void setChanges(const QList<ScanHistory::Change> &changes);
+    const QList<ScanHistory::Change> &changes() const { return m_changes; }
+
+    // "+1.2 GB", "-300 MB"
+    static QString formatChange(qint64 bytes);
+    static QString statusName(ScanHistory::Status status);
+
+private:
+    QList<ScanHistory::Change> m_changes;
+    int m_sortColumn = PerDayColumn;
+    Qt::SortOrder m_sortOrder = Qt::DescendingOrder;
+};
+
+#endif // GROWTHMODEL_H
@@ -0,0 +1,87 @@
+#include "InodeSet.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr size_t kInitialSlots = 1024; // power of two
+
+}
+
+InodeSet::InodeSet()
+    : m_size(0) {
+}
+
+// splitmix64 finalizer: inode numbers are often sequential, probing needs them spread out
+quint64 InodeSet::hash(quint64 inode, quint16 device) {
+    quint64 x = inode ^ (static_cast<quint64>(device) << 48);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+quint16 InodeSet::deviceIndex(quint64 device) {
+    for (size_t i = 0; i < m_devices.size(); ++i) {
+        if (m_devices[i] == device) return static_cast<quint16>(i + 1);
+    }
+    // More devices than fit the slot share the last index; only dedup precision suffers
+    if (m_devices.size() < std::numeric_limits<quint16>::max() - 1) m_devices.push_back(device);
+    return static_cast<quint16>(m_devices.size());
+}
+
+bool InodeSet::visit(quint64 device, quint64 inode, quint64 linkCount, quint64 allocatedBytes) {
+    if ((m_size + 1) * 4 > static_cast<qsizetype>(m_slots.size()) * 3) grow();
+
+    const quint16 dev = deviceIndex(device);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = hash(inode, dev) & mask;; i = (i + 1) & mask) {
+        Slot &slot = m_slots[i];
+        if (slot.device == 0) {
+            slot.inode = inode;
+            slot.device = dev;
+            slot.allocatedBlocks = static_cast<quint32>(std::min<quint64>((allocatedBytes + 511) / 512,
+                                                                          std::numeric_limits<quint32>::max()));
+            slot.linksLeft = static_cast<quint16>(std::min<quint64>(linkCount > 0 ? linkCount - 1 : 0,
+                                                                    std::numeric_limits<quint16>::max()));
+            ++m_size;
+            return true;
+        }
+        if (slot.inode == inode && slot.device == dev) {
+            if (slot.linksLeft > 0 && slot.linksLeft < std::numeric_limits<quint16>::max()) --slot.linksLeft;
+            return false;
+        }
+    }
+}
+
+void InodeSet::grow() {
+    std::vector<Slot> old;
+    old.swap(m_slots);
+    m_slots.assign(old.empty() ? kInitialSlots : old.size() * 2, Slot{0, 0, 0, 0});
+
+    const size_t mask = m_slots.size() - 1;
+    for (const Slot &slot : old) {
+        if (slot.device == 0) continue;
+        size_t i = hash(slot.inode, slot.device) & mask;
+        while (m_slots[i].device != 0) i = (i + 1) & mask;
+        m_slots[i] = slot;
+    }
+}
+
+quint64 InodeSet::fullyLinkedBytes() const {
+    quint64 bytes = 0;
+    for (const Slot &slot : m_slots) {
+        if (slot.device != 0 && slot.linksLeft == 0) bytes += static_cast<quint64>(slot.allocatedBlocks) * 512;
+    }
+    return bytes;
+}
+
+quint64 InodeSet::partiallyLinkedBytes() const {
+    quint64 bytes = 0;
+    for (const Slot &slot : m_slots) {
+        if (slot.device != 0 && slot.linksLeft != 0) bytes += static_cast<quint64>(slot.allocatedBlocks) * 512;
+    }
+    return bytes;
+}
@@ -0,0 +1,50 @@
+#ifndef INODESET_H
+#define INODESET_H
+
+#include <QtGlobal>
+#include <vector>
+
+/*
+ * Hardlink bookkeeping for one size calculation.
+ * Only files with more than one link are tracked; each (device, inode) takes one
+ * 16-byte slot in an open-addressing table (linear probing, grown at 3/4 load),
+ * so tens of millions of linked files cost a few hundred MB at most and plain
+ * files cost nothing.
+ *
+ * A slot remembers how many of the file's links have not been seen yet. Once the
+ * walk is done, files whose links were all inside the tree are what a delete would
+ * actually free; the rest stay allocated through links elsewhere.
+ */
+class InodeSet {
+public:
+    InodeSet();
+
+    // True the first time this (device, inode) is seen
+    bool visit(quint64 device, quint64 inode, quint64 linkCount, quint64 allocatedBytes);
+
+    // Allocated bytes of files with every link seen, and of those with links left outside
+    quint64 fullyLinkedBytes() const;
+    quint64 partiallyLinkedBytes() const;
+
+    qsizetype size() const { return m_size; }
+    qsizetype memoryBytes() const { return static_cast<qsizetype>(m_slots.size() * sizeof(Slot)); }
+
+private:
+    struct Slot {
+        quint64 inode;
+        quint32 allocatedBlocks; // 512-byte units like st_blocks, saturating at 2 TiB
+        quint16 device;          // index into m_devices + 1; 0 marks an empty slot
+        quint16 linksLeft;       // saturating; a file with 65536+ links never completes
+    };
+    static_assert(sizeof(Slot) == 16, "InodeSet slots must stay 16 bytes");
+
+    std::vector<Slot> m_slots;
+    std::vector<quint64> m_devices; // few per walk, searched linearly
+    qsizetype m_size;
+
+    quint16 deviceIndex(quint64 device);
+    void grow();
+    static quint64 hash(quint64 inode, quint16 device);
+};
+
+#endif // INODESET_H
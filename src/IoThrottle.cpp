@@ -0,0 +1,202 @@
+#include "IoThrottle.h"
+#include "ScanMetrics.h"
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <cerrno>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+
+constexpr qint64 kBurstNs = 50LL * 1000 * 1000;        // how far a thread may run ahead of the budget
+constexpr qint64 kWindowNs = 250LL * 1000 * 1000;      // latency adjustment window
+constexpr qint64 kSleepSliceNs = 50LL * 1000 * 1000;   // stop flag checks while sleeping
+constexpr qint64 kMinAutoTargetNs = 1000LL * 1000;
+constexpr quint64 kMinWindowOps = 16;                  // fewer tell nothing about the device
+constexpr double kMinRateFactor = 0.05;
+constexpr double kBackoff = 0.7;
+constexpr double kRecovery = 0.05;
+
+struct ThreadState {
+    quint32 generation = 0;
+    quint64 ops = 0;
+    quint64 bytes = 0;
+    qint64 lastNs = 0;
+};
+
+thread_local ThreadState t_state;
+
+quint64 threadOps() {
+    return ScanMetrics::threadValue(ScanMetrics::DirsOpened) + ScanMetrics::threadValue(ScanMetrics::StatCalls)
+         + ScanMetrics::threadValue(ScanMetrics::FilesUnlinked) + ScanMetrics::threadValue(ScanMetrics::DirsRemoved);
+}
+
+}
+
+IoThrottle &IoThrottle::shared() {
+    static IoThrottle throttle;
+    return throttle;
+}
+
+void IoThrottle::configure(const Limits &limits) {
+    QMutexLocker locker(&m_mutex);
+    if (!m_clock.isValid()) m_clock.start();
+    const qint64 now = m_clock.nsecsElapsed();
+
+    m_limits = limits;
+    m_rateFactor = 1.0;
+    m_lastLatencyNs = 0;
+    m_quietestLatencyNs = 0;
+    m_opsClockNs = now;
+    m_bytesClockNs = now;
+    m_throttledNs = 0;
+    m_windowStartNs = now;
+    m_windowOps = 0;
+    m_windowBusyNs = 0;
+    applyRate();
+
+    // Threads rebase their counters on their next pace() instead of charging what they did before
+    m_generation.fetch_add(1, std::memory_order_release);
+    m_enabled.store(limits.opsPerSecond > 0 || limits.bytesPerSecond > 0, std::memory_order_release);
+}
+
+IoThrottle::Limits IoThrottle::limits() const {
+    QMutexLocker locker(&m_mutex);
+    return m_limits;
+}
+
+IoThrottle::Stats IoThrottle::stats() const {
+    QMutexLocker locker(&m_mutex);
+    Stats stats;
+    stats.rateFactor = m_rateFactor;
+    stats.latencyMs = m_lastLatencyNs / 1e6;
+    stats.latencyTargetMs = m_limits.latencyTargetMs > 0 ? m_limits.latencyTargetMs
+                                                         : qMax<double>(4 * m_quietestLatencyNs, kMinAutoTargetNs) / 1e6;
+    stats.throttledNs = m_throttledNs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Mutex held
+void IoThrottle::applyRate() {
+    m_opsCostNs = m_limits.opsPerSecond > 0 ? 1e9 / (m_limits.opsPerSecond * m_rateFactor) : 0.0;
+    m_byteCostNs = m_limits.bytesPerSecond > 0 ? 1e9 / (m_limits.bytesPerSecond * m_rateFactor) : 0.0;
+}
+
+/*
+ * A call with nothing to charge only restarts the thread's busy clock, so workers
+ * call pace() before a unit of work as well: time spent idle or waiting for a job
+ * then never counts as latency.
+ */
+void IoThrottle::charge(const std::atomic<bool> *stopFlag) {
+    const qint64 now = m_clock.nsecsElapsed();
+    const quint64 ops = threadOps();
+    const quint64 bytes = ScanMetrics::threadValue(ScanMetrics::BytesFreed);
+
+    ThreadState &state = t_state;
+    const quint32 generation = m_generation.load(std::memory_order_acquire);
+    if (state.generation != generation || (ops == state.ops && bytes == state.bytes)) {
+        state = {generation, ops, bytes, now};
+        return;
+    }
+
+    const quint64 newOps = ops - state.ops;
+    const quint64 newBytes = bytes - state.bytes;
+    m_windowOps.fetch_add(newOps, std::memory_order_relaxed);
+    m_windowBusyNs.fetch_add(now - state.lastNs, std::memory_order_relaxed);
+    if (now - m_windowStartNs.load(std::memory_order_relaxed) >= kWindowNs) adjust(now);
+
+    qint64 until = 0;
+    const double opsCost = m_opsCostNs.load(std::memory_order_relaxed);
+    if (opsCost > 0 && newOps > 0) until = reserve(m_opsClockNs, static_cast<qint64>(opsCost * newOps), now);
+    const double byteCost = m_byteCostNs.load(std::memory_order_relaxed);
+    if (byteCost > 0 && newBytes > 0) {
+        until = qMax(until, reserve(m_bytesClockNs, static_cast<qint64>(byteCost * newBytes), now));
+    }
+
+    qint64 slept = 0;
+    for (qint64 left = until - now; left > 0 && !(stopFlag && stopFlag->load(std::memory_order_relaxed));
+         left = until - m_clock.nsecsElapsed()) {
+        QThread::usleep(static_cast<unsigned long>(qMin(left, kSleepSliceNs) / 1000));
+        slept = m_clock.nsecsElapsed() - now;
+    }
+    if (slept > 0) m_throttledNs.fetch_add(slept, std::memory_order_relaxed);
+
+    state.ops = ops;
+    state.bytes = bytes;
+    state.lastNs = m_clock.nsecsElapsed();
+}
+
+// Spends `costNs` of a budget; returns when the caller may continue
+qint64 IoThrottle::reserve(std::atomic<qint64> &clock, qint64 costNs, qint64 now) {
+    qint64 current = clock.load(std::memory_order_relaxed);
+    qint64 next = 0;
+    do {
+        next = qMax(current, now) + costNs;
+    } while (!clock.compare_exchange_weak(current, next, std::memory_order_relaxed));
+    return next - kBurstNs;
+}
+
+// Once per window, by whichever thread notices first; the others carry on
+void IoThrottle::adjust(qint64 now) {
+    if (!m_mutex.tryLock()) return;
+    if (now - m_windowStartNs.load(std::memory_order_relaxed) < kWindowNs) { // another thread just did
+        m_mutex.unlock();
+        return;
+    }
+    const quint64 ops = m_windowOps.exchange(0, std::memory_order_relaxed);
+    const qint64 busyNs = m_windowBusyNs.exchange(0, std::memory_order_relaxed);
+    m_windowStartNs.store(now, std::memory_order_relaxed);
+
+    if (ops >= kMinWindowOps) {
+        m_lastLatencyNs = double(busyNs) / ops;
+        if (m_quietestLatencyNs == 0 || m_lastLatencyNs < m_quietestLatencyNs) m_quietestLatencyNs = m_lastLatencyNs;
+        const double targetNs = m_limits.latencyTargetMs > 0 ? m_limits.latencyTargetMs * 1e6
+                                                             : qMax<double>(4 * m_quietestLatencyNs, kMinAutoTargetNs);
+        m_rateFactor = m_lastLatencyNs > targetNs ? qMax(kMinRateFactor, m_rateFactor * kBackoff)
+                                                  : qMin(1.0, m_rateFactor + kRecovery);
+        applyRate();
+    }
+    m_mutex.unlock();
+}
+
+bool IoThrottle::lowerProcessPriority(int niceLevel, QString *error) {
+#if defined(Q_OS_WIN)
+    // Lowers CPU, I/O and memory priority together; there is no separate nice level
+    Q_UNUSED(niceLevel);
+    if (!SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN)) {
+        if (error) *error = qt_error_string(static_cast<int>(GetLastError()));
+        return false;
+    }
+    return true;
+#elif defined(Q_OS_UNIX)
+    // Per thread on Linux; threads started later inherit it
+    if (setpriority(PRIO_PROCESS, 0, niceLevel) != 0) {
+        if (error) *error = qt_error_string(errno);
+        return false;
+    }
+    setIdleIoPriority();
+    return true;
+#else
+    Q_UNUSED(niceLevel);
+    Q_UNUSED(error);
+    return true;
+#endif
+}
+
+// Only gets the disk while nobody else wants it, with schedulers that honour I/O classes (BFQ, mq-deadline)
+void IoThrottle::setIdleIoPriority() {
+#ifdef Q_OS_LINUX
+    constexpr int kIoprioWhoProcess = 1; // a thread id, 0 = the calling thread
+    constexpr int kIoprioClassIdle = 3;
+    constexpr int kIoprioClassShift = 13;
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift);
+#endif
+}
@@ -0,0 +1,93 @@
+#ifndef IOTHROTTLE_H
+#define IOTHROTTLE_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+
+/*
+ * Process-wide pacing of scan, sizing and deletion I/O for hosts that must not
+ * notice a run.
+ *
+ * Walks call pace() between directories (and deletion between files). It charges
+ * the calling thread's I/O since its previous call, taken from its own ScanMetrics
+ * counters: operations are directories opened, stat calls, unlinks and rmdirs;
+ * bytes are the apparent size of deleted files. A scan reads no file data, so only
+ * deletion spends the bytes budget. Both budgets are virtual clocks shared by every
+ * thread (GCRA); a thread that runs ahead sleeps off the difference, a short burst
+ * being allowed.
+ *
+ * The ceilings are only upper bounds. The busy time between two pace() calls, less
+ * any sleep, divided by the operations done is the observed latency per operation.
+ * Every adjustment window whose average exceeds the target cuts the rate (by 30%,
+ * down to 5% of the ceiling) and every window below it adds 5% back, so the run
+ * backs off while the device is contended and recovers once it is quiet again.
+ * Without an explicit target it is four times the lowest window average seen, at
+ * least 1 ms.
+ *
+ * Disabled until configure() gets a ceiling; pace() is then one relaxed load.
+ */
+class IoThrottle {
+public:
+    struct Limits {
+        double opsPerSecond = 0;    // 0 = no ceiling
+        double bytesPerSecond = 0;  // bytes deleted; 0 = no ceiling
+        double latencyTargetMs = 0; // 0 = from the quietest window seen
+    };
+
+    struct Stats {
+        double rateFactor = 1.0;    // share of the ceilings currently allowed
+        double latencyMs = 0;       // per operation, last window
+        double latencyTargetMs = 0;
+        qint64 throttledNs = 0;     // summed over threads, since configure()
+    };
+
+    static IoThrottle &shared();
+
+    void configure(const Limits &limits);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    Limits limits() const;
+    Stats stats() const;
+
+    // Stops sleeping early once `stopFlag` is set
+    static void pace(const std::atomic<bool> *stopFlag = nullptr) {
+        IoThrottle &throttle = shared();
+        if (throttle.isEnabled()) throttle.charge(stopFlag);
+    }
+
+    // Nice level and the idle I/O class (background mode on Windows) for the calling
+    // thread, and the threads it starts afterwards; call before starting any workers
+    static bool lowerProcessPriority(int niceLevel, QString *error = nullptr);
+    // The idle I/O class for the calling thread only (Linux)
+    static void setIdleIoPriority();
+
+private:
+    std::atomic<bool> m_enabled{false};
+    std::atomic<quint32> m_generation{0};
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_mutex; // configuration and window adjustment
+    Limits m_limits;
+    std::atomic<double> m_opsCostNs{0};    // per operation at the current rate, 0 = no ceiling
+    std::atomic<double> m_byteCostNs{0};   // per byte deleted
+    std::atomic<qint64> m_opsClockNs{0};   // virtual times the budgets are spent up to
+    std::atomic<qint64> m_bytesClockNs{0};
+    std::atomic<qint64> m_throttledNs{0};
+
+    // Current adjustment window
+    std::atomic<qint64> m_windowStartNs{0};
+    std::atomic<quint64> m_windowOps{0};
+    std::atomic<qint64> m_windowBusyNs{0};
+    double m_rateFactor = 1.0;
+    double m_lastLatencyNs = 0;
+    double m_quietestLatencyNs = 0;
+
+    IoThrottle() = default;
+    void charge(const std::atomic<bool> *stopFlag);
+    qint64 reserve(std::atomic<qint64> &clock, qint64 costNs, qint64 now);
+    void adjust(qint64 now);
+    void applyRate();
+};
+
+#endif // IOTHROTTLE_H
@@ -0,0 +1,222 @@
+#include "IoUring.h"
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_OP_STATX) && defined(IORING_REGISTER_PROBE)
+#define DFCACHE_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef DFCACHE_HAVE_IO_URING
+
+namespace {
+
+constexpr unsigned kMaxEntries = 4096;
+
+template <typename T>
+T *at(void *base, unsigned offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+}
+
+IoUring::IoUring()
+    : m_fd(-1), m_sqRing(MAP_FAILED), m_sqRingSize(0), m_cqRing(MAP_FAILED), m_cqRingSize(0),
+      m_sqes(MAP_FAILED), m_sqesSize(0), m_sqTail(nullptr), m_sqMask(nullptr), m_sqArray(nullptr),
+      m_cqHead(nullptr), m_cqTail(nullptr), m_cqMask(nullptr), m_cqes(nullptr),
+      m_entries(0), m_queued(0), m_canOpen(false) {
+}
+
+IoUring::~IoUring() {
+    if (m_sqes != MAP_FAILED) munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing != MAP_FAILED) munmap(m_sqRing, m_sqRingSize);
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+std::unique_ptr<IoUring> IoUring::create(unsigned queueDepth) {
+    std::unique_ptr<IoUring> ring(new IoUring());
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring->m_fd = static_cast<int>(syscall(__NR_io_uring_setup, qBound(1u, queueDepth, kMaxEntries), &params));
+    if (ring->m_fd < 0) return nullptr;
+
+    ring->m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) ring->m_sqRingSize = ring->m_cqRingSize = qMax(ring->m_sqRingSize, ring->m_cqRingSize);
+
+    ring->m_sqRing = mmap(nullptr, ring->m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring->m_fd, IORING_OFF_SQ_RING);
+    if (ring->m_sqRing == MAP_FAILED) return nullptr;
+    ring->m_cqRing = singleMmap ? ring->m_sqRing
+        : mmap(nullptr, ring->m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->m_fd, IORING_OFF_CQ_RING);
+    if (ring->m_cqRing == MAP_FAILED) return nullptr;
+    ring->m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->m_sqes = mmap(nullptr, ring->m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->m_fd, IORING_OFF_SQES);
+    if (ring->m_sqes == MAP_FAILED) return nullptr;
+
+    ring->m_sqTail = at<unsigned>(ring->m_sqRing, params.sq_off.tail);
+    ring->m_sqMask = at<unsigned>(ring->m_sqRing, params.sq_off.ring_mask);
+    ring->m_sqArray = at<unsigned>(ring->m_sqRing, params.sq_off.array);
+    ring->m_cqHead = at<unsigned>(ring->m_cqRing, params.cq_off.head);
+    ring->m_cqTail = at<unsigned>(ring->m_cqRing, params.cq_off.tail);
+    ring->m_cqMask = at<unsigned>(ring->m_cqRing, params.cq_off.ring_mask);
+    ring->m_cqes = at<void>(ring->m_cqRing, params.cq_off.cqes);
+    ring->m_entries = params.sq_entries;
+
+    // Opcodes arrived one kernel at a time; statx is required, openat is used when there
+    const size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<char> probeBuffer(probeSize, 0);
+    auto *probe = reinterpret_cast<io_uring_probe *>(probeBuffer.data());
+    if (syscall(__NR_io_uring_register, ring->m_fd, IORING_REGISTER_PROBE, probe, 256) < 0) return nullptr;
+    auto supported = [probe](int op) {
+        return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    };
+    if (!supported(IORING_OP_STATX)) return nullptr;
+    ring->m_canOpen = supported(IORING_OP_OPENAT);
+    return ring;
+}
+
+bool IoUring::isAvailable() {
+    static const bool available = create(8) != nullptr;
+    return available;
+}
+
+void *IoUring::nextSqe() {
+    if (m_queued >= m_entries) return nullptr;
+    // Only this thread writes the tail; the kernel reads it once io_uring_enter runs
+    const unsigned tail = *m_sqTail;
+    const unsigned index = tail & *m_sqMask;
+    auto *sqe = static_cast<io_uring_sqe *>(m_sqes) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[index] = index;
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++m_queued;
+    return sqe;
+}
+
+bool IoUring::queueStatx(int dirFd, const char *name, unsigned mask, void *buffer, quint64 tag) {
+    if (m_queued >= m_entries) return false;
+    auto *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = dirFd;
+    sqe->addr = reinterpret_cast<quint64>(name);
+    sqe->len = mask;
+    sqe->off = reinterpret_cast<quint64>(buffer);
+    sqe->statx_flags = AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC;
+    sqe->user_data = tag;
+    return true;
+}
+
+bool IoUring::queueOpenat(int dirFd, const char *name, int flags, quint64 tag) {
+    if (!m_canOpen || m_queued >= m_entries) return false;
+    auto *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = dirFd;
+    sqe->addr = reinterpret_cast<quint64>(name);
+    sqe->open_flags = static_cast<quint32>(flags);
+    sqe->user_data = tag;
+    return true;
+}
+
+unsigned IoUring::reap(std::vector<Completion> &completions) {
+    unsigned head = *m_cqHead;
+    const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    for (; head != tail; ++head, ++count) {
+        const auto &cqe = static_cast<io_uring_cqe *>(m_cqes)[head & *m_cqMask];
+        completions.push_back({cqe.user_data, cqe.res});
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+bool IoUring::submitAndWait(std::vector<Completion> &completions) {
+    const unsigned total = m_queued;
+    unsigned submitted = 0;
+    unsigned completed = 0;
+    bool ok = true;
+    while (completed < total) {
+        // The kernel skips the wait when it could not take every entry, so this never blocks on
+        // operations that were not submitted
+        const unsigned toSubmit = total - submitted;
+        const long ret = syscall(__NR_io_uring_enter, m_fd, toSubmit, total - completed,
+                                 IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            ok = false;
+            break;
+        }
+        submitted += static_cast<unsigned>(ret);
+        completed += reap(completions);
+        if (ret == 0 && toSubmit > 0 && completed == submitted) {
+            // The kernel took nothing and nothing is left to wait for
+            ok = false;
+            break;
+        }
+    }
+    // What the kernel took still points into the caller's names and buffers, which go away
+    // once this returns: wait it out
+    while (completed < submitted) {
+        const long ret = syscall(__NR_io_uring_enter, m_fd, 0, submitted - completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) break;
+        completed += reap(completions);
+    }
+    // Unsubmitted entries would be picked up by the next enter; there must be none
+    if (submitted < total) {
+        __atomic_store_n(m_sqTail, *m_sqTail - (total - submitted), __ATOMIC_RELEASE);
+    }
+    m_queued = 0;
+    return ok;
+}
+
+#else
+
+IoUring::IoUring()
+    : m_fd(-1), m_sqRing(nullptr), m_sqRingSize(0), m_cqRing(nullptr), m_cqRingSize(0),
+      m_sqes(nullptr), m_sqesSize(0), m_sqTail(nullptr), m_sqMask(nullptr), m_sqArray(nullptr),
+      m_cqHead(nullptr), m_cqTail(nullptr), m_cqMask(nullptr), m_cqes(nullptr),
+      m_entries(0), m_queued(0), m_canOpen(false) {
+}
+
+IoUring::~IoUring() = default;
+
+std::unique_ptr<IoUring> IoUring::create(unsigned) {
+    return nullptr;
+}
+
+bool IoUring::isAvailable() {
+    return false;
+}
+
+void *IoUring::nextSqe() {
+    return nullptr;
+}
+
+bool IoUring::queueStatx(int, const char *, unsigned, void *, quint64) {
+    return false;
+}
+
+bool IoUring::queueOpenat(int, const char *, int, quint64) {
+    return false;
+}
+
+unsigned IoUring::reap(std::vector<Completion> &) {
+    return 0;
+}
+
+bool IoUring::submitAndWait(std::vector<Completion> &completions) {
+    completions.clear();
+    return false;
+}
+
+#endif // DFCACHE_HAVE_IO_URING
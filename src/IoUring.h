@@ -0,0 +1,74 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <QtGlobal>
+#include <memory>
+#include <vector>
+
+/*
+ * Minimal io_uring ring over the raw syscalls (no liburing), just enough for
+ * batched statx and openat relative to a directory fd.
+ *
+ * Work is done in batches: queue up to queueDepth() operations, then
+ * submitAndWait() hands them to the kernel with one io_uring_enter and returns
+ * once every one of them has completed. Nothing is in flight between batches, so
+ * a recursive walk can reuse one ring per thread.
+ *
+ * Linux only. create() returns null when the headers, the kernel (statx needs
+ * 5.6) or a seccomp filter (as in many containers) rule io_uring out.
+ */
+class IoUring {
+public:
+    struct Completion {
+        quint64 tag;
+        int result; // >= 0 on success (an fd for openat), -errno otherwise
+    };
+
+    static std::unique_ptr<IoUring> create(unsigned queueDepth);
+    // Probed once per process
+    static bool isAvailable();
+
+    ~IoUring();
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    unsigned queueDepth() const { return m_entries; }
+    bool canOpen() const { return m_canOpen; }
+    unsigned queued() const { return m_queued; }
+
+    // False when the batch is full. `name` and `buffer` must stay valid until submitAndWait() returns.
+    bool queueStatx(int dirFd, const char *name, unsigned mask, void *buffer, quint64 tag);
+    bool queueOpenat(int dirFd, const char *name, int flags, quint64 tag);
+
+    // False when the kernel refused the batch; completions of what did run are still reported,
+    // and whatever it took is waited for even then. Do not reuse a ring that returned false.
+    bool submitAndWait(std::vector<Completion> &completions);
+
+private:
+    IoUring();
+
+    int m_fd;
+    void *m_sqRing;
+    size_t m_sqRingSize;
+    void *m_cqRing;
+    size_t m_cqRingSize;
+    void *m_sqes;
+    size_t m_sqesSize;
+
+    unsigned *m_sqTail;
+    unsigned *m_sqMask;
+    unsigned *m_sqArray;
+    unsigned *m_cqHead;
+    unsigned *m_cqTail;
+    unsigned *m_cqMask;
+    void *m_cqes;
+
+    unsigned m_entries;
+    unsigned m_queued;
+    bool m_canOpen;
+
+    void *nextSqe();
+    unsigned reap(std::vector<Completion> &completions);
+};
+
+#endif // IOURING_H
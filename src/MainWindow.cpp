@@ -10,40 +10,70 @@
 #include <QMenu>
 #include <QAction>
 #include <QCheckBox>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QStandardPaths>
+#include <QDialog>
+#include <QInputDialog>
+#include <QStorageInfo>
+#include <QTreeView>
+#include <QComboBox>
+#include <QDateTime>
+#include "GrowthModel.h"
+#include "ReclaimPlanner.h"
+#include "ScanHistory.h"
+#include "SizeTreeModel.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent), scanner(nullptr), isScanning(false) {
     
     favManager = new FavoritesManager(this);
+    favSizer = new FavoritesSizer(this);
+    deletionService = new DeletionService(this);
+    stagingPurger = new StagingPurger(this);
     
     setupUI();
     setupStyle();
     
     // Connect favorites changed signal if needed, though we update UI manually often
     connect(favManager, &FavoritesManager::favoritesChanged, this, &MainWindow::updateFavoritesUI);
+
+    connect(favSizer, &FavoritesSizer::sized, this, &MainWindow::onFavoriteSized);
+
+    connect(deletionService, &DeletionService::progress, this, &MainWindow::onDeletionProgress);
+    connect(deletionService, &DeletionService::pathFinished, this, &MainWindow::onPathDeleted);
+    connect(deletionService, &DeletionService::finished, this, &MainWindow::onDeletionFinished);
+
+    connect(stagingPurger, &StagingPurger::progress, this, &MainWindow::onPurgeProgress);
+    connect(stagingPurger, &StagingPurger::idle, this, &MainWindow::onPurgeIdle);
+    // Anything a previous run staged but did not get to purge
+    stagingPurger->resume();
+
+    // Watching runs on its own thread; results come back like scan batches
+    watcherThread = new QThread(this);
+    watcher = new CacheWatcher();
+    watcher->moveToThread(watcherThread);
+    connect(watcherThread, &QThread::finished, watcher, &QObject::deleteLater);
+    connect(watcher, &CacheWatcher::cachesUpdated, this, &MainWindow::onCacheFound);
+    connect(watcher, &CacheWatcher::cachesRemoved, this, &MainWindow::onCachesRemoved);
+    connect(watcher, &CacheWatcher::watchStatus, this, &MainWindow::onWatchStatus);
+    watcherThread->start();
     
-    // Initial Load of Favorites into Table?
-    // User Requirement: "On startup: Loads favorites automaticall, Displays them immediately without scanning"
-    // However, we don't know the SIZE of favorites unless we scan them?
-    // Or we just check if they exist.  The prompt implies they should be listed.
-    // We will verify existence and show them.
-    
-    for (const QString &path : favManager->getFavorites()) {
-        QFileInfo info(path);
-        if (info.exists() && info.isDir()) {
-             // We can do a quick size check or just show "Unknown" until scan?
-             // Prompt says "Displays results...". I will do a quick calc on main thread or just 0 for now
-             // to keep startup fast.
-             addTableDataType(path, 0, true);
-        }
-    }
+    // Favorites show their last known size right away; fresh sizes replace them as they come in
+    favSizer->start(favManager->getFavorites().values());
+    addFavoriteRows();
 }
 
 MainWindow::~MainWindow() {
+    favSizer->cancel();
+    deletionService->cancel();
+    stagingPurger->cancel();
     if (scanner) {
         scanner->stop();
         scanner->wait();
     }
+    watcherThread->quit();
+    watcherThread->wait();
 }
 
 void MainWindow::setupUI() {
@@ -58,7 +88,14 @@ void MainWindow::setupUI() {
     pathInput = new QLineEdit(this);
     pathInput->setPlaceholderText("Select directory to scan...");
     browseBtn = new QPushButton("Browse...", this);
+    rulesBtn = new QPushButton("Rules...", this);
+    rulesBtn->setToolTip("Folders the scan of this folder skips without reading them");
+    growthBtn = new QPushButton("Growth...", this);
+    growthBtn->setToolTip("How the caches in this folder grew between its complete scans");
     scanBtn = new QPushButton("Scan", this);
+    // A paused or stopped scan is saved and picks up where it left off next time
+    pauseBtn = new QPushButton("Pause", this);
+    pauseBtn->setVisible(false);
     
     // Min size filter
     QLabel *minSizeLabel = new QLabel("Min Size (MB):", this);
@@ -66,53 +103,120 @@ void MainWindow::setupUI() {
     minSizeSpinBox->setRange(0, 10000);
     minSizeSpinBox->setValue(50);
     minSizeSpinBox->setSuffix(" MB");
+
+    // Reuse the previous scan of this root for directories that did not change
+    incrementalCheck = new QCheckBox("Incremental", this);
+    incrementalCheck->setChecked(true);
+    incrementalCheck->setToolTip("Skip directories unchanged since the last complete scan of this folder");
+
+    // Allocated-size accounting; off by default since it walks every cache in full
+    reclaimCheck = new QCheckBox("Reclaimable", this);
+    reclaimCheck->setToolTip("Also measure the disk space deleting each cache frees: allocated blocks, counting hardlinked files once");
+
+    // Size trees keep every entry below each cache in memory for drill-down
+    treeCheck = new QCheckBox("Tree", this);
+    treeCheck->setToolTip("Keep the contents of each cache for exploring and deleting parts of it (walks caches in full)");
+
+    oneFileSystemCheck = new QCheckBox("One filesystem", this);
+    oneFileSystemCheck->setToolTip("Do not descend into other mounted filesystems");
+
+    watchCheck = new QCheckBox("Watch", this);
+    watchCheck->setChecked(true);
+    watchCheck->setToolTip("Keep sizes current and pick up new cache folders after a scan");
     
     topLayout->addWidget(pathInput);
     topLayout->addWidget(browseBtn);
+    topLayout->addWidget(rulesBtn);
+    topLayout->addWidget(growthBtn);
     topLayout->addWidget(minSizeLabel);
     topLayout->addWidget(minSizeSpinBox);
+    topLayout->addWidget(incrementalCheck);
+    topLayout->addWidget(reclaimCheck);
+    topLayout->addWidget(treeCheck);
+    topLayout->addWidget(oneFileSystemCheck);
+    topLayout->addWidget(watchCheck);
+    topLayout->addWidget(pauseBtn);
     topLayout->addWidget(scanBtn);
     
-    // Center Table
-    resultsTable = new QTableWidget(this);
-    resultsTable->setColumnCount(3);
-    resultsTable->setHorizontalHeaderLabels({"Folder Path", "Size", "Fav"});
-    resultsTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
-    resultsTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Interactive);
-    resultsTable->setColumnWidth(1, 100);
-    resultsTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Fixed);
-    resultsTable->setColumnWidth(2, 50);
+    // Filter
+    filterInput = new QLineEdit(this);
+    filterInput->setPlaceholderText("Filter results...");
+    filterInput->setClearButtonEnabled(true);
+
+    // Center Table (virtualized: rows live in ResultsModel, not in widget items)
+    resultsModel = new ResultsModel(this);
+    resultsTable = new QTableView(this);
+    resultsTable->setModel(resultsModel);
+    resultsTable->horizontalHeader()->setSectionResizeMode(ResultsModel::PathColumn, QHeaderView::Stretch);
+    resultsTable->horizontalHeader()->setSectionResizeMode(ResultsModel::SizeColumn, QHeaderView::Interactive);
+    resultsTable->setColumnWidth(ResultsModel::SizeColumn, 100);
+    resultsTable->horizontalHeader()->setSectionResizeMode(ResultsModel::ReclaimableColumn, QHeaderView::Interactive);
+    resultsTable->setColumnWidth(ResultsModel::ReclaimableColumn, 100);
+    resultsTable->setColumnHidden(ResultsModel::ReclaimableColumn, true);
+    resultsTable->horizontalHeader()->setSectionResizeMode(ResultsModel::LastUsedColumn, QHeaderView::Interactive);
+    resultsTable->setColumnWidth(ResultsModel::LastUsedColumn, 100);
+    resultsTable->horizontalHeader()->setSectionResizeMode(ResultsModel::FavoriteColumn, QHeaderView::Fixed);
+    resultsTable->setColumnWidth(ResultsModel::FavoriteColumn, 50);
+    resultsTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    resultsTable->verticalHeader()->setDefaultSectionSize(24);
     resultsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     resultsTable->setContextMenuPolicy(Qt::CustomContextMenu);
     resultsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    resultsTable->setSortingEnabled(true);
+    resultsTable->sortByColumn(ResultsModel::SizeColumn, Qt::DescendingOrder);
     
     // Bottom Bar
     QHBoxLayout *bottomLayout = new QHBoxLayout();
     deleteSelectedBtn = new QPushButton("Delete Selected", this);
     deleteAllBtn = new QPushButton("Delete All", this);
+    freeSpaceBtn = new QPushButton("Free Space...", this);
+    freeSpaceBtn->setToolTip("Delete the fewest, oldest and largest caches that free a given amount on this disk; favorites are kept");
+    cancelDeleteBtn = new QPushButton("Cancel Delete", this);
+    cancelDeleteBtn->setVisible(false);
+    instantDeleteCheck = new QCheckBox("Instant delete", this);
+    instantDeleteCheck->setToolTip("Move folders into a staging folder on the same disk right away and free the space in the background");
+    bottomLayout->addWidget(instantDeleteCheck);
     bottomLayout->addStretch();
     bottomLayout->addWidget(deleteSelectedBtn);
     bottomLayout->addWidget(deleteAllBtn);
+    bottomLayout->addWidget(freeSpaceBtn);
+    bottomLayout->addWidget(cancelDeleteBtn);
     
     // Status Bar
     progressBar = new QProgressBar(this);
     progressBar->setRange(0, 0); // Indeterminate
     progressBar->setVisible(false);
     statusLabel = new QLabel("Ready", this);
+    watchLabel = new QLabel(this);
+    purgeLabel = new QLabel(this);
+    purgeLabel->setVisible(false);
+    statusBar()->addPermanentWidget(purgeLabel);
+    statusBar()->addPermanentWidget(watchLabel);
     statusBar()->addPermanentWidget(progressBar);
     statusBar()->addWidget(statusLabel);
 
     mainLayout->addLayout(topLayout);
+    mainLayout->addWidget(filterInput);
     mainLayout->addWidget(resultsTable);
     mainLayout->addLayout(bottomLayout);
 
     // Connections
     connect(browseBtn, &QPushButton::clicked, this, &MainWindow::browseFolder);
+    connect(rulesBtn, &QPushButton::clicked, this, &MainWindow::editPruneRules);
+    connect(growthBtn, &QPushButton::clicked, this, &MainWindow::showGrowth);
     connect(scanBtn, &QPushButton::clicked, this, &MainWindow::startScan);
-    connect(resultsTable, &QTableWidget::cellClicked, this, &MainWindow::toggleFavorite);
-    connect(resultsTable, &QTableWidget::customContextMenuRequested, this, &MainWindow::showContextMenu);
+    connect(pauseBtn, &QPushButton::clicked, this, &MainWindow::togglePause);
+    connect(filterInput, &QLineEdit::textChanged, resultsModel, &ResultsModel::setFilterText);
+    connect(resultsTable, &QTableView::clicked, this, &MainWindow::toggleFavorite);
+    connect(resultsTable, &QTableView::customContextMenuRequested, this, &MainWindow::showContextMenu);
+    connect(resultsTable, &QTableView::doubleClicked, this, [this](const QModelIndex &index) {
+        if (index.column() != ResultsModel::FavoriteColumn) exploreCache(resultsModel->entryAt(index.row()).path());
+    });
     connect(deleteSelectedBtn, &QPushButton::clicked, this, &MainWindow::deleteSelected);
     connect(deleteAllBtn, &QPushButton::clicked, this, &MainWindow::deleteAll);
+    connect(freeSpaceBtn, &QPushButton::clicked, this, &MainWindow::planReclaim);
+    connect(cancelDeleteBtn, &QPushButton::clicked, deletionService, &DeletionService::cancel);
+    connect(watchCheck, &QCheckBox::toggled, this, &MainWindow::updateWatching);
 }
 
 void MainWindow::setupStyle() {
@@ -153,7 +257,7 @@ void MainWindow::setupStyle() {
             color: white;
             padding: 5px;
         }
-        QTableWidget {
+        QTableView {
             background-color: #252525;
             gridline-color: #353535;
             color: white;
@@ -183,6 +287,7 @@ void MainWindow::startScan() {
         // Stop logic
         if (scanner) scanner->stop();
         scanBtn->setText("Scan");
+        pauseBtn->setVisible(false);
         return;
     }
 
@@ -192,20 +297,25 @@ void MainWindow::startScan() {
         return;
     }
 
-    resultsTable->setRowCount(0);
+    // Sizes from the watcher would race with the new scan
+    watchedRoot.clear();
+    updateWatching();
+
+    resultsModel->clear();
     // Re-populate favorites
-    for (const QString &fav : favManager->getFavorites()) {
-        if (QFileInfo::exists(fav)) {
-           // For simplicity in this logic, we clear and re-add favorites 
-           // In a smarter app we might merge, but let's keep it simple.
-           addTableDataType(fav, 0, true);
-        }
-    }
+    addFavoriteRows();
 
     scanBtn->setText("Stop");
+    pauseBtn->setText("Pause");
+    pauseBtn->setVisible(true);
     isScanning = true;
-    progressBar->setVisible(true);
+    updateBusyState();
     statusLabel->setText("Scanning...");
+    statusLabel->setToolTip(QString());
+    ScanMetrics::resetPeaks();
+    scanMetricsStart = ScanMetrics::snapshot();
+    scanDevices.clear();
+    scanPruned.clear();
 
     if (scanner) {
         scanner->deleteLater();
@@ -214,144 +324,453 @@ void MainWindow::startScan() {
     // Get min size in bytes from spinbox
     quint64 minSizeBytes = static_cast<quint64>(minSizeSpinBox->value()) * 1024ULL * 1024ULL;
     scanner = new CacheScanner(path, minSizeBytes, this);
+    if (incrementalCheck->isChecked()) {
+        scanner->setIndexPath(indexPathFor(path));
+    }
+    if (reclaimCheck->isChecked()) {
+        scanner->setAccounting(DirectorySizer::Accounting::Allocated);
+    }
+    resultsTable->setColumnHidden(ResultsModel::ReclaimableColumn, !reclaimCheck->isChecked());
+    scanner->setOneFileSystem(oneFileSystemCheck->isChecked());
+    scanner->setBuildTrees(treeCheck->isChecked());
+    scanner->setCheckpointPath(checkpointPathFor(path));
+    scanner->setHistoryPath(historyPathFor(path));
+    scanner->setPruneRules(PruneRules::configuredRules(path));
     
     connect(scanner, &CacheScanner::progress, this, &MainWindow::onScanProgress);
-    connect(scanner, &CacheScanner::cacheFound, this, &MainWindow::onCacheFound);
+    connect(scanner, &CacheScanner::resumedFromCheckpoint, this, &MainWindow::onScanResumed);
+    connect(scanner, &CacheScanner::cachesFound, this, &MainWindow::onCacheFound);
+    connect(scanner, &CacheScanner::deviceStats, this, &MainWindow::onDeviceStats);
+    connect(scanner, &CacheScanner::pruneStats, this, &MainWindow::onPruneStats);
     connect(scanner, &CacheScanner::scanFinished, this, &MainWindow::onScanFinished);
     
     scanner->start();
 }
 
-void MainWindow::onScanProgress(const QString &path) {
-    statusLabel->setText("Scanning: " + path);
+void MainWindow::togglePause() {
+    if (!scanner || !isScanning) return;
+    if (scanner->isPaused()) {
+        scanner->resume();
+        pauseBtn->setText("Pause");
+        statusLabel->setText("Scanning...");
+    } else {
+        scanner->pause();
+        pauseBtn->setText("Resume");
+        statusLabel->setText("Paused. Progress is saved; stopping or closing keeps it for the next scan of this folder.");
+    }
+}
+
+void MainWindow::onScanResumed(int pendingDirs, int caches) {
+    statusLabel->setText(QString("Continuing the previous scan: %1 folders left, %2 caches already found")
+                             .arg(pendingDirs)
+                             .arg(caches));
 }
 
-void MainWindow::onCacheFound(CacheFolderInfo info) {
-    // Check if already in table (e.g. from favorites) to update size/avoid dups?
-    // For now, simpler: check for duplicates
-    QList<QTableWidgetItem *> items = resultsTable->findItems(info.path, Qt::MatchExactly);
-    if (!items.isEmpty()) {
-        // Update size if it was a favorite added with 0 size
-        int row = items.first()->row();
-        resultsTable->item(row, 1)->setText(formatSize(info.sizeBytes));
-        return; 
+void MainWindow::editPruneRules() {
+    const QString path = pathInput->text();
+    if (path.isEmpty()) {
+        QMessageBox::warning(this, "Input Error", "Please select a directory first.");
+        return;
+    }
+
+    // Only this folder's own rules; rules under "*" in the file apply to every folder
+    const QStringList rules = PruneRules::storedRules(path);
+    bool ok = false;
+    const QString text = QInputDialog::getMultiLineText(
+        this, "Skip Rules",
+        "One rule per line, applied to scanning and sizing:\n"
+        "  /full/path   skip this folder and everything below it\n"
+        "  .git, *.zarr   skip every folder with this name\n"
+        "  .git/objects   skip by the end of the path\n"
+        "  !/full/path   scan this folder even though a rule above skips it",
+        rules.join('\n'), &ok);
+    if (!ok) return;
+
+    QStringList edited;
+    for (const QString &line : text.split('\n')) {
+        if (!line.trimmed().isEmpty()) edited.append(line.trimmed());
+    }
+    if (!PruneRules::saveConfiguredRules(path, edited)) {
+        QMessageBox::warning(this, "Skip Rules", "Could not save the rules to " + PruneRules::configPath());
     }
-    
-    bool isFav = favManager->isFavorite(info.path);
-    addTableDataType(info.path, info.sizeBytes, isFav);
+}
+
+/*
+ * The latest scan of the folder against an earlier one. The history is read once
+ * per dialog; switching the comparison only replays the frames in between.
+ */
+void MainWindow::showGrowth() {
+    const QString path = pathInput->text();
+    if (path.isEmpty()) {
+        QMessageBox::warning(this, "Input Error", "Please select a directory first.");
+        return;
+    }
+    auto history = std::make_shared<ScanHistory>();
+    if (!history->open(historyPathFor(path))) {
+        QMessageBox::warning(this, "Growth", "The scan history of this folder could not be read.");
+        return;
+    }
+    if (history->scans().size() < 2) {
+        QMessageBox::information(this, "Growth", "Growth shows once this folder has been scanned completely at least twice.");
+        return;
+    }
+
+    QDialog *dialog = new QDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle("Growth - " + path);
+    dialog->resize(900, 500);
+
+    QComboBox *baseline = new QComboBox(dialog);
+    baseline->addItem("Previous scan", -1);
+    baseline->addItem("1 day ago", 1);
+    baseline->addItem("7 days ago", 7);
+    baseline->addItem("30 days ago", 30);
+    baseline->addItem("First scan", 0);
+
+    GrowthModel *model = new GrowthModel(dialog);
+    QTableView *view = new QTableView(dialog);
+    view->setModel(model);
+    view->horizontalHeader()->setSectionResizeMode(GrowthModel::PathColumn, QHeaderView::Stretch);
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(24);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setSortingEnabled(true);
+    view->sortByColumn(GrowthModel::PerDayColumn, Qt::DescendingOrder);
+
+    QLabel *summary = new QLabel(dialog);
+    auto update = [history, baseline, model, summary]() {
+        const QList<ScanHistory::Scan> &scans = history->scans();
+        const int to = static_cast<int>(scans.size()) - 1;
+        const int days = baseline->currentData().toInt();
+        int from = days < 0 ? to - 1 : days == 0 ? 0 : history->scanAt(scans.at(to).time - days * 86400LL);
+        from = qBound(0, from, qMax(0, to - 1));
+
+        const QList<ScanHistory::Change> changes = history->compare(from, to);
+        model->setChanges(changes);
+        int added = 0;
+        int vanished = 0;
+        for (const ScanHistory::Change &change : changes) {
+            if (change.status == ScanHistory::Status::New) ++added;
+            if (change.status == ScanHistory::Status::Vanished) ++vanished;
+        }
+        const ScanHistory::Scan &first = scans.at(from);
+        const ScanHistory::Scan &last = scans.at(to);
+        summary->setText(QString("%1 to %2 (%3 scans)  |  %4 to %5 (%6)  |  %7 new, %8 vanished")
+                             .arg(QLocale().toString(QDateTime::fromSecsSinceEpoch(first.time), QLocale::ShortFormat),
+                                  QLocale().toString(QDateTime::fromSecsSinceEpoch(last.time), QLocale::ShortFormat))
+                             .arg(to - from + 1)
+                             .arg(ResultsModel::formatSize(first.bytes), ResultsModel::formatSize(last.bytes),
+                                  GrowthModel::formatChange(qint64(last.bytes) - qint64(first.bytes)))
+                             .arg(added)
+                             .arg(vanished));
+    };
+    update();
+    connect(baseline, &QComboBox::currentIndexChanged, dialog, update);
+
+    QHBoxLayout *top = new QHBoxLayout();
+    top->addWidget(new QLabel("Compare the latest scan with:", dialog));
+    top->addWidget(baseline);
+    top->addStretch();
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    layout->addLayout(top);
+    layout->addWidget(summary);
+    layout->addWidget(view);
+    dialog->show();
+}
+
+void MainWindow::onScanProgress(const ScanProgress &snapshot) {
+    if (scanner && scanner->isPaused()) return; // a batch flushed on the way into the pause
+    statusLabel->setText(QString("Scanning: %1  |  %2 dirs (%3/s)  |  %4 found, %5")
+                             .arg(snapshot.currentPath)
+                             .arg(snapshot.dirsVisited)
+                             .arg(qRound64(snapshot.dirsPerSecond))
+                             .arg(snapshot.cachesFound)
+                             .arg(formatSize(snapshot.bytesFound)));
+}
+
+void MainWindow::onCacheFound(const QList<CacheFolderInfo> &batch) {
+    ScanMetrics::uiBatchDelivered();
+    // Paths already in the model (e.g. favorites added with 0 size) just get their size updated
+    QList<ResultsModel::Entry> entries;
+    entries.reserve(batch.size());
+    for (const CacheFolderInfo &info : batch) {
+        ResultsModel::Entry entry{info.pathId, info.sizeBytes, favManager->isFavorite(info.pathId)};
+        entry.reclaimableBytes = info.reclaimableBytes;
+        entry.tree = info.tree;
+        entry.lastModified = info.lastModified;
+        entry.lastAccessed = info.lastAccessed;
+        if (entry.isFavorite) favManager->updateSize(info.pathId, info.sizeBytes);
+        entries.append(entry);
+    }
+    resultsModel->upsert(entries);
+}
+
+void MainWindow::onDeviceStats(const QList<DeviceScanStats> &devices) {
+    scanDevices = devices;
+}
+
+void MainWindow::onPruneStats(const QList<PruneRuleStats> &rules) {
+    scanPruned = rules;
 }
 
 void MainWindow::onScanFinished() {
     isScanning = false;
     scanBtn->setText("Scan");
-    progressBar->setVisible(false);
-    statusLabel->setText("Scan complete.");
+    pauseBtn->setVisible(false);
+    updateBusyState();
+    statusLabel->setText(scanner && scanner->wasStopped() ? "Scan stopped. The next scan of this folder continues from here."
+                                                          : "Scan complete.");
+    // Hover the status text for what the scan cost
+    QString summary = ScanMetrics::summary(ScanMetrics::snapshot() - scanMetricsStart);
+    for (const DeviceScanStats &device : scanDevices) {
+        summary += QString("\n%1 (%2, %3): %4 dirs (%5/s), %6 workers max of %7")
+                       .arg(device.mountPoint, device.fsType, device.kind)
+                       .arg(device.dirs)
+                       .arg(qRound64(device.dirsPerSecond))
+                       .arg(device.peakConcurrency)
+                       .arg(device.concurrency);
+        if (device.skippedMounts > 0) summary += QString(", %1 mounts skipped").arg(device.skippedMounts);
+    }
+    for (const PruneRuleStats &rule : scanPruned) {
+        summary += QString("\nSkipped by %1: %2 folders").arg(rule.rule).arg(rule.dirs);
+    }
+    statusLabel->setToolTip(summary);
+    exportMetrics();
+
+    if (scanner && !scanner->wasStopped()) {
+        watchedRoot = pathInput->text();
+        updateWatching();
+    }
 }
 
-void MainWindow::addTableDataType(const QString &path, quint64 size, bool isFav) {
-    int row = resultsTable->rowCount();
-    resultsTable->insertRow(row);
-    
-    QTableWidgetItem *pathItem = new QTableWidgetItem(path);
-    pathItem->setFlags(pathItem->flags() ^ Qt::ItemIsEditable);
-    resultsTable->setItem(row, 0, pathItem);
-    
-    QTableWidgetItem *sizeItem = new QTableWidgetItem(formatSize(size));
-    sizeItem->setFlags(sizeItem->flags() ^ Qt::ItemIsEditable);
-    sizeItem->setData(Qt::UserRole, size); // Store raw bytes
-    resultsTable->setItem(row, 1, sizeItem);
-    
-    QTableWidgetItem *favItem = new QTableWidgetItem(isFav ? "★" : "☆");
-    favItem->setTextAlignment(Qt::AlignCenter);
-    favItem->setFlags(favItem->flags() ^ Qt::ItemIsEditable);
-    resultsTable->setItem(row, 2, favItem);
+void MainWindow::updateWatching() {
+    if (!watchCheck->isChecked() || watchedRoot.isEmpty() || !scanner) {
+        QMetaObject::invokeMethod(watcher, &CacheWatcher::stop, Qt::QueuedConnection);
+        watchLabel->clear();
+        return;
+    }
+
+    const QString root = watchedRoot;
+    const QString indexPath = incrementalCheck->isChecked() ? indexPathFor(root) : QString();
+    // Without the index these are all the watcher gets; favorites not in the list yet included
+    const QStringList caches = resultsModel->paths() + favManager->getFavorites().values();
+    const quint64 minSizeBytes = static_cast<quint64>(minSizeSpinBox->value()) * 1024ULL * 1024ULL;
+    // The same settings the scan of this root used
+    const QStringList patterns = scanner->cachePatterns();
+    const PruneRules rules(PruneRules::configuredRules(root));
+    const bool oneFileSystem = scanner->isOneFileSystem();
+    CacheWatcher *target = watcher;
+    QMetaObject::invokeMethod(watcher, [target, root, indexPath, caches, minSizeBytes, patterns, rules, oneFileSystem]() {
+        target->setCachePatterns(patterns);
+        target->setPruneRules(rules);
+        target->setOneFileSystem(oneFileSystem);
+        target->start(root, indexPath, caches, minSizeBytes);
+    }, Qt::QueuedConnection);
+    watchLabel->setText("Watching...");
+}
+
+void MainWindow::onCachesRemoved(const QStringList &paths) {
+    // Favorites stay listed even when their folder is gone for now
+    QStringList removed;
+    QList<ResultsModel::Entry> favorites;
+    for (const QString &path : paths) {
+        if (favManager->isFavorite(path)) {
+            favorites.append({PathStore::shared().intern(path), 0, true});
+        } else {
+            removed.append(path);
+        }
+    }
+    resultsModel->removePaths(removed);
+    resultsModel->upsert(favorites);
+}
+
+void MainWindow::onWatchStatus(int watchedDirs, int polledDirs) {
+    if (watchedRoot.isEmpty() || !watchCheck->isChecked()) return; // stale report from before a stop
+    watchLabel->setText(polledDirs > 0
+                            ? QString("Watching %1 folders, polling %2").arg(watchedDirs).arg(polledDirs)
+                            : QString("Watching %1 folders").arg(watchedDirs));
+}
+
+// One file per scanned root, named after a hash of its absolute path
+static QString rootStateName(const QString &rootPath) {
+    QByteArray key = QDir::cleanPath(QDir(rootPath).absolutePath()).toUtf8();
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex().left(16);
+}
+
+QString MainWindow::indexPathFor(const QString &rootPath) const {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/index/" + rootStateName(rootPath) + ".idx";
+}
+
+QString MainWindow::checkpointPathFor(const QString &rootPath) const {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/checkpoint/" + rootStateName(rootPath) + ".ckpt";
+}
+
+QString MainWindow::historyPathFor(const QString &rootPath) const {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history/" + rootStateName(rootPath) + ".hist";
+}
+
+void MainWindow::addFavoriteRows() {
+    // Stored sizes until a scan or the favorites sizer measures them again
+    const QHash<PathStore::Id, FavoriteInfo> favorites = favManager->getFavoriteInfos();
+    QList<ResultsModel::Entry> entries;
+    for (auto it = favorites.constBegin(); it != favorites.constEnd(); ++it) {
+        QFileInfo info(PathStore::shared().path(it.key()));
+        if (info.exists() && info.isDir()) {
+            ResultsModel::Entry entry{it.key(), it->sizeBytes, true};
+            entry.measuredAt = it->measuredAt;
+            entry.sizePending = favSizer->isRunning();
+            entries.append(entry);
+        }
+    }
+    resultsModel->upsert(entries);
+}
+
+void MainWindow::onFavoriteSized(const QString &path, quint64 sizeBytes) {
+    if (!favManager->isFavorite(path)) return; // unstarred while it was being measured
+
+    ResultsModel::Entry entry{PathStore::shared().intern(path), sizeBytes, true};
+    entry.measuredAt = QDateTime::currentDateTime();
+    favManager->updateSize(path, sizeBytes, entry.measuredAt);
+    resultsModel->upsert({entry});
 }
 
 QString MainWindow::formatSize(quint64 sizeBytes) {
-    if (sizeBytes < 1024) return QString::number(sizeBytes) + " B";
-    if (sizeBytes < 1024 * 1024) return QString::number(sizeBytes / 1024.0, 'f', 2) + " KB";
-    if (sizeBytes < 1024 * 1024 * 1024) return QString::number(sizeBytes / (1024.0 * 1024.0), 'f', 2) + " MB";
-    return QString::number(sizeBytes / (1024.0 * 1024.0 * 1024.0), 'f', 2) + " GB";
+    return ResultsModel::formatSize(sizeBytes);
 }
 
-void MainWindow::toggleFavorite(int row, int col) {
-    if (col != 2) return;
-    
-    QString path = resultsTable->item(row, 0)->text();
+void MainWindow::toggleFavorite(const QModelIndex &index) {
+    if (!index.isValid() || index.column() != ResultsModel::FavoriteColumn) return;
+
+    QString path = resultsModel->entryAt(index.row()).path();
     bool currentFav = favManager->isFavorite(path);
-    
+
     if (currentFav) {
         favManager->removeFavorite(path);
-        resultsTable->item(row, 2)->setText("☆");
     } else {
         favManager->addFavorite(path);
-        resultsTable->item(row, 2)->setText("★");
+        favManager->updateSize(path, resultsModel->entryAt(index.row()).sizeBytes);
+        if (watchCheck->isChecked() && !watchedRoot.isEmpty()) {
+            CacheWatcher *target = watcher;
+            QMetaObject::invokeMethod(watcher, [target, path]() { target->addCaches({path}); }, Qt::QueuedConnection);
+        }
     }
+    resultsModel->setFavorite(path, !currentFav);
 }
 
 void MainWindow::showContextMenu(const QPoint &pos) {
-    QTableWidgetItem *item = resultsTable->itemAt(pos);
-    if (!item) return;
+    QModelIndex index = resultsTable->indexAt(pos);
+    if (!index.isValid()) return;
+
+    QString path = resultsModel->entryAt(index.row()).path();
 
     QMenu menu(this);
     QAction *delAction = menu.addAction("Delete Folder");
     QAction *favAction = menu.addAction("Toggle Favorite");
+    QAction *exploreAction = menu.addAction("Explore Contents...");
+    exploreAction->setEnabled(resultsModel->entryAt(index.row()).tree != nullptr);
     
     QAction *selected = menu.exec(resultsTable->viewport()->mapToGlobal(pos));
     
-    int row = item->row();
-    QString path = resultsTable->item(row, 0)->text();
-    
-    if (selected == delAction) {
+    if (selected == exploreAction) {
+        exploreCache(path);
+    } else if (selected == delAction) {
         // Delete single
          if (QMessageBox::question(this, "Confirm", "Delete " + path + "?") == QMessageBox::Yes) {
-             QDir dir(path);
-             if (dir.removeRecursively()) {
-                 resultsTable->removeRow(row);
-             } else {
-                 QMessageBox::critical(this, "Error", "Failed to delete folder.");
-             }
+             startDeletion({path});
          }
     } else if (selected == favAction) {
-        toggleFavorite(row, 2);
+        toggleFavorite(index.siblingAtColumn(ResultsModel::FavoriteColumn));
     }
 }
 
+/*
+ * Non-modal drill-down into one cache's size tree. Parts of it are deleted through the
+ * same DeletionService as whole caches; each successful delete leaves the tree and the
+ * cache's row shows the new total.
+ */
+void MainWindow::exploreCache(const QString &path) {
+    const ResultsModel::Entry *entry = resultsModel->entryForPath(path);
+    if (!entry || !entry->tree) return;
+
+    QDialog *dialog = new QDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle("Explore - " + path);
+    dialog->resize(800, 500);
+
+    SizeTreeModel *model = new SizeTreeModel(entry->tree, dialog);
+    QTreeView *view = new QTreeView(dialog);
+    view->setModel(model);
+    view->setUniformRowHeights(true);
+    view->setContextMenuPolicy(Qt::CustomContextMenu);
+    view->header()->setStretchLastSection(false);
+    view->header()->setSectionResizeMode(SizeTreeModel::NameColumn, QHeaderView::Stretch);
+    view->expand(model->index(0, SizeTreeModel::NameColumn));
+
+    QLabel *summary = new QLabel(dialog);
+    auto updateSummary = [summary, model]() {
+        const SizeTree &tree = *model->tree();
+        summary->setText(QString("%1 in %2 entries%3  |  %4 in memory")
+                             .arg(ResultsModel::formatSize(tree.node(tree.root()).sizeBytes))
+                             .arg(tree.node(tree.root()).items - 1)
+                             .arg(tree.isComplete() ? QString() : QString(" (scan stopped, incomplete)"))
+                             .arg(ResultsModel::formatSize(tree.memoryBytes())));
+    };
+    updateSummary();
+
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    layout->addWidget(summary);
+    layout->addWidget(view);
+
+    connect(view, &QTreeView::customContextMenuRequested, dialog, [this, view, model](const QPoint &pos) {
+        const QModelIndex index = view->indexAt(pos);
+        if (!index.isValid()) return;
+
+        QMenu menu(view);
+        QAction *delAction = menu.addAction("Delete Folder");
+        delAction->setEnabled(model->isDirectory(index));
+        if (menu.exec(view->viewport()->mapToGlobal(pos)) != delAction) return;
+
+        const QString target = model->pathAt(index);
+        if (QMessageBox::question(this, "Confirm", "Delete " + target + "?") == QMessageBox::Yes) {
+            startDeletion({target});
+        }
+    });
+
+    // Runs after onPathDeleted(), which already dropped the row if the whole cache went
+    connect(deletionService, &DeletionService::pathFinished, dialog, [this, model, updateSummary](const DeletionResult &result) {
+        if (!result.success || !model->removePath(result.path)) return;
+        updateSummary();
+
+        const SizeTree &tree = *model->tree();
+        const ResultsModel::Entry *cache = resultsModel->entryForPath(tree.rootPath());
+        if (!cache) return;
+        ResultsModel::Entry updated = *cache;
+        updated.sizeBytes = tree.node(tree.root()).sizeBytes;
+        updated.reclaimableBytes = CacheFolderInfo::UnknownSize;
+        resultsModel->upsert({updated});
+    });
+
+    dialog->show();
+}
+
 void MainWindow::deleteSelected() {
-    QList<QTableWidgetItem *> selected = resultsTable->selectedItems();
+    QModelIndexList selected = resultsTable->selectionModel()->selectedRows();
     if (selected.isEmpty()) return;
 
-    QSet<int> rows;
-    for (auto *item : selected) rows.insert(item->row());
-    
     if (QMessageBox::warning(this, "Confirm Deletion", 
-                             QString("Are you sure you want to delete %1 folders?").arg(rows.size()), 
+                             QString("Are you sure you want to delete %1 folders?").arg(selected.size()), 
                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
         return;
     }
 
-    // Sort rows descending to remove correctly
-    QList<int> sortedRows = rows.values();
-    std::sort(sortedRows.begin(), sortedRows.end(), std::greater<int>());
-
-    for (int row : sortedRows) {
-        QString path = resultsTable->item(row, 0)->text();
-        QDir dir(path);
-        if (dir.exists()) {
-            if (!dir.removeRecursively()) {
-                statusLabel->setText("Failed to delete: " + path);
-            } else {
-                resultsTable->removeRow(row);
-            }
-        } else {
-             resultsTable->removeRow(row);
-        }
-    }
-    statusLabel->setText("Deletion complete.");
+    QStringList paths;
+    for (const QModelIndex &index : selected) paths.append(resultsModel->entryAt(index.row()).path());
+    startDeletion(paths);
 }
 
 void MainWindow::deleteAll() {
-    if (resultsTable->rowCount() == 0) return;
+    if (resultsModel->rowCount() == 0) return;
     
      if (QMessageBox::warning(this, "Confirm Deletion", 
                              "Are you sure you want to delete ALL found cache folders?", 
@@ -359,19 +778,143 @@ void MainWindow::deleteAll() {
         return;
     }
 
-    int rows = resultsTable->rowCount();
-    for (int i = rows - 1; i >= 0; i--) {
-        QString path = resultsTable->item(i, 0)->text();
-        QDir dir(path);
-        if (dir.exists()) {
-             if (dir.removeRecursively()) {
-                 resultsTable->removeRow(i);
-             }
-        } else {
-            resultsTable->removeRow(i);
+    // "All" means every row currently shown, so an active filter narrows it
+    startDeletion(resultsModel->visiblePaths());
+}
+
+/*
+ * Plans over the rows shown, like Delete All, that are on the scanned folder's disk:
+ * favorites are protected and a measured reclaimable size counts over the apparent
+ * one. The confirmed plan goes through startDeletion() like any other delete.
+ */
+void MainWindow::planReclaim() {
+    if (resultsModel->rowCount() == 0) return;
+
+    const QString root = QDir::fromNativeSeparators(pathInput->text().trimmed());
+    const QStorageInfo storage(root);
+    bool ok = false;
+    const double goalGb = QInputDialog::getDouble(this, "Free Space",
+                                                  QString("GB to free on %1 (%2 available now):")
+                                                      .arg(QDir::toNativeSeparators(storage.rootPath()),
+                                                           formatSize(static_cast<quint64>(qMax<qint64>(0, storage.bytesAvailable())))),
+                                                  10, 0.1, 1000000, 1, &ok);
+    if (!ok) return;
+    const quint64 goalBytes = static_cast<quint64>(goalGb * 1024 * 1024 * 1024);
+
+    const ReclaimPlanner::VolumeMap volumes;
+    const quint64 volume = volumes.volumeOf(root, true);
+    QList<ReclaimPlanner::Candidate> candidates;
+    for (int row = 0; row < resultsModel->rowCount(); ++row) {
+        const ResultsModel::Entry &entry = resultsModel->entryAt(row);
+        if (volumes.volumeOf(entry.path()) != volume) continue;
+        const quint64 bytes = entry.reclaimableBytes != CacheFolderInfo::UnknownSize ? entry.reclaimableBytes : entry.sizeBytes;
+        candidates.append({entry.pathId, bytes, entry.lastUsed(), entry.isFavorite});
+    }
+
+    const ReclaimPlanner::Plan plan = ReclaimPlanner().plan(candidates, goalBytes);
+    if (plan.items.isEmpty()) {
+        QMessageBox::information(this, "Free Space", "None of the caches shown on this disk can be deleted.");
+        return;
+    }
+
+    QStringList paths;
+    QString details;
+    for (const ReclaimPlanner::Item &item : plan.items) {
+        paths.append(PathStore::shared().path(item.pathId));
+        details += QString("%1  %2 (last used %3)\n")
+                       .arg(formatSize(item.bytes), QDir::toNativeSeparators(paths.last()), ResultsModel::formatAge(item.lastUsed));
+    }
+    QString text = plan.reachesGoal()
+        ? QString("Delete %1 folders to free %2?").arg(plan.items.size()).arg(formatSize(plan.plannedBytes))
+        : QString("The caches that may be deleted free only %1 of %2. Delete all %3 of them?")
+              .arg(formatSize(plan.plannedBytes), formatSize(goalBytes))
+              .arg(plan.items.size());
+    if (plan.protectedCount > 0) {
+        text += QString("\n%1 favorites (%2) are kept.").arg(plan.protectedCount).arg(formatSize(plan.protectedBytes));
+    }
+
+    QMessageBox confirm(QMessageBox::Warning, "Confirm Deletion", text, QMessageBox::Yes | QMessageBox::No, this);
+    confirm.setDetailedText(details);
+    if (confirm.exec() != QMessageBox::Yes) return;
+    startDeletion(paths);
+}
+
+void MainWindow::startDeletion(const QStringList &paths) {
+    if (paths.isEmpty()) return;
+
+    // Staged folders are gone from the user's point of view; the rest is deleted in place
+    QStringList inPlace = paths;
+    if (instantDeleteCheck->isChecked()) {
+        inPlace = stagingPurger->stage(paths);
+        QStringList staged;
+        for (const QString &path : paths) {
+            if (!inPlace.contains(path)) staged.append(path);
+        }
+        resultsModel->removePaths(staged);
+        if (!staged.isEmpty()) {
+            statusLabel->setText(QString("Moved %1 folders to staging, freeing space in the background.").arg(staged.size()));
+            onPurgeProgress(0, stagingPurger->pendingCount());
         }
+        if (inPlace.isEmpty()) return;
+    }
+
+    if (deletionService->isRunning()) {
+        QMessageBox::information(this, "Busy", "A deletion is already in progress.");
+        return;
+    }
+
+    for (const QString &path : inPlace) resultsModel->setError(path, QString());
+    statusLabel->setText(QString("Deleting %1 folders...").arg(inPlace.size()));
+    deletionService->start(inPlace);
+    updateBusyState();
+}
+
+void MainWindow::onDeletionProgress(quint64 bytesFreed, quint64 filesFreed) {
+    statusLabel->setText(QString("Deleting... %1 freed (%2 files)").arg(formatSize(bytesFreed)).arg(filesFreed));
+}
+
+void MainWindow::onPathDeleted(const DeletionResult &result) {
+    if (result.success) {
+        resultsModel->removePaths({result.path});
+    } else {
+        resultsModel->setError(result.path, result.error);
     }
-    statusLabel->setText("All deleted.");
+}
+
+void MainWindow::onDeletionFinished(bool cancelled) {
+    updateBusyState();
+    statusLabel->setText(cancelled ? "Deletion cancelled." : "Deletion complete.");
+    exportMetrics();
+}
+
+void MainWindow::onPurgeProgress(quint64 bytesFreed, int remaining) {
+    purgeLabel->setText(QString("Purging %1 staged folders, %2 freed").arg(remaining).arg(formatSize(bytesFreed)));
+    purgeLabel->setVisible(remaining > 0);
+}
+
+void MainWindow::onPurgeIdle() {
+    const int left = stagingPurger->pendingCount();
+    purgeLabel->setText(QString("%1 staged folders could not be purged").arg(left));
+    purgeLabel->setToolTip(left > 0 ? "They stay in the staging folder and are retried at the next start" : QString());
+    purgeLabel->setVisible(left > 0);
+}
+
+// Opt-in via environment so a scraper or a bug report can pick up process totals
+void MainWindow::exportMetrics() {
+    const QString path = qEnvironmentVariable("DFCACHE_METRICS_FILE");
+    if (path.isEmpty()) return;
+    if (!ScanMetrics::writeFile(path, ScanMetrics::snapshot())) {
+        qWarning() << "Failed to write metrics to" << path;
+    }
+}
+
+void MainWindow::updateBusyState() {
+    bool deleting = deletionService->isRunning();
+    progressBar->setVisible(isScanning || deleting);
+    deleteSelectedBtn->setEnabled(!deleting);
+    deleteAllBtn->setEnabled(!deleting);
+    freeSpaceBtn->setEnabled(!deleting);
+    cancelDeleteBtn->setVisible(deleting);
 }
 
 void MainWindow::updateFavoritesUI() {
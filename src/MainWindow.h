@@ -2,7 +2,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTableWidget>
+#include <QTableView>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QLabel>
@@ -10,9 +10,16 @@
 #include <QStatusBar>
 #include <QSystemTrayIcon>
 #include <QSpinBox>
+#include <QCheckBox>
 
 #include "CacheScanner.h"
+#include "CacheWatcher.h"
+#include "DeletionService.h"
 #include "FavoritesManager.h"
+#include "FavoritesSizer.h"
+#include "ResultsModel.h"
+#include "ScanMetrics.h"
+#include "StagingPurger.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -24,38 +31,85 @@ public:
 private slots:
     void browseFolder();
     void startScan();
-    void onScanProgress(const QString &path);
-    void onCacheFound(CacheFolderInfo info);
+    void togglePause();
+    void editPruneRules();
+    void showGrowth();
+    void onScanResumed(int pendingDirs, int caches);
+    void onScanProgress(const ScanProgress &snapshot);
+    void onCacheFound(const QList<CacheFolderInfo> &batch);
+    void onDeviceStats(const QList<DeviceScanStats> &devices);
+    void onPruneStats(const QList<PruneRuleStats> &rules);
     void onScanFinished();
+    void onCachesRemoved(const QStringList &paths);
+    void onFavoriteSized(const QString &path, quint64 sizeBytes);
+    void onWatchStatus(int watchedDirs, int polledDirs);
+    void updateWatching();
     
     void deleteSelected();
     void deleteAll();
-    void toggleFavorite(int row, int col);
+    void planReclaim();
+    void onDeletionProgress(quint64 bytesFreed, quint64 filesFreed);
+    void onPathDeleted(const DeletionResult &result);
+    void onDeletionFinished(bool cancelled);
+    void onPurgeProgress(quint64 bytesFreed, int remaining);
+    void onPurgeIdle();
+    void toggleFavorite(const QModelIndex &index);
     void showContextMenu(const QPoint &pos);
+    void exploreCache(const QString &path);
     
     void updateFavoritesUI();
 
 private:
     void setupUI();
     void setupStyle();
-    void addTableDataType(const QString &path, quint64 size, bool isFav);
+    void addFavoriteRows();
+    void startDeletion(const QStringList &paths);
+    void updateBusyState();
+    QString indexPathFor(const QString &rootPath) const;
+    QString checkpointPathFor(const QString &rootPath) const;
+    QString historyPathFor(const QString &rootPath) const;
     QString formatSize(quint64 sizeBytes);
+    void exportMetrics();
 
     // UI Elements
     QLineEdit *pathInput;
     QPushButton *browseBtn;
+    QPushButton *rulesBtn;
+    QPushButton *growthBtn;
     QPushButton *scanBtn;
-    QTableWidget *resultsTable;
+    QPushButton *pauseBtn;
+    QLineEdit *filterInput;
+    QTableView *resultsTable;
+    ResultsModel *resultsModel;
     QPushButton *deleteSelectedBtn;
     QPushButton *deleteAllBtn;
+    QPushButton *freeSpaceBtn;
+    QPushButton *cancelDeleteBtn;
+    QCheckBox *instantDeleteCheck;
     QSpinBox *minSizeSpinBox;
+    QCheckBox *incrementalCheck;
+    QCheckBox *reclaimCheck;
+    QCheckBox *oneFileSystemCheck;
+    QCheckBox *treeCheck;
+    QCheckBox *watchCheck;
     QProgressBar *progressBar;
     QLabel *statusLabel;
+    QLabel *watchLabel;
+    QLabel *purgeLabel;
 
     // Core
     CacheScanner *scanner;
+    DeletionService *deletionService;
+    StagingPurger *stagingPurger;
+    QThread *watcherThread;
+    CacheWatcher *watcher;
+    QString watchedRoot; // root of the last complete scan, empty when there is none
     FavoritesManager *favManager;
+    FavoritesSizer *favSizer;
     bool isScanning;
+    ScanMetrics::Snapshot scanMetricsStart;
+    QList<DeviceScanStats> scanDevices;
+    QList<PruneRuleStats> scanPruned;
     
     // Icons (cached textual or standard)
     // We will use unicode stars for simplicity if no icons resource
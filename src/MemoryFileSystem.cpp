@@ -0,0 +1,233 @@
+#include "MemoryFileSystem.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <algorithm>
+
+MemoryFileSystem::MemoryFileSystem(const QString &rootPath) : m_rootPath(QDir::cleanPath(rootPath)) {
+    m_prefix = m_rootPath.endsWith('/') ? m_rootPath : m_rootPath + '/';
+    const QByteArray name = QFileInfo(m_rootPath).fileName().toUtf8();
+    m_names.append(name.constData(), static_cast<size_t>(name.size()));
+    m_nodes.push_back({NoNode, 0, 0, static_cast<quint16>(name.size()), Type::Directory, 0, 0, 0, 0});
+    m_children.emplace_back();
+}
+
+bool MemoryFileSystem::addDirectory(const QString &path, qint64 modified) {
+    return addNode(path, Type::Directory, 0, modified, 0);
+}
+
+bool MemoryFileSystem::addFile(const QString &path, quint64 size, qint64 modified, qint64 accessed) {
+    return addNode(path, Type::File, size, modified, accessed);
+}
+
+bool MemoryFileSystem::addSymlink(const QString &path) {
+    return addNode(path, Type::Symlink, 0, 0, 0);
+}
+
+bool MemoryFileSystem::setDenied(const QString &path, bool denied) {
+    QWriteLocker locker(&m_lock);
+    Error error = Error::None;
+    const quint32 node = resolve(path, error, false);
+    if (node == NoNode || m_nodes[node].type != Type::Directory) return false;
+    if (denied) {
+        m_nodes[node].flags |= Denied;
+    } else {
+        m_nodes[node].flags &= ~Denied;
+    }
+    return true;
+}
+
+void MemoryFileSystem::setLatency(int microseconds, int jitterMicroseconds, quint32 seed) {
+    m_latencyUs.store(qMax(0, microseconds), std::memory_order_relaxed);
+    m_jitterUs.store(qMax(0, jitterMicroseconds), std::memory_order_relaxed);
+    m_seed.store(seed, std::memory_order_relaxed);
+}
+
+quint64 MemoryFileSystem::entryCount() const {
+    QReadLocker locker(&m_lock);
+    return m_entryCount;
+}
+
+quint64 MemoryFileSystem::memoryBytes() const {
+    QReadLocker locker(&m_lock);
+    quint64 bytes = m_nodes.capacity() * sizeof(Node) + m_names.capacity()
+                  + m_children.capacity() * sizeof(std::vector<quint32>);
+    for (const std::vector<quint32> &children : m_children) bytes += children.capacity() * sizeof(quint32);
+    return bytes;
+}
+
+FileSystem::Error MemoryFileSystem::list(const QString &path, QList<Entry> &entries) const {
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+    Error error = Error::None;
+    quint32 node = NoNode;
+    {
+        QReadLocker locker(&m_lock);
+        node = resolve(path, error);
+        if (node != NoNode) {
+            const Node &dir = m_nodes[node];
+            if (dir.type != Type::Directory) {
+                error = Error::NotDirectory;
+            } else if (dir.flags & Denied) {
+                error = Error::PermissionDenied;
+            } else {
+                const std::vector<quint32> &children = m_children[dir.children];
+                entries.reserve(entries.size() + static_cast<qsizetype>(children.size()));
+                for (quint32 child : children) entries.append(entryOf(child));
+            }
+        }
+    }
+    delay(node);
+    return error;
+}
+
+FileSystem::Error MemoryFileSystem::stat(const QString &path, Entry &entry) const {
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+    Error error = Error::None;
+    quint32 node = NoNode;
+    {
+        QReadLocker locker(&m_lock);
+        node = resolve(path, error);
+        if (node != NoNode) entry = entryOf(node);
+    }
+    delay(node);
+    return error;
+}
+
+// The node stays in the array, unreachable; its name and any child list are not reclaimed
+FileSystem::Error MemoryFileSystem::remove(const QString &path) {
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+    Error error = Error::None;
+    quint32 node = NoNode;
+    {
+        QWriteLocker locker(&m_lock);
+        node = resolve(path, error);
+        if (node == 0) {
+            error = Error::PermissionDenied; // the root
+        } else if (node != NoNode) {
+            Node &entry = m_nodes[node];
+            if (entry.type == Type::Directory && !m_children[entry.children].empty()) {
+                error = Error::NotEmpty;
+            } else {
+                std::vector<quint32> &siblings = m_children[m_nodes[entry.parent].children];
+                const std::string_view name = nameOf(node);
+                const auto it = std::lower_bound(siblings.begin(), siblings.end(), name,
+                                                 [this](quint32 child, std::string_view key) { return nameOf(child) < key; });
+                siblings.erase(it);
+                if (entry.type == Type::Directory) std::vector<quint32>().swap(m_children[entry.children]);
+                entry.parent = NoNode;
+                --m_entryCount;
+            }
+        }
+    }
+    delay(node);
+    return error;
+}
+
+std::string_view MemoryFileSystem::nameOf(quint32 node) const {
+    const Node &entry = m_nodes[node];
+    return std::string_view(m_names.data() + entry.nameOffset, entry.nameLength);
+}
+
+quint32 MemoryFileSystem::findChild(quint32 dir, std::string_view name) const {
+    const std::vector<quint32> &children = m_children[m_nodes[dir].children];
+    const auto it = std::lower_bound(children.begin(), children.end(), name,
+                                     [this](quint32 child, std::string_view key) { return nameOf(child) < key; });
+    return it != children.end() && nameOf(*it) == name ? *it : NoNode;
+}
+
+quint32 MemoryFileSystem::resolve(const QString &path, Error &error, bool checkDenied) const {
+    error = Error::None;
+    const QString clean = QDir::cleanPath(path);
+    if (clean == m_rootPath) return 0;
+    if (!clean.startsWith(m_prefix)) {
+        error = Error::NotFound;
+        return NoNode;
+    }
+
+    const QByteArray rest = QStringView(clean).mid(m_prefix.size()).toUtf8();
+    quint32 node = 0;
+    for (qsizetype begin = 0; begin < rest.size();) {
+        qsizetype end = rest.indexOf('/', begin);
+        if (end < 0) end = rest.size();
+
+        const Node &dir = m_nodes[node];
+        if (dir.type != Type::Directory) {
+            error = Error::NotDirectory; // symlinks are never followed
+            return NoNode;
+        }
+        if (checkDenied && (dir.flags & Denied)) {
+            error = Error::PermissionDenied;
+            return NoNode;
+        }
+        node = findChild(node, std::string_view(rest.constData() + begin, static_cast<size_t>(end - begin)));
+        if (node == NoNode) {
+            error = Error::NotFound;
+            return NoNode;
+        }
+        begin = end + 1;
+    }
+    return node;
+}
+
+FileSystem::Entry MemoryFileSystem::entryOf(quint32 node) const {
+    const Node &source = m_nodes[node];
+    const std::string_view name = nameOf(node);
+    Entry entry;
+    entry.name = QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()));
+    entry.type = source.type;
+    entry.size = source.size;
+    entry.modified = source.modified;
+    entry.accessed = source.accessed;
+    return entry;
+}
+
+bool MemoryFileSystem::addNode(const QString &path, Type type, quint64 size, qint64 modified, qint64 accessed) {
+    const QString clean = QDir::cleanPath(path);
+    const qsizetype slash = clean.lastIndexOf('/');
+    if (slash < 0) return false;
+    const QString parentPath = slash == 0 ? QStringLiteral("/") : clean.left(slash);
+    const QByteArray name = clean.mid(slash + 1).toUtf8();
+    if (name.isEmpty() || name.size() > 0xffff) return false;
+
+    QWriteLocker locker(&m_lock);
+    if (m_nodes.size() >= NoNode || m_names.size() + static_cast<size_t>(name.size()) > 0xffffffffULL) return false;
+    Error error = Error::None;
+    const quint32 parent = resolve(parentPath, error, false);
+    if (parent == NoNode || m_nodes[parent].type != Type::Directory) return false;
+
+    const std::string_view key(name.constData(), static_cast<size_t>(name.size()));
+    const std::vector<quint32> &siblings = m_children[m_nodes[parent].children];
+    const auto it = std::lower_bound(siblings.begin(), siblings.end(), key,
+                                     [this](quint32 child, std::string_view k) { return nameOf(child) < k; });
+    if (it != siblings.end() && nameOf(*it) == key) return false;
+    const auto position = it - siblings.begin();
+
+    const quint32 id = static_cast<quint32>(m_nodes.size());
+    Node node{parent, NoNode, static_cast<quint32>(m_names.size()), static_cast<quint16>(name.size()),
+              type, 0, size, modified, accessed};
+    m_names.append(key);
+    if (type == Type::Directory) {
+        node.children = static_cast<quint32>(m_children.size());
+        m_children.emplace_back(); // invalidates `siblings`
+    }
+    m_nodes.push_back(node);
+
+    std::vector<quint32> &children = m_children[m_nodes[parent].children];
+    children.insert(children.begin() + position, id);
+    ++m_entryCount;
+    return true;
+}
+
+// splitmix64 of the seed and the node, so a node always waits as long
+void MemoryFileSystem::delay(quint32 node) const {
+    const int latency = m_latencyUs.load(std::memory_order_relaxed);
+    const int jitter = m_jitterUs.load(std::memory_order_relaxed);
+    if (latency <= 0 && jitter <= 0) return;
+
+    quint64 x = ((quint64(m_seed.load(std::memory_order_relaxed)) << 32) | node) + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    const quint64 wait = quint64(latency) + (jitter > 0 ? x % quint64(jitter + 1) : 0);
+    if (wait > 0) QThread::usleep(static_cast<unsigned long>(wait));
+}
@@ -0,0 +1,92 @@
+#ifndef MEMORYFILESYSTEM_H
+#define MEMORYFILESYSTEM_H
+
+#include <QReadWriteLock>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FileSystem.h"
+
+/*
+ * A filesystem held in memory, for benchmarks and stress runs of the scanner,
+ * sizer and deletion that must not depend on a disk. The same calls always build
+ * the same tree, and an entry costs about 40 bytes plus its name, so trees of
+ * millions of entries fit.
+ *
+ * Every path lives below rootPath(), which exists from the start. Nodes sit in one
+ * array and are never reused; a directory's children are kept as a list of ids
+ * sorted by name, so resolving a path costs one binary search per component. Any
+ * number of list() and stat() calls run at once; adding and remove() are exclusive.
+ *
+ * Faults are injected per call:
+ *  - latency: every list(), stat() and remove() sleeps `latency` plus a jitter
+ *    derived from the seed and the node, outside the lock, like a device serving
+ *    requests in parallel;
+ *  - permissions: a denied directory fails list() and the removal of anything in
+ *    it, and every path through it, with PermissionDenied.
+ */
+class MemoryFileSystem : public FileSystem {
+public:
+    explicit MemoryFileSystem(const QString &rootPath = QStringLiteral("/memory"));
+
+    QString rootPath() const { return m_rootPath; }
+
+    // The parent must exist and the name must be free
+    bool addDirectory(const QString &path, qint64 modified = 0);
+    bool addFile(const QString &path, quint64 size, qint64 modified = 0, qint64 accessed = 0);
+    bool addSymlink(const QString &path);
+    bool setDenied(const QString &path, bool denied = true);
+
+    void setLatency(int microseconds, int jitterMicroseconds = 0, quint32 seed = 1);
+
+    quint64 entryCount() const;      // not counting the root or removed entries
+    quint64 memoryBytes() const;
+    quint64 callCount() const { return m_calls.load(std::memory_order_relaxed); }
+
+    Error list(const QString &path, QList<Entry> &entries) const override;
+    Error stat(const QString &path, Entry &entry) const override;
+    Error remove(const QString &path) override;
+
+private:
+    static constexpr quint32 NoNode = ~0u;
+    enum Flag : quint8 { Denied = 0x1 };
+
+    struct Node {
+        quint32 parent;
+        quint32 children;       // index into m_children for directories, NoNode otherwise
+        quint32 nameOffset;
+        quint16 nameLength;
+        Type type;
+        quint8 flags;
+        quint64 size;
+        qint64 modified;
+        qint64 accessed;
+    };
+
+    QString m_rootPath;
+    QString m_prefix;           // m_rootPath with a trailing slash
+    mutable QReadWriteLock m_lock;
+    std::vector<Node> m_nodes;
+    std::vector<std::vector<quint32>> m_children;
+    std::string m_names;
+    quint64 m_entryCount = 0;
+
+    std::atomic<int> m_latencyUs{0};
+    std::atomic<int> m_jitterUs{0};
+    std::atomic<quint32> m_seed{1};
+    mutable std::atomic<quint64> m_calls{0};
+
+    // Lock held by the callers of these
+    std::string_view nameOf(quint32 node) const;
+    quint32 findChild(quint32 dir, std::string_view name) const;
+    // Building ignores Denied, like the owner of a directory could
+    quint32 resolve(const QString &path, Error &error, bool checkDenied = true) const;
+    Entry entryOf(quint32 node) const;
+    bool addNode(const QString &path, Type type, quint64 size, qint64 modified, qint64 accessed);
+
+    void delay(quint32 node) const;
+};
+
+#endif // MEMORYFILESYSTEM_H
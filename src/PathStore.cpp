@@ -0,0 +1,134 @@
+#include "PathStore.h"
+#include <algorithm>
+
+namespace {
+
+quint64 childKey(PathStore::Id parent, quint32 name) {
+    return (static_cast<quint64>(parent) << 32) | name;
+}
+
+}
+
+PathStore::PathStore() {
+    m_nodes.append({NoPath, 0});
+}
+
+PathStore &PathStore::shared() {
+    static PathStore store;
+    return store;
+}
+
+// Lock held
+PathStore::Id PathStore::findChild(Id parent, const QString &name) const {
+    auto nameIt = m_nameIds.constFind(name);
+    if (nameIt == m_nameIds.constEnd()) return NoPath;
+    return m_children.value(childKey(parent, nameIt.value()), NoPath);
+}
+
+/*
+ * Most calls find the whole path already there (a favorite, a rescan) or all but
+ * the last component, so the walk is done under the read lock and only the rest
+ * is added under the write lock, re-checked since another worker may have won.
+ */
+PathStore::Id PathStore::intern(const QString &path) {
+    const QStringList parts = path.split('/');
+    Id id = NoPath;
+    qsizetype depth = 0;
+    {
+        QReadLocker locker(&m_lock);
+        for (; depth < parts.size(); ++depth) {
+            const Id child = findChild(id, parts[depth]);
+            if (child == NoPath) break;
+            id = child;
+        }
+    }
+    if (depth == parts.size()) return id;
+
+    QWriteLocker locker(&m_lock);
+    for (; depth < parts.size(); ++depth) {
+        const QString &part = parts[depth];
+        auto nameIt = m_nameIds.constFind(part);
+        if (nameIt == m_nameIds.constEnd()) {
+            nameIt = m_nameIds.insert(part, static_cast<quint32>(m_names.size()));
+            m_names.append(part);
+        }
+        const quint64 key = childKey(id, nameIt.value());
+        auto childIt = m_children.constFind(key);
+        if (childIt == m_children.constEnd()) {
+            const Id child = static_cast<Id>(m_nodes.size());
+            m_nodes.append({id, nameIt.value()});
+            childIt = m_children.insert(key, child);
+        }
+        id = childIt.value();
+    }
+    return id;
+}
+
+PathStore::Id PathStore::find(const QString &path) const {
+    const QStringList parts = path.split('/');
+    QReadLocker locker(&m_lock);
+    Id id = NoPath;
+    for (const QString &part : parts) {
+        id = findChild(id, part);
+        if (id == NoPath) break;
+    }
+    return id;
+}
+
+QList<PathStore::Id> PathStore::chain(Id id) const {
+    QList<Id> ids;
+    for (; id != NoPath && id < m_nodes.size(); id = m_nodes.at(id).parent) ids.append(id);
+    std::reverse(ids.begin(), ids.end());
+    return ids;
+}
+
+QString PathStore::path(Id id) const {
+    QReadLocker locker(&m_lock);
+    const QList<Id> ids = chain(id);
+    if (ids.isEmpty()) return QString();
+
+    qsizetype length = ids.size() - 1;
+    for (Id part : ids) length += m_names.at(m_nodes.at(part).name).size();
+    QString result;
+    result.reserve(length);
+    for (qsizetype i = 0; i < ids.size(); ++i) {
+        if (i > 0) result += QLatin1Char('/');
+        result += m_names.at(m_nodes.at(ids[i]).name);
+    }
+    return result;
+}
+
+QString PathStore::name(Id id) const {
+    QReadLocker locker(&m_lock);
+    return id != NoPath && id < m_nodes.size() ? m_names.at(m_nodes.at(id).name) : QString();
+}
+
+PathStore::Id PathStore::parent(Id id) const {
+    QReadLocker locker(&m_lock);
+    return id < m_nodes.size() ? m_nodes.at(id).parent : NoPath;
+}
+
+// Skips the shared prefix and compares the first differing components
+int PathStore::compare(Id a, Id b, Qt::CaseSensitivity cs) const {
+    if (a == b) return 0;
+    QReadLocker locker(&m_lock);
+    const QList<Id> left = chain(a);
+    const QList<Id> right = chain(b);
+    const qsizetype common = std::min(left.size(), right.size());
+    for (qsizetype i = 0; i < common; ++i) {
+        if (left[i] == right[i]) continue;
+        const int order = QString::compare(m_names.at(m_nodes.at(left[i]).name), m_names.at(m_nodes.at(right[i]).name), cs);
+        if (order != 0) return order;
+    }
+    return left.size() < right.size() ? -1 : left.size() > right.size() ? 1 : 0;
+}
+
+qsizetype PathStore::nodeCount() const {
+    QReadLocker locker(&m_lock);
+    return m_nodes.size() - 1;
+}
+
+qsizetype PathStore::nameCount() const {
+    QReadLocker locker(&m_lock);
+    return m_names.size();
+}
@@ -0,0 +1,59 @@
+#ifndef PATHSTORE_H
+#define PATHSTORE_H
+
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QString>
+
+/*
+ * Process-wide store of result paths, shared by the scanner, the results model and
+ * favorites so each of them holds a 4-byte id instead of a full UTF-16 path.
+ * Paths are kept as a parent-pointer tree: a node is (parent, name), 8 bytes, and
+ * every distinct component name ("node_modules", ".cache", ...) is stored once no
+ * matter how many directories carry it. Hundreds of thousands of caches below a few
+ * deep prefixes therefore cost little more than their last components.
+ *
+ * Splitting on '/' keeps empty parts, so path(intern(p)) == p for any p. Ids are
+ * never reused or freed; they stay valid for the life of the process. Lookups take
+ * a read lock and scanner workers intern concurrently.
+ */
+class PathStore {
+public:
+    using Id = quint32;
+    static constexpr Id NoPath = 0;
+
+    static PathStore &shared();
+
+    Id intern(const QString &path);
+    Id find(const QString &path) const; // NoPath when never interned
+
+    // Only for display or deletion; everything else should pass ids around
+    QString path(Id id) const;
+    QString name(Id id) const;
+    Id parent(Id id) const;
+
+    // Component-wise, like comparing the full paths with '/' sorting first
+    int compare(Id a, Id b, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+
+    qsizetype nodeCount() const;
+    qsizetype nameCount() const;
+
+private:
+    struct Node {
+        Id parent;
+        quint32 name; // index into m_names
+    };
+
+    mutable QReadWriteLock m_lock;
+    QList<Node> m_nodes;               // m_nodes[0] is the NoPath sentinel
+    QHash<quint64, Id> m_children;     // (parent << 32 | name) -> child
+    QList<QString> m_names;
+    QHash<QString, quint32> m_nameIds;
+
+    PathStore();
+    Id findChild(Id parent, const QString &name) const;
+    QList<Id> chain(Id id) const; // top-level node first; lock held
+};
+
+#endif // PATHSTORE_H
@@ -0,0 +1,208 @@
+#include "PruneRules.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+inline bool isGlob(QStringView text) {
+    return text.contains(u'*') || text.contains(u'?') || text.contains(u'[');
+}
+
+QString cleanRulePath(const QString &path) {
+    return QDir::cleanPath(QDir::fromNativeSeparators(path));
+}
+
+// "/" for a top-level directory's parent, empty above the root
+QString parentOf(const QString &path) {
+    const qsizetype sep = path.lastIndexOf(u'/');
+    if (sep < 0 || path == QLatin1String("/")) return QString();
+    return sep == 0 ? QStringLiteral("/") : path.left(sep);
+}
+
+// { "roots": { "*": [".git"], "/srv/data": ["/srv/data/datasets", "!/srv/data/datasets/x"] } }
+QJsonObject readConfig(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QJsonObject();
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+QString scopeOf(const QString &rootPath) {
+    return rootPath == QLatin1String("*") ? rootPath : cleanRulePath(rootPath);
+}
+
+}
+
+PruneRules::PruneRules(const QStringList &rules)
+    : m_rules(rules), m_counts(std::make_shared<std::vector<std::atomic<quint64>>>(static_cast<size_t>(rules.size()))) {
+    for (int i = 0; i < rules.size(); ++i) {
+        QString rule = rules[i].trimmed();
+        if (rule.isEmpty()) continue;
+
+        const bool include = rule.startsWith(u'!');
+        if (include) rule = rule.mid(1).trimmed();
+        const QString path = cleanRulePath(rule);
+
+        if (QDir::isAbsolutePath(path)) {
+            (include ? m_includePaths : m_excludePaths).insert(key(path), i);
+        } else if (include) {
+            qWarning() << "Ignoring include rule without an absolute path:" << rules[i];
+            continue;
+        } else if (rule.contains(u'/') || isGlob(rule)) {
+            m_hasTails |= rule.contains(u'/');
+            m_nameRules.push_back({CacheMatcher({rule}), i});
+        } else {
+            m_nameRules.push_back({CacheMatcher({QLatin1Char('=') + rule}), i});
+        }
+        ++m_active;
+    }
+    resolveIncludeAncestors();
+}
+
+QString PruneRules::key(const QString &path) {
+#ifdef Q_OS_WIN
+    return path.toCaseFolded();
+#else
+    return path;
+#endif
+}
+
+/*
+ * Every directory above an include path has to be opened to reach it. Those that an
+ * exclude rule covers, by their own path or name or by lying below such a directory,
+ * are only passed through: their other children stay pruned by the same rule.
+ */
+void PruneRules::resolveIncludeAncestors() {
+    for (auto it = m_includePaths.constBegin(); it != m_includePaths.constEnd(); ++it) {
+        QStringList chain;
+        for (QString dir = parentOf(it.key()); !dir.isEmpty(); dir = parentOf(dir)) chain.prepend(dir);
+
+        int region = NoRule;
+        for (const QString &dir : chain) {
+            if (m_includePaths.contains(dir)) {
+                region = NoRule;
+            } else if (m_excludePaths.contains(dir)) {
+                region = m_excludePaths.value(dir);
+            } else if (region == NoRule) {
+                region = nameRule(QStringView(dir).mid(dir.lastIndexOf(u'/') + 1), parentOf(dir));
+            }
+            // A directory above several includes ends up with the same region from each
+            m_includeAncestors.insert(dir, region);
+        }
+    }
+}
+
+int PruneRules::nameRule(QStringView name, QStringView parentPath) const {
+    for (const NameRule &rule : m_nameRules) {
+        if (rule.matcher.matches(name, parentPath)) return rule.rule;
+    }
+    return NoRule;
+}
+
+int PruneRules::check(const QString &path) const {
+    if (m_active == 0) return NoRule;
+
+    const QString pathKey = key(path);
+    if (m_includePaths.contains(pathKey)) return NoRule;
+    const bool ancestor = m_includeAncestors.contains(pathKey);
+
+    const qsizetype sep = path.lastIndexOf(u'/');
+    const QStringView parent = QStringView(path).left(sep <= 0 ? sep + 1 : sep);
+    const QStringView name = QStringView(path).mid(sep + 1);
+
+    int rule = m_excludePaths.value(pathKey, NoRule);
+    if (rule == NoRule && !m_includeAncestors.isEmpty()) rule = m_includeAncestors.value(key(parent.toString()), NoRule);
+    if (rule == NoRule) rule = nameRule(name, parent);
+    if (rule == NoRule || ancestor) return NoRule;
+
+    countPrune(rule);
+    return rule;
+}
+
+int PruneRules::checkName(QStringView name) const {
+    if (m_nameRules.empty()) return NoRule;
+    const int rule = nameRule(name, QStringView());
+    if (rule != NoRule) countPrune(rule);
+    return rule;
+}
+
+bool PruneRules::needsPathsBelow(const QString &root) const {
+    if (m_hasTails) return true;
+    const QString rootKey = key(root);
+    if (m_includeAncestors.contains(rootKey)) return true;
+
+    const QString prefix = rootKey.endsWith(u'/') ? rootKey : rootKey + u'/';
+    for (const QHash<QString, int> *paths : {&m_excludePaths, &m_includePaths}) {
+        for (auto it = paths->constBegin(); it != paths->constEnd(); ++it) {
+            if (it.key() == rootKey || it.key().startsWith(prefix)) return true;
+        }
+    }
+    return false;
+}
+
+void PruneRules::countPrune(int rule) const {
+    (*m_counts)[rule].fetch_add(1, std::memory_order_relaxed);
+}
+
+QList<quint64> PruneRules::pruneCounts() const {
+    QList<quint64> counts;
+    counts.reserve(static_cast<qsizetype>(m_counts->size()));
+    for (const std::atomic<quint64> &count : *m_counts) counts.append(count.load(std::memory_order_relaxed));
+    return counts;
+}
+
+QString PruneRules::configPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/prune-rules.json";
+}
+
+QStringList PruneRules::configuredRules(const QString &rootPath) {
+    const QJsonObject roots = readConfig(configPath()).value("roots").toObject();
+
+    const QString root = key(cleanRulePath(rootPath));
+    QStringList rules;
+    for (auto it = roots.constBegin(); it != roots.constEnd(); ++it) {
+        const QString scope = key(scopeOf(it.key()));
+        const bool applies = scope == QLatin1String("*") || root == scope
+                             || root.startsWith(scope.endsWith(u'/') ? scope : scope + u'/');
+        if (!applies) continue;
+        for (const QJsonValue &rule : it.value().toArray()) {
+            if (!rule.toString().trimmed().isEmpty()) rules.append(rule.toString().trimmed());
+        }
+    }
+    rules.removeDuplicates();
+    return rules;
+}
+
+QStringList PruneRules::storedRules(const QString &rootPath) {
+    QStringList rules;
+    for (const QJsonValue &rule : readConfig(configPath()).value("roots").toObject().value(scopeOf(rootPath)).toArray()) {
+        rules.append(rule.toString());
+    }
+    return rules;
+}
+
+bool PruneRules::saveConfiguredRules(const QString &rootPath, const QStringList &rules) {
+    QJsonObject document = readConfig(configPath());
+    QJsonObject roots = document.value("roots").toObject();
+    const QString scope = scopeOf(rootPath);
+    if (rules.isEmpty()) {
+        roots.remove(scope);
+    } else {
+        roots.insert(scope, QJsonArray::fromStringList(rules));
+    }
+    document.insert("roots", roots);
+
+    QDir().mkpath(QFileInfo(configPath()).absolutePath());
+    QSaveFile file(configPath());
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(document).toJson()) < 0 || !file.commit()) {
+        qWarning() << "Failed to save prune rules to" << configPath() << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef PRUNERULES_H
+#define PRUNERULES_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "CacheMatcher.h"
+
+/*
+ * Subtrees the scan and cache sizing skip without reading them, one rule per entry:
+ *
+ *   /srv/data/datasets      exclude this directory and everything below it
+ *   .git, *.zarr            exclude every directory with this name (exact or glob)
+ *   .git/objects            exclude by path tail, like CacheMatcher's tail patterns
+ *   !/srv/data/datasets/x   include: walk this directory even though a rule above
+ *                           excludes it; only its ancestors are opened to reach it
+ *
+ * Walks go top-down and never enter a pruned directory, so checking a directory
+ * only has to look at the directory itself: exclude and include paths are exact
+ * hash lookups, never prefix scans. The include ancestors that sit inside an
+ * excluded region are resolved when the rules are compiled, so check() needs no
+ * state from the walk. Names are case-insensitive; paths are on Windows only.
+ *
+ * Copies share their per-rule prune counters, which are safe to bump from every
+ * worker at once.
+ */
+class PruneRules {
+public:
+    static constexpr int NoRule = -1;
+
+    explicit PruneRules(const QStringList &rules = {});
+
+    bool isEmpty() const { return m_active == 0; }
+    const QStringList &rules() const { return m_rules; }
+
+    // Rule that prunes `path`, or NoRule to descend; counts the prune
+    int check(const QString &path) const;
+    // For walks that never build paths (see needsPathsBelow()); counts the prune
+    int checkName(QStringView name) const;
+    bool hasNameRules() const { return !m_nameRules.empty(); }
+    // Whether a walk of `root` has to build paths to honour every rule: tail rules, or
+    // path rules for `root` or below it. Otherwise names alone decide.
+    bool needsPathsBelow(const QString &root) const;
+
+    // Directories pruned by each rule so far, in rules() order
+    QList<quint64> pruneCounts() const;
+
+    // Rules from prune-rules.json in the app data folder: those under "*" and those of
+    // `rootPath` or any folder above it
+    static QString configPath();
+    static QStringList configuredRules(const QString &rootPath);
+    // Only those stored for exactly `rootPath` ("*" for every root)
+    static QStringList storedRules(const QString &rootPath);
+    // Replaces the rules stored for exactly `rootPath` ("*" for every root)
+    static bool saveConfiguredRules(const QString &rootPath, const QStringList &rules);
+
+private:
+    struct NameRule {
+        CacheMatcher matcher;
+        int rule;
+    };
+
+    QStringList m_rules;
+    int m_active = 0;
+    bool m_hasTails = false;
+    QHash<QString, int> m_excludePaths;     // path key -> rule
+    QHash<QString, int> m_includePaths;     // path key -> rule
+    QHash<QString, int> m_includeAncestors; // path key -> excluding rule, NoRule when not excluded
+    std::vector<NameRule> m_nameRules;
+    std::shared_ptr<std::vector<std::atomic<quint64>>> m_counts;
+
+    static QString key(const QString &path);
+    int nameRule(QStringView name, QStringView parentPath) const;
+    void countPrune(int rule) const;
+    void resolveIncludeAncestors();
+};
+
+#endif // PRUNERULES_H
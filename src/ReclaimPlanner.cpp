@@ -0,0 +1,151 @@
+#include "ReclaimPlanner.h"
+#include "DeviceScheduler.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <algorithm>
+#include <cmath>
+
+ReclaimPlanner::ReclaimPlanner(qint64 now) : m_now(now) {
+}
+
+double ReclaimPlanner::costOf(const Candidate &candidate) const {
+    const double ageDays = candidate.lastUsed > 0 ? qMax<qint64>(0, m_now - candidate.lastUsed) / 86400.0 : 0.0;
+    return 1.0 + m_rebuildWeight * std::exp2(-ageDays / qMax(m_halfLifeDays, 0.001));
+}
+
+ReclaimPlanner::Plan ReclaimPlanner::plan(const QList<Candidate> &candidates, quint64 goalBytes) const {
+    Plan plan;
+    plan.goalBytes = goalBytes;
+
+    QList<Item> pool;
+    for (const Candidate &candidate : candidates) {
+        if (candidate.bytes == 0) continue;
+        if (candidate.isProtected) {
+            ++plan.protectedCount;
+            plan.protectedBytes += candidate.bytes;
+            continue;
+        }
+        pool.append({candidate.pathId, candidate.bytes, candidate.lastUsed, costOf(candidate)});
+    }
+    if (goalBytes == 0 || pool.isEmpty()) return plan;
+
+    std::sort(pool.begin(), pool.end(), [](const Item &a, const Item &b) {
+        return double(a.bytes) / a.cost > double(b.bytes) / b.cost;
+    });
+
+    quint64 total = 0;
+    qsizetype taken = 0;
+    while (taken < pool.size() && total < goalBytes) total += pool[taken++].bytes;
+
+    if (total >= goalBytes) {
+        // The last one taken mostly closes a small gap, which a cheaper one may close too
+        const quint64 before = total - pool[taken - 1].bytes;
+        qsizetype last = taken - 1;
+        for (qsizetype i = taken; i < pool.size(); ++i) {
+            if (pool[i].bytes >= goalBytes - before && pool[i].cost < pool[last].cost) last = i;
+        }
+        std::swap(pool[taken - 1], pool[last]);
+        total = before + pool[taken - 1].bytes;
+
+        double setCost = 0;
+        for (qsizetype i = 0; i < taken; ++i) setCost += pool[i].cost;
+        qsizetype single = -1;
+        for (qsizetype i = 0; i < pool.size(); ++i) {
+            if (pool[i].bytes >= goalBytes && pool[i].cost < setCost && (single < 0 || pool[i].cost < pool[single].cost)) {
+                single = i;
+            }
+        }
+        if (single >= 0) {
+            std::swap(pool[0], pool[single]);
+            taken = 1;
+            total = pool[0].bytes;
+        }
+    }
+    pool.resize(taken);
+
+    std::sort(pool.begin(), pool.end(), [](const Item &a, const Item &b) {
+        return a.cost != b.cost ? a.cost > b.cost : a.bytes < b.bytes;
+    });
+    for (auto it = pool.begin(); it != pool.end();) {
+        if (total >= goalBytes && total - it->bytes >= goalBytes) {
+            total -= it->bytes;
+            it = pool.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::sort(pool.begin(), pool.end(), [](const Item &a, const Item &b) { return a.bytes > b.bytes; });
+    for (const Item &item : pool) plan.cost += item.cost;
+    plan.items = std::move(pool);
+    plan.plannedBytes = total;
+    return plan;
+}
+
+/*
+ * Volumes are keyed by st_dev ("major:minor" from mountinfo), so bind mounts of one
+ * filesystem share a volume while every tmpfs or overlay gets its own. Elsewhere a
+ * block device name identifies the volume, and anything else its mount point.
+ */
+ReclaimPlanner::VolumeMap::VolumeMap() {
+    QHash<QString, quint64> volumes;   // device key -> volume
+    QHash<QString, quint64> byMount;   // later mounts over the same point win
+    for (const DeviceScheduler::Mount &mount : DeviceScheduler::mountTable()) {
+#ifdef Q_OS_LINUX
+        const QString device = mount.id;
+#else
+        // A volume GUID on Windows, a /dev node elsewhere; tmpfs and the like have neither
+        const bool blockDevice = mount.id.startsWith(QLatin1String("/dev/")) || mount.id.startsWith(QLatin1String("\\\\?\\"));
+        const QString device = blockDevice ? mount.id : key(mount.mountPoint);
+#endif
+        const quint64 volume = volumes.value(device, volumes.size() + 1);
+        volumes.insert(device, volume);
+        byMount.insert(key(mount.mountPoint), volume);
+    }
+    for (auto it = byMount.constBegin(); it != byMount.constEnd(); ++it) m_mounts.append({it.key(), it.value()});
+    // The innermost mount holding a path is then the first that fits
+    std::sort(m_mounts.begin(), m_mounts.end(),
+              [](const auto &a, const auto &b) { return a.first.size() > b.first.size(); });
+}
+
+quint64 ReclaimPlanner::VolumeMap::volumeOf(const QString &path, bool resolveLink) const {
+    QString resolved;
+    if (resolveLink) {
+        resolved = QFileInfo(path).canonicalFilePath();
+    } else {
+        // A link further up would charge the cache to the volume holding the link
+        const QFileInfo info(path);
+        auto it = m_canonicalDirs.constFind(info.path());
+        if (it == m_canonicalDirs.constEnd()) {
+            it = m_canonicalDirs.insert(info.path(), QFileInfo(info.path()).canonicalFilePath());
+        }
+        if (!it->isEmpty()) resolved = info.fileName().isEmpty() ? *it : *it + u'/' + info.fileName();
+    }
+    if (resolved.isEmpty()) return 0; // gone
+
+    const QString pathKey = key(resolved);
+    for (const auto &[mountPoint, volume] : m_mounts) {
+        if (!pathKey.startsWith(mountPoint)) continue;
+        if (pathKey.size() == mountPoint.size() || mountPoint.endsWith(u'/') || pathKey.at(mountPoint.size()) == u'/') {
+            return volume;
+        }
+    }
+    return 0;
+}
+
+QString ReclaimPlanner::VolumeMap::key(const QString &path) {
+    const QString clean = QDir::cleanPath(QDir(QDir::fromNativeSeparators(path)).absolutePath());
+#ifdef Q_OS_WIN
+    return clean.toCaseFolded();
+#else
+    return clean;
+#endif
+}
+
+quint64 ReclaimPlanner::bytesUntilAvailable(const QString &path, quint64 availableBytes) {
+    const QStorageInfo storage(path);
+    if (!storage.isValid()) return 0;
+    const quint64 available = static_cast<quint64>(qMax<qint64>(0, storage.bytesAvailable()));
+    return availableBytes > available ? availableBytes - available : 0;
+}
@@ -0,0 +1,87 @@
+#ifndef RECLAIMPLANNER_H
+#define RECLAIMPLANNER_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <utility>
+
+#include "PathStore.h"
+
+/*
+ * Picks the caches to delete to free a given number of bytes.
+ *
+ * Every deletion costs one, plus the expected cost of the cache being rebuilt: the
+ * rebuild weight, halved for every half-life since the cache was last used (the
+ * newest modification or access the scan saw inside it; unknown counts as now). The
+ * plan is a cheap set whose bytes reach the goal, so few caches and old ones:
+ *  1. caches are taken by bytes per cost, best first, until the goal is reached;
+ *  2. the last one taken is swapped for the cheapest remaining cache that closes the
+ *     gap as well, and the whole set for the cheapest single cache that reaches the
+ *     goal alone, where that is cheaper;
+ *  3. caches the goal can do without are dropped again, most expensive first.
+ * Protected caches (favorites) and empty ones are never picked.
+ */
+class ReclaimPlanner {
+public:
+    struct Candidate {
+        PathStore::Id pathId = PathStore::NoPath;
+        quint64 bytes = 0;          // what deleting it frees
+        qint64 lastUsed = 0;        // seconds since the epoch, 0 = unknown
+        bool isProtected = false;
+    };
+
+    struct Item {
+        PathStore::Id pathId;
+        quint64 bytes;
+        qint64 lastUsed;
+        double cost;
+    };
+
+    struct Plan {
+        QList<Item> items;          // largest first
+        quint64 goalBytes = 0;
+        quint64 plannedBytes = 0;
+        double cost = 0;
+        int protectedCount = 0;     // candidates left out as protected
+        quint64 protectedBytes = 0;
+
+        bool reachesGoal() const { return plannedBytes >= goalBytes; }
+    };
+
+    explicit ReclaimPlanner(qint64 now = QDateTime::currentSecsSinceEpoch());
+
+    // Rebuild cost of a cache used just now, relative to one deletion (default 4)
+    void setRebuildWeight(double weight) { m_rebuildWeight = weight; }
+    // Days after which a cache's rebuild cost has halved (default 30)
+    void setHalfLifeDays(double days) { m_halfLifeDays = days; }
+
+    double costOf(const Candidate &candidate) const;
+    Plan plan(const QList<Candidate> &candidates, quint64 goalBytes) const;
+
+    // The mount table, read once, so planning for one volume costs few syscalls per cache
+    class VolumeMap {
+    public:
+        VolumeMap();
+        // Equal for paths on the same filesystem (bind mounts included); 0 when unknown.
+        // The parent directory is resolved, once per directory; the last component only
+        // with `resolveLink`, which scan results never need (the scan follows no links).
+        quint64 volumeOf(const QString &path, bool resolveLink = false) const;
+
+    private:
+        QList<std::pair<QString, quint64>> m_mounts; // mount point key -> volume, longest first
+        mutable QHash<QString, QString> m_canonicalDirs;
+        static QString key(const QString &path);
+    };
+
+    // Bytes still to free on the volume holding `path` until `availableBytes` are available
+    static quint64 bytesUntilAvailable(const QString &path, quint64 availableBytes);
+
+private:
+    qint64 m_now;
+    double m_rebuildWeight = 4.0;
+    double m_halfLifeDays = 30.0;
+};
+
+#endif // RECLAIMPLANNER_H
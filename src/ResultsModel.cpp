@@ -0,0 +1,384 @@
+#include "ResultsModel.h"
+#include <QBrush>
+#include <QDateTime>
+#include <QLocale>
+#include <algorithm>
+
+ResultsModel::ResultsModel(QObject *parent)
+    : QAbstractTableModel(parent), m_sortColumn(-1), m_sortOrder(Qt::AscendingOrder) {
+}
+
+int ResultsModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(m_visible.size());
+}
+
+int ResultsModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ResultsModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_visible.size()) return QVariant();
+    const Entry &entry = entryAt(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case PathColumn: return entry.path();
+        case SizeColumn: return formatSize(entry.sizeBytes);
+        case ReclaimableColumn:
+            return entry.reclaimableBytes == CacheFolderInfo::UnknownSize ? QStringLiteral("—") : formatSize(entry.reclaimableBytes);
+        case LastUsedColumn: return formatAge(entry.lastUsed());
+        case FavoriteColumn: return entry.isFavorite ? QStringLiteral("★") : QStringLiteral("☆");
+        }
+        break;
+    case Qt::TextAlignmentRole:
+        if (index.column() == FavoriteColumn) return int(Qt::AlignCenter);
+        break;
+    case Qt::ToolTipRole:
+        if (!entry.error.isEmpty()) return QStringLiteral("Delete failed: ") + entry.error;
+        if (index.column() == SizeColumn && entry.sizePending) {
+            return entry.measuredAt.isValid()
+                ? QStringLiteral("Measured %1, updating...").arg(QLocale().toString(entry.measuredAt, QLocale::ShortFormat))
+                : QStringLiteral("Not measured yet, measuring...");
+        }
+        if (index.column() == SizeColumn && entry.measuredAt.isValid()) {
+            return QStringLiteral("Measured %1").arg(QLocale().toString(entry.measuredAt, QLocale::ShortFormat));
+        }
+        if (index.column() == ReclaimableColumn) {
+            return QStringLiteral("Disk space a delete would free: allocated blocks, hardlinked files only when all their links are inside");
+        }
+        if (index.column() == LastUsedColumn && entry.lastUsed() > 0) {
+            auto format = [](qint64 seconds) {
+                return seconds > 0 ? QLocale().toString(QDateTime::fromSecsSinceEpoch(seconds), QLocale::ShortFormat)
+                                   : QStringLiteral("unknown");
+            };
+            return QStringLiteral("Last change inside: %1\nLast file read: %2")
+                .arg(format(entry.lastModified), format(entry.lastAccessed));
+        }
+        break;
+    case Qt::ForegroundRole:
+        if (!entry.error.isEmpty()) return QBrush(QColor(230, 90, 90));
+        if (index.column() == SizeColumn && entry.sizePending) return QBrush(QColor(140, 140, 140));
+        break;
+    case SizeBytesRole:
+        return entry.sizeBytes;
+    }
+    return QVariant();
+}
+
+QVariant ResultsModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case PathColumn: return QStringLiteral("Folder Path");
+    case SizeColumn: return QStringLiteral("Size");
+    case ReclaimableColumn: return QStringLiteral("Reclaimable");
+    case LastUsedColumn: return QStringLiteral("Last Used");
+    case FavoriteColumn: return QStringLiteral("Fav");
+    }
+    return QVariant();
+}
+
+QString ResultsModel::formatSize(quint64 sizeBytes) {
+    if (sizeBytes < 1024) return QString::number(sizeBytes) + " B";
+    if (sizeBytes < 1024 * 1024) return QString::number(sizeBytes / 1024.0, 'f', 2) + " KB";
+    if (sizeBytes < 1024 * 1024 * 1024) return QString::number(sizeBytes / (1024.0 * 1024.0), 'f', 2) + " MB";
+    return QString::number(sizeBytes / (1024.0 * 1024.0 * 1024.0), 'f', 2) + " GB";
+}
+
+QString ResultsModel::formatAge(qint64 secondsSinceEpoch) {
+    if (secondsSinceEpoch <= 0) return QStringLiteral("—");
+    const qint64 days = (QDateTime::currentSecsSinceEpoch() - secondsSinceEpoch) / 86400;
+    if (days < 1) return QStringLiteral("today");
+    if (days == 1) return QStringLiteral("1 day ago");
+    return QStringLiteral("%1 days ago").arg(days);
+}
+
+bool ResultsModel::accepts(const Entry &entry) const {
+    return m_filter.isEmpty() || entry.path().contains(m_filter, Qt::CaseInsensitive);
+}
+
+bool ResultsModel::lessThan(int a, int b) const {
+    const Entry &left = m_entries.at(a);
+    const Entry &right = m_entries.at(b);
+    switch (m_sortColumn) {
+    case SizeColumn:
+        return left.sizeBytes < right.sizeBytes;
+    case ReclaimableColumn:
+        // Unknown sorts below every measured size
+        if (left.reclaimableBytes == right.reclaimableBytes) return left.sizeBytes < right.sizeBytes;
+        if (right.reclaimableBytes == CacheFolderInfo::UnknownSize) return false;
+        return left.reclaimableBytes == CacheFolderInfo::UnknownSize || left.reclaimableBytes < right.reclaimableBytes;
+    case LastUsedColumn:
+        if (left.lastUsed() == right.lastUsed()) return left.sizeBytes < right.sizeBytes;
+        return left.lastUsed() < right.lastUsed();
+    case FavoriteColumn:
+        if (left.isFavorite != right.isFavorite) return !left.isFavorite;
+        return left.sizeBytes < right.sizeBytes;
+    default:
+        return PathStore::shared().compare(left.pathId, right.pathId, Qt::CaseInsensitive) < 0;
+    }
+}
+
+void ResultsModel::sortIndices(QList<int> &indices) const {
+    if (m_sortColumn < 0) return;
+    if (m_sortOrder == Qt::AscendingOrder) {
+        std::stable_sort(indices.begin(), indices.end(), [this](int a, int b) { return lessThan(a, b); });
+    } else {
+        std::stable_sort(indices.begin(), indices.end(), [this](int a, int b) { return lessThan(b, a); });
+    }
+}
+
+void ResultsModel::rebuildRowMap() {
+    m_rowOf.fill(-1, m_entries.size());
+    for (int row = 0; row < m_visible.size(); ++row) {
+        m_rowOf[m_visible[row]] = row;
+    }
+}
+
+/*
+ * Replaces the visible row order while keeping persistent indexes (selection,
+ * current item) attached to the same entries.
+ */
+void ResultsModel::applyLayout(QList<int> visible) {
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QList<int> oldEntries;
+    oldEntries.reserve(oldIndexes.size());
+    for (const QModelIndex &idx : oldIndexes) {
+        oldEntries.append(m_visible.value(idx.row(), -1));
+    }
+
+    m_visible = std::move(visible);
+    rebuildRowMap();
+
+    QModelIndexList newIndexes;
+    newIndexes.reserve(oldIndexes.size());
+    for (int i = 0; i < oldIndexes.size(); ++i) {
+        int entry = oldEntries[i];
+        int row = entry >= 0 ? m_rowOf.value(entry, -1) : -1;
+        newIndexes.append(row >= 0 ? index(row, oldIndexes[i].column()) : QModelIndex());
+    }
+    changePersistentIndexList(oldIndexes, newIndexes);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void ResultsModel::sort(int column, Qt::SortOrder order) {
+    m_sortColumn = column;
+    m_sortOrder = order;
+
+    QList<int> visible = m_visible;
+    sortIndices(visible);
+    applyLayout(std::move(visible));
+}
+
+void ResultsModel::clear() {
+    beginResetModel();
+    m_entries.clear();
+    m_index.clear();
+    m_visible.clear();
+    m_rowOf.clear();
+    endResetModel();
+}
+
+void ResultsModel::upsert(const QList<Entry> &entries) {
+    QList<int> added;
+    QList<int> moved; // visible entries whose sort key changed
+    const bool sortedByValue = m_sortColumn == SizeColumn || m_sortColumn == ReclaimableColumn
+                               || m_sortColumn == LastUsedColumn || m_sortColumn == FavoriteColumn;
+
+    for (const Entry &entry : entries) {
+        auto it = m_index.constFind(entry.pathId);
+        if (it != m_index.constEnd()) {
+            Entry &existing = m_entries[it.value()];
+            if (entry.sizePending && !existing.sizePending) continue;
+            // Updates that cannot measure reclaimable space (the watcher) keep it while the size holds
+            const quint64 reclaimable = entry.reclaimableBytes == CacheFolderInfo::UnknownSize && existing.sizeBytes == entry.sizeBytes
+                ? existing.reclaimableBytes : entry.reclaimableBytes;
+            if (entry.tree || existing.sizeBytes != entry.sizeBytes) existing.tree = entry.tree;
+            const qint64 modified = entry.lastModified > 0 ? entry.lastModified : existing.lastModified;
+            const qint64 accessed = entry.lastAccessed > 0 ? entry.lastAccessed : existing.lastAccessed;
+            if (existing.sizeBytes == entry.sizeBytes && existing.reclaimableBytes == reclaimable
+                && existing.isFavorite == entry.isFavorite && existing.measuredAt == entry.measuredAt
+                && existing.sizePending == entry.sizePending && existing.lastModified == modified
+                && existing.lastAccessed == accessed) continue;
+            existing.sizeBytes = entry.sizeBytes;
+            existing.reclaimableBytes = reclaimable;
+            existing.isFavorite = entry.isFavorite;
+            existing.measuredAt = entry.measuredAt;
+            existing.sizePending = entry.sizePending;
+            existing.lastModified = modified;
+            existing.lastAccessed = accessed;
+
+            int row = m_rowOf.at(it.value());
+            if (row >= 0) {
+                emit dataChanged(index(row, SizeColumn), index(row, FavoriteColumn));
+                if (sortedByValue) moved.append(it.value());
+            }
+            continue;
+        }
+
+        int entryIndex = static_cast<int>(m_entries.size());
+        m_entries.append(entry);
+        m_index.insert(entry.pathId, entryIndex);
+        m_rowOf.append(-1);
+        if (accepts(entry)) added.append(entryIndex);
+    }
+
+    if (added.isEmpty() && moved.isEmpty()) return;
+
+    if (m_sortColumn < 0) {
+        // Unsorted: plain append at the end of the view
+        const int first = static_cast<int>(m_visible.size());
+        beginInsertRows(QModelIndex(), first, first + static_cast<int>(added.size()) - 1);
+        for (int entryIndex : added) {
+            m_rowOf[entryIndex] = static_cast<int>(m_visible.size());
+            m_visible.append(entryIndex);
+        }
+        endInsertRows();
+        return;
+    }
+
+    // Sorted: take the changed rows out, then merge them back with the new ones in one pass
+    QList<int> kept;
+    if (moved.isEmpty()) {
+        kept = m_visible;
+    } else {
+        std::sort(moved.begin(), moved.end());
+        moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+        QList<int> rows;
+        rows.reserve(moved.size());
+        for (int entryIndex : moved) rows.append(m_rowOf.at(entryIndex));
+        std::sort(rows.begin(), rows.end());
+
+        kept.reserve(m_visible.size() - rows.size());
+        qsizetype next = 0;
+        for (qsizetype row = 0; row < m_visible.size(); ++row) {
+            if (next < rows.size() && rows[next] == row) {
+                ++next;
+                continue;
+            }
+            kept.append(m_visible[row]);
+        }
+        added += moved;
+    }
+
+    sortIndices(added);
+    QList<int> visible(kept.size() + added.size());
+    auto less = [this](int a, int b) {
+        return m_sortOrder == Qt::AscendingOrder ? lessThan(a, b) : lessThan(b, a);
+    };
+    std::merge(kept.cbegin(), kept.cend(), added.cbegin(), added.cend(), visible.begin(), less);
+    applyLayout(std::move(visible));
+}
+
+void ResultsModel::removePaths(const QStringList &paths) {
+    QList<int> entryIndexes;
+    QList<int> rows;
+    for (const QString &path : paths) {
+        const int entryIndex = entryIndexOf(path);
+        if (entryIndex < 0) continue;
+        entryIndexes.append(entryIndex);
+        if (m_rowOf.at(entryIndex) >= 0) rows.append(m_rowOf.at(entryIndex));
+    }
+    if (entryIndexes.isEmpty()) return;
+
+    // Remove visible rows as contiguous ranges, bottom-up
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    for (int i = 0; i < rows.size();) {
+        int last = rows[i];
+        int first = last;
+        while (i + 1 < rows.size() && rows[i + 1] == first - 1) {
+            first = rows[++i];
+        }
+        ++i;
+        beginRemoveRows(QModelIndex(), first, last);
+        m_visible.remove(first, last - first + 1);
+        endRemoveRows();
+    }
+    rebuildRowMap();
+
+    // Swap-remove entries, highest index first so a moved entry is never one still to be removed
+    std::sort(entryIndexes.begin(), entryIndexes.end(), std::greater<int>());
+    entryIndexes.erase(std::unique(entryIndexes.begin(), entryIndexes.end()), entryIndexes.end());
+    for (int entryIndex : entryIndexes) {
+        m_index.remove(m_entries.at(entryIndex).pathId);
+        const int last = static_cast<int>(m_entries.size()) - 1;
+        if (entryIndex != last) {
+            m_entries[entryIndex] = std::move(m_entries[last]);
+            m_index[m_entries[entryIndex].pathId] = entryIndex;
+            m_rowOf[entryIndex] = m_rowOf[last];
+            if (m_rowOf[entryIndex] >= 0) m_visible[m_rowOf[entryIndex]] = entryIndex;
+        }
+        m_entries.removeLast();
+        m_rowOf.removeLast();
+    }
+}
+
+int ResultsModel::entryIndexOf(const QString &path) const {
+    const PathStore::Id id = PathStore::shared().find(path);
+    return id == PathStore::NoPath ? -1 : m_index.value(id, -1);
+}
+
+void ResultsModel::setFavorite(const QString &path, bool isFavorite) {
+    const int entryIndex = entryIndexOf(path);
+    if (entryIndex < 0) return;
+
+    Entry entry = m_entries.at(entryIndex);
+    entry.isFavorite = isFavorite;
+    upsert({entry});
+}
+
+void ResultsModel::setError(const QString &path, const QString &error) {
+    const int entryIndex = entryIndexOf(path);
+    if (entryIndex < 0) return;
+
+    m_entries[entryIndex].error = error;
+    int row = m_rowOf.at(entryIndex);
+    if (row >= 0) emit dataChanged(index(row, PathColumn), index(row, FavoriteColumn));
+}
+
+void ResultsModel::setFilterText(const QString &text) {
+    if (text == m_filter) return;
+
+    beginResetModel();
+    m_filter = text;
+    m_visible.clear();
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (accepts(m_entries.at(i))) m_visible.append(i);
+    }
+    sortIndices(m_visible);
+    rebuildRowMap();
+    endResetModel();
+}
+
+int ResultsModel::rowForPath(const QString &path) const {
+    const int entryIndex = entryIndexOf(path);
+    return entryIndex < 0 ? -1 : m_rowOf.at(entryIndex);
+}
+
+const ResultsModel::Entry *ResultsModel::entryForPath(const QString &path) const {
+    const int entryIndex = entryIndexOf(path);
+    return entryIndex < 0 ? nullptr : &m_entries.at(entryIndex);
+}
+
+QStringList ResultsModel::paths() const {
+    QStringList paths;
+    paths.reserve(m_entries.size());
+    for (const Entry &entry : m_entries) {
+        paths.append(entry.path());
+    }
+    return paths;
+}
+
+QStringList ResultsModel::visiblePaths() const {
+    QStringList paths;
+    paths.reserve(m_visible.size());
+    for (int entryIndex : m_visible) {
+        paths.append(m_entries.at(entryIndex).path());
+    }
+    return paths;
+}
@@ -0,0 +1,91 @@
+#ifndef RESULTSMODEL_H
+#define RESULTSMODEL_H
+
+#include <QAbstractTableModel>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "ScanTypes.h"
+
+/*
+ * Table model for scan results.
+ * Rows live in one contiguous list; a hash maps path id -> entry so de-duplication
+ * and lookups are O(1). Sorting and filtering only reorder a separate list of entry
+ * indices (the visible rows), so the entries themselves never move around.
+ * Entries hold PathStore ids; full paths are only built for display and filtering.
+ */
+class ResultsModel : public QAbstractTableModel {
+    Q_OBJECT
+public:
+    enum Column { PathColumn = 0, SizeColumn, ReclaimableColumn, LastUsedColumn, FavoriteColumn, ColumnCount };
+    static constexpr int SizeBytesRole = Qt::UserRole;
+
+    struct Entry {
+        PathStore::Id pathId = PathStore::NoPath;
+        quint64 sizeBytes = 0;
+        bool isFavorite = false;
+        QString error; // last failed delete, shown as tooltip
+        quint64 reclaimableBytes = CacheFolderInfo::UnknownSize;
+        QDateTime measuredAt;     // favorites: when sizeBytes was measured, invalid for scan results
+        bool sizePending = false; // a stored size shown while it is being re-measured
+        std::shared_ptr<SizeTree> tree; // with size trees enabled, see SizeTreeModel
+        qint64 lastModified = 0;  // see CacheFolderInfo, 0 = unknown
+        qint64 lastAccessed = 0;
+
+        QString path() const { return PathStore::shared().path(pathId); }
+        qint64 lastUsed() const { return qMax(lastModified, lastAccessed); }
+    };
+
+    explicit ResultsModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    void clear();
+    // Inserts new paths, updates sizes/favorite of known ones; an unknown reclaimable
+    // size does not overwrite a measured one unless the apparent size changed, and a
+    // pending stored size never replaces a current one; a size tree is kept the same way
+    // as the reclaimable size, and unknown times keep the known ones
+    void upsert(const QList<Entry> &entries);
+    void removePaths(const QStringList &paths);
+    void setFavorite(const QString &path, bool isFavorite);
+    void setError(const QString &path, const QString &error);
+    void setFilterText(const QString &text);
+
+    bool contains(const QString &path) const { return m_index.contains(PathStore::shared().find(path)); }
+    int rowForPath(const QString &path) const; // -1 when unknown or filtered out
+    const Entry *entryForPath(const QString &path) const; // null when unknown, filtered or not
+    const Entry &entryAt(int row) const { return m_entries.at(m_visible.at(row)); }
+    QStringList visiblePaths() const;
+    QStringList paths() const; // every entry, filtered out or not
+    int totalCount() const { return static_cast<int>(m_entries.size()); }
+
+    static QString formatSize(quint64 sizeBytes);
+    // "today", "3 days ago", ...; a dash for 0
+    static QString formatAge(qint64 secondsSinceEpoch);
+
+private:
+    QList<Entry> m_entries;
+    QHash<PathStore::Id, int> m_index; // path -> entry index
+    QList<int> m_visible;         // view row -> entry index
+    QList<int> m_rowOf;           // entry index -> view row, -1 when filtered out
+
+    int m_sortColumn;
+    Qt::SortOrder m_sortOrder;
+    QString m_filter;
+
+    bool accepts(const Entry &entry) const;
+    bool lessThan(int a, int b) const;
+    void sortIndices(QList<int> &indices) const;
+    void applyLayout(QList<int> visible);
+    void rebuildRowMap();
+    int entryIndexOf(const QString &path) const; // -1 when unknown
+};
+
+#endif // RESULTSMODEL_H
@@ -0,0 +1,66 @@
+#include "ScanBatcher.h"
+
+ScanBatcher::ScanBatcher(int intervalMs, int maxBatchSize)
+    : m_intervalNs(static_cast<qint64>(intervalMs) * 1000000), m_maxBatchSize(maxBatchSize),
+      m_nextFlushNs(0), m_dirsVisited(0), m_cachesFound(0), m_bytesFound(0), m_pendingCount(0),
+      m_lastDirs(0), m_lastFlushNs(0) {
+}
+
+void ScanBatcher::start() {
+    QMutexLocker locker(&m_mutex);
+    m_pending.clear();
+    m_dirsVisited = 0;
+    m_cachesFound = 0;
+    m_bytesFound = 0;
+    m_pendingCount = 0;
+    m_lastDirs = 0;
+    m_lastFlushNs = 0;
+    m_timer.start();
+    m_nextFlushNs = m_intervalNs;
+}
+
+void ScanBatcher::directoryVisited() {
+    m_dirsVisited.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ScanBatcher::cacheFound(const CacheFolderInfo &info) {
+    m_cachesFound.fetch_add(1, std::memory_order_relaxed);
+    m_bytesFound.fetch_add(info.sizeBytes, std::memory_order_relaxed);
+
+    QMutexLocker locker(&m_mutex);
+    m_pending.append(info);
+    m_pendingCount = static_cast<int>(m_pending.size());
+}
+
+bool ScanBatcher::takeBatch(const QString &currentPath, ScanProgress &snapshot, QList<CacheFolderInfo> &found, bool force) {
+    const qint64 now = m_timer.nsecsElapsed();
+    qint64 deadline = m_nextFlushNs.load(std::memory_order_relaxed);
+
+    if (!force) {
+        bool batchFull = m_pendingCount.load(std::memory_order_relaxed) >= m_maxBatchSize;
+        if (now < deadline && !batchFull) return false;
+        // Another thread may be flushing the same interval; only the CAS winner emits
+        if (!m_nextFlushNs.compare_exchange_strong(deadline, now + m_intervalNs)) return false;
+    } else {
+        m_nextFlushNs = now + m_intervalNs;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    found.swap(m_pending);
+    m_pending.clear();
+    m_pendingCount = 0;
+
+    const quint64 dirs = m_dirsVisited.load(std::memory_order_relaxed);
+    const qint64 spanNs = now - m_lastFlushNs;
+
+    snapshot.currentPath = currentPath;
+    snapshot.dirsVisited = dirs;
+    snapshot.dirsPerSecond = spanNs > 0 ? (dirs - m_lastDirs) * 1e9 / spanNs : 0.0;
+    snapshot.cachesFound = m_cachesFound.load(std::memory_order_relaxed);
+    snapshot.bytesFound = m_bytesFound.load(std::memory_order_relaxed);
+    snapshot.elapsedMs = now / 1000000;
+
+    m_lastDirs = dirs;
+    m_lastFlushNs = now;
+    return true;
+}
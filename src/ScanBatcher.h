@@ -0,0 +1,47 @@
+#ifndef SCANBATCHER_H
+#define SCANBATCHER_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <atomic>
+
+#include "ScanTypes.h"
+
+/*
+ * Collects per-directory events from any number of scanner threads and turns them
+ * into rate-limited batches: one progress snapshot and one vector of found caches
+ * per flush interval (or earlier if too many caches pile up).
+ * Recording is lock-free for directories; only found caches take a short lock.
+ * Exactly one thread wins each flush, so signals are never emitted concurrently
+ * for the same interval.
+ */
+class ScanBatcher {
+public:
+    explicit ScanBatcher(int intervalMs = 100, int maxBatchSize = 256);
+
+    void start();
+    void directoryVisited();
+    void cacheFound(const CacheFolderInfo &info);
+
+    // Returns true when the caller must emit the snapshot and batch it got back.
+    bool takeBatch(const QString &currentPath, ScanProgress &snapshot, QList<CacheFolderInfo> &found, bool force = false);
+
+private:
+    const qint64 m_intervalNs;
+    const int m_maxBatchSize;
+
+    QElapsedTimer m_timer;
+    std::atomic<qint64> m_nextFlushNs;
+    std::atomic<quint64> m_dirsVisited;
+    std::atomic<quint64> m_cachesFound;
+    std::atomic<quint64> m_bytesFound;
+    std::atomic<int> m_pendingCount;
+
+    QMutex m_mutex;
+    QList<CacheFolderInfo> m_pending;
+    quint64 m_lastDirs;
+    qint64 m_lastFlushNs;
+};
+
+#endif // SCANBATCHER_H
@@ -0,0 +1,420 @@
+#include "ScanHistory.h"
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char kHistoryMagic[4] = {'D', 'F', 'S', 'H'};
+constexpr quint32 kHistoryVersion = 1;
+constexpr quint32 kFrameMagic = 0x4d524653; // "SFRM"
+constexpr quint32 kFullFrame = 0x1;
+
+struct FileHeader {
+    char magic[4];
+    quint32 version;
+};
+
+struct FrameHeader {
+    quint32 magic;
+    quint32 flags;
+    qint64 time;
+    quint64 totalBytes;
+    quint32 cacheCount;
+    quint32 nameCount;
+    quint32 namesSize;
+    quint32 payloadSize;
+    quint32 checksum;   // qChecksum of names and payload
+    quint32 reserved;
+};
+
+void appendVarint(QByteArray &out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+bool readVarint(const uchar *&pos, const uchar *end, quint64 &value) {
+    value = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7) {
+        const uchar byte = *pos++;
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+quint32 checksumOf(const uchar *data, qint64 size) {
+    return qChecksum(QByteArrayView(reinterpret_cast<const char *>(data), size));
+}
+
+}
+
+ScanHistory::~ScanHistory() {
+    close();
+}
+
+bool ScanHistory::open(const QString &filePath) {
+    close();
+    m_filePath = filePath;
+    return index();
+}
+
+void ScanHistory::close() {
+    m_data = nullptr;
+    if (m_file.isOpen()) m_file.close(); // also unmaps
+    m_filePath.clear();
+    m_error.clear();
+    m_startOver = false;
+    m_validEnd = 0;
+    m_scans.clear();
+    m_frames.clear();
+    m_paths.clear();
+    m_ids.clear();
+}
+
+bool ScanHistory::index() {
+    m_data = nullptr;
+    if (m_file.isOpen()) m_file.close();
+    m_error.clear();
+    m_startOver = false;
+    m_validEnd = 0;
+    m_scans.clear();
+    m_frames.clear();
+    m_paths.clear();
+    m_ids.clear();
+
+    m_file.setFileName(m_filePath);
+    if (!m_file.exists()) return true;
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    const qint64 size = m_file.size();
+    if (size < static_cast<qint64>(sizeof(FileHeader))) {
+        m_file.close();
+        if (size == 0) return true;
+        m_error = QStringLiteral("Truncated file header");
+        m_startOver = true;
+        return false;
+    }
+    m_data = m_file.map(0, size);
+    if (!m_data) {
+        m_error = m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, m_data, sizeof(header));
+    if (std::memcmp(header.magic, kHistoryMagic, 4) != 0 || header.version != kHistoryVersion) {
+        m_data = nullptr;
+        m_file.close();
+        m_error = QStringLiteral("Not a scan history of this version");
+        m_startOver = true;
+        return false;
+    }
+
+    qint64 pos = sizeof(FileHeader);
+    m_validEnd = pos;
+    while (pos + static_cast<qint64>(sizeof(FrameHeader)) <= size) {
+        FrameHeader frame;
+        std::memcpy(&frame, m_data + pos, sizeof(frame));
+        const qint64 namesAt = pos + static_cast<qint64>(sizeof(FrameHeader));
+        const qint64 end = namesAt + qint64(frame.namesSize) + frame.payloadSize;
+        if (frame.magic != kFrameMagic || end > size || checksumOf(m_data + namesAt, end - namesAt) != frame.checksum) break;
+        // Only the first frame may lack a predecessor to apply a delta to
+        if (m_frames.isEmpty() && !(frame.flags & kFullFrame)) break;
+
+        const uchar *name = m_data + namesAt;
+        const uchar *namesEnd = name + frame.namesSize;
+        QStringList names;
+        for (quint32 i = 0; i < frame.nameCount; ++i) {
+            quint64 length = 0;
+            if (!readVarint(name, namesEnd, length) || length > quint64(namesEnd - name)) break;
+            names.append(QString::fromUtf8(reinterpret_cast<const char *>(name), static_cast<qsizetype>(length)));
+            name += length;
+        }
+        if (names.size() != qsizetype(frame.nameCount)) break;
+
+        for (const QString &path : std::as_const(names)) {
+            m_ids.insert(path, static_cast<quint32>(m_paths.size()));
+            m_paths.append(path);
+        }
+        m_scans.append({frame.time, frame.cacheCount, frame.totalBytes});
+        m_frames.append({namesAt + frame.namesSize, frame.payloadSize, (frame.flags & kFullFrame) != 0});
+        pos = end;
+        m_validEnd = pos;
+    }
+    return true;
+}
+
+int ScanHistory::scanAt(qint64 time) const {
+    if (m_scans.isEmpty()) return -1;
+    const auto it = std::upper_bound(m_scans.cbegin(), m_scans.cend(), time,
+                                     [](qint64 t, const Scan &scan) { return t < scan.time; });
+    return it == m_scans.cbegin() ? 0 : static_cast<int>(it - m_scans.cbegin()) - 1;
+}
+
+// Listed caches go to `visit`, in id order; a delta frame's removed ones then to `remove`
+template <typename Visit, typename Remove>
+bool ScanHistory::decode(int frame, Visit visit, Remove remove) const {
+    const Frame &entry = m_frames.at(frame);
+    const uchar *pos = m_data + entry.payloadOffset;
+    const uchar *end = pos + entry.payloadSize;
+    const quint64 seriesCount = static_cast<quint64>(m_paths.size());
+
+    quint64 count = 0;
+    if (!readVarint(pos, end, count)) return false;
+    quint64 id = 0;
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 delta = 0;
+        quint64 size = 0;
+        if (!readVarint(pos, end, delta) || !readVarint(pos, end, size)) return false;
+        id += delta;
+        if (id >= seriesCount) return false;
+        visit(static_cast<quint32>(id), size);
+    }
+    if (entry.full) return true;
+
+    if (!readVarint(pos, end, count)) return false;
+    id = 0;
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 delta = 0;
+        if (!readVarint(pos, end, delta)) return false;
+        id += delta;
+        if (id >= seriesCount) return false;
+        remove(static_cast<quint32>(id));
+    }
+    return true;
+}
+
+// From the nearest full frame at or before `frame`
+bool ScanHistory::stateAt(int frame, std::vector<quint64> &sizes) const {
+    sizes.assign(static_cast<size_t>(m_paths.size()), Absent);
+    int first = frame;
+    while (first > 0 && !m_frames.at(first).full) --first;
+    for (int f = first; f <= frame; ++f) {
+        if (!decode(f, [&](quint32 id, quint64 size) { sizes[id] = size; }, [&](quint32 id) { sizes[id] = Absent; })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Replays the frames from `from` to `to` once. A cache's size only changes where a
+ * frame lists it, so each run of scans with the same size is added to the cache's
+ * fit in one step, from prefix sums of the scan times: the cost is the number of
+ * changes, not scans times caches.
+ */
+QList<ScanHistory::Change> ScanHistory::compare(int from, int to) const {
+    QList<Change> changes;
+    if (from < 0 || to >= m_scans.size() || from > to) return changes;
+
+    std::vector<quint64> sizes;
+    if (!stateAt(from, sizes)) return changes;
+    const std::vector<quint64> before = sizes;
+
+    // In days since `from`
+    const int count = to - from + 1;
+    std::vector<double> sumT(count + 1, 0.0);
+    std::vector<double> sumTT(count + 1, 0.0);
+    for (int i = 0; i < count; ++i) {
+        const double t = double(m_scans.at(from + i).time - m_scans.at(from).time) / 86400.0;
+        sumT[i + 1] = sumT[i] + t;
+        sumTT[i + 1] = sumTT[i] + t * t;
+    }
+
+    struct Fit {
+        double n = 0, t = 0, tt = 0, s = 0, ts = 0;
+    };
+    std::vector<Fit> fits(sizes.size());
+    std::vector<int> runStart(sizes.size(), -1);
+    for (size_t id = 0; id < sizes.size(); ++id) {
+        if (sizes[id] != Absent) runStart[id] = 0;
+    }
+    auto endRun = [&](quint32 id, int at) {
+        const int start = runStart[id];
+        if (start < 0) return;
+        const double size = double(sizes[id]);
+        const double t = sumT[at] - sumT[start];
+        Fit &fit = fits[id];
+        fit.n += at - start;
+        fit.t += t;
+        fit.tt += sumTT[at] - sumTT[start];
+        fit.s += size * (at - start);
+        fit.ts += size * t;
+        runStart[id] = -1;
+    };
+
+    std::vector<quint8> listed;
+    for (int f = from + 1; f <= to; ++f) {
+        const int at = f - from;
+        auto set = [&](quint32 id, quint64 size) {
+            if (sizes[id] == size) return;
+            endRun(id, at);
+            sizes[id] = size;
+            runStart[id] = at;
+        };
+        auto remove = [&](quint32 id) {
+            endRun(id, at);
+            sizes[id] = Absent;
+        };
+        if (!m_frames.at(f).full) {
+            if (!decode(f, set, remove)) return {};
+            continue;
+        }
+        listed.assign(sizes.size(), 0);
+        if (!decode(f, [&](quint32 id, quint64 size) { listed[id] = 1; set(id, size); }, remove)) return {};
+        for (size_t id = 0; id < sizes.size(); ++id) {
+            if (!listed[id] && sizes[id] != Absent) remove(static_cast<quint32>(id));
+        }
+    }
+    for (size_t id = 0; id < sizes.size(); ++id) endRun(static_cast<quint32>(id), count);
+
+    for (size_t id = 0; id < sizes.size(); ++id) {
+        const bool was = before[id] != Absent;
+        const bool is = sizes[id] != Absent;
+        if (!was && !is) continue;
+
+        Change change;
+        change.path = m_paths.at(static_cast<qsizetype>(id));
+        change.status = was && is ? Status::Present : is ? Status::New : Status::Vanished;
+        change.beforeBytes = was ? before[id] : 0;
+        change.afterBytes = is ? sizes[id] : 0;
+        const Fit &fit = fits[id];
+        change.samples = static_cast<int>(fit.n);
+        const double denominator = fit.n * fit.tt - fit.t * fit.t;
+        if (fit.n >= 2 && denominator > 1e-9) change.bytesPerDay = (fit.n * fit.ts - fit.t * fit.s) / denominator;
+        changes.append(change);
+    }
+    return changes;
+}
+
+/*
+ * Writes the frame with a single write at the end of the last intact one, cutting
+ * off whatever a crashed append left behind. Only a file whose header shows it is
+ * no history (or a torn one) is started over; one that could not be opened or
+ * mapped is left alone and the append fails.
+ */
+bool ScanHistory::append(qint64 time, const QList<CacheFolderInfo> &caches) {
+    if (m_filePath.isEmpty()) return false;
+    if (!m_error.isEmpty() && !m_startOver) return false;
+
+    QByteArray names;
+    quint32 nameCount = 0;
+    quint64 totalBytes = 0;
+    QList<QPair<quint32, quint64>> current;
+    current.reserve(caches.size());
+    for (const CacheFolderInfo &info : caches) {
+        const QString path = info.path();
+        auto it = m_ids.constFind(path);
+        if (it == m_ids.constEnd()) {
+            it = m_ids.insert(path, static_cast<quint32>(m_paths.size()));
+            m_paths.append(path);
+            const QByteArray utf8 = path.toUtf8();
+            appendVarint(names, static_cast<quint64>(utf8.size()));
+            names.append(utf8);
+            ++nameCount;
+        }
+        current.append({it.value(), info.sizeBytes});
+        totalBytes += info.sizeBytes;
+    }
+    std::sort(current.begin(), current.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    current.erase(std::unique(current.begin(), current.end(), [](const auto &a, const auto &b) { return a.first == b.first; }),
+                  current.end());
+
+    std::vector<quint64> previous;
+    bool full = m_frames.size() % kKeyframeInterval == 0;
+    if (!full && !stateAt(static_cast<int>(m_frames.size()) - 1, previous)) full = true;
+
+    QByteArray payload;
+    if (full) {
+        appendVarint(payload, static_cast<quint64>(current.size()));
+        quint32 last = 0;
+        for (const auto &[id, size] : std::as_const(current)) {
+            appendVarint(payload, id - last);
+            appendVarint(payload, size);
+            last = id;
+        }
+    } else {
+        previous.resize(static_cast<size_t>(m_paths.size()), Absent); // series new in this scan
+        QByteArray changed;
+        quint64 changedCount = 0;
+        quint32 last = 0;
+        for (const auto &[id, size] : std::as_const(current)) {
+            if (previous[id] == size) {
+                previous[id] = Absent; // still there
+                continue;
+            }
+            appendVarint(changed, id - last);
+            appendVarint(changed, size);
+            last = id;
+            ++changedCount;
+            previous[id] = Absent;
+        }
+        appendVarint(payload, changedCount);
+        payload.append(changed);
+
+        // Whatever is left of the previous scan is gone
+        QByteArray removed;
+        quint64 removedCount = 0;
+        last = 0;
+        for (size_t id = 0; id < previous.size(); ++id) {
+            if (previous[id] == Absent) continue;
+            appendVarint(removed, id - last);
+            last = static_cast<quint32>(id);
+            ++removedCount;
+        }
+        appendVarint(payload, removedCount);
+        payload.append(removed);
+    }
+
+    FrameHeader frame = {};
+    frame.magic = kFrameMagic;
+    frame.flags = full ? kFullFrame : 0;
+    frame.time = time;
+    frame.totalBytes = totalBytes;
+    frame.cacheCount = static_cast<quint32>(current.size());
+    frame.nameCount = nameCount;
+    frame.namesSize = static_cast<quint32>(names.size());
+    frame.payloadSize = static_cast<quint32>(payload.size());
+    const QByteArray body = names + payload;
+    frame.checksum = checksumOf(reinterpret_cast<const uchar *>(body.constData()), body.size());
+
+    QByteArray block;
+    if (m_validEnd == 0) {
+        FileHeader header = {};
+        std::memcpy(header.magic, kHistoryMagic, 4);
+        header.version = kHistoryVersion;
+        block.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+    block.append(reinterpret_cast<const char *>(&frame), sizeof(frame));
+    block.append(body);
+
+    // Unmapped before the file grows
+    m_data = nullptr;
+    m_file.close();
+
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    QFile file(m_filePath);
+    bool ok = file.open(QIODevice::ReadWrite);
+    QString error;
+    if (ok && m_validEnd == 0 && !m_startOver && file.size() > 0) {
+        // Was missing or empty when indexed: whatever appeared since is not ours to cut
+        error = QStringLiteral("Written by someone else meanwhile");
+        ok = false;
+    }
+    if (ok && file.size() != m_validEnd) ok = file.resize(m_validEnd);
+    ok = ok && file.seek(m_validEnd) && file.write(block) == block.size() && file.flush();
+    if (!ok && error.isEmpty()) error = file.errorString();
+    file.close();
+
+    index();
+    if (!ok) m_error = error;
+    return ok;
+}
@@ -0,0 +1,106 @@
+#ifndef SCANHISTORY_H
+#define SCANHISTORY_H
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+#include "ScanTypes.h"
+
+/*
+ * Append-only time series of the cache sizes of every complete scan of one root.
+ *
+ * File layout (little endian, native struct layout):
+ *   FileHeader
+ *   then per scan: FrameHeader, names[nameCount], payload
+ *
+ * Every cache gets a series id the first time a scan reports it; its path is stored
+ * once, in that scan's names (varint length + UTF-8). Payloads are varints: a full
+ * frame lists every cache of the scan as (id delta, size) pairs in id order, a delta
+ * frame only the caches added or resized since the previous scan, then the ids of
+ * those gone. Every kKeyframeInterval-th frame is full, so any scan is rebuilt from
+ * at most that many frames, and a rescan in which little changed costs a few bytes.
+ *
+ * open() maps the file and hops from frame header to frame header, collecting the
+ * names; nothing else is decoded until a query needs it. A frame whose checksum
+ * fails ends the history there (a crash mid-append), and the next append cuts
+ * it off. A cache below a scan's minimum size counts as absent from that scan.
+ */
+class ScanHistory {
+public:
+    struct Scan {
+        qint64 time;        // seconds since the epoch
+        quint32 caches;
+        quint64 bytes;
+    };
+
+    enum class Status { Present, New, Vanished };
+
+    // One cache between two scans
+    struct Change {
+        QString path;
+        Status status = Status::Present;
+        quint64 beforeBytes = 0;  // 0 for new caches
+        quint64 afterBytes = 0;   // 0 for vanished ones
+        double bytesPerDay = 0;   // least-squares slope over the scans in between that had it
+        int samples = 0;          // those scans
+
+        qint64 changeBytes() const { return qint64(afterBytes) - qint64(beforeBytes); }
+    };
+
+    ScanHistory() = default;
+    ~ScanHistory();
+    ScanHistory(const ScanHistory &) = delete;
+    ScanHistory &operator=(const ScanHistory &) = delete;
+
+    // A missing file opens as an empty history
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const { return !m_filePath.isEmpty(); }
+    // Why open() or append() last failed
+    QString errorString() const { return m_error; }
+
+    // Oldest first
+    const QList<Scan> &scans() const { return m_scans; }
+    // Latest scan at or before `time`, the first one when all are later; -1 when empty
+    int scanAt(qint64 time) const;
+    // Every cache present in either scan; `from` must not be after `to`
+    QList<Change> compare(int from, int to) const;
+
+    // Records a complete scan's caches and keeps the history open. Starts over a file
+    // that is no history; fails without touching one that could not be read.
+    bool append(qint64 time, const QList<CacheFolderInfo> &caches);
+
+    static constexpr int kKeyframeInterval = 32;
+
+private:
+    struct Frame {
+        qint64 payloadOffset;
+        quint32 payloadSize;
+        bool full;
+    };
+
+    QString m_filePath;
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_validEnd = 0;         // end of the last intact frame, 0 when there is no header yet
+    QString m_error;
+    bool m_startOver = false;      // the header showed the file is no history: append() replaces it
+    QList<Scan> m_scans;
+    QList<Frame> m_frames;
+    QStringList m_paths;           // series id -> path
+    QHash<QString, quint32> m_ids;
+
+    static constexpr quint64 Absent = ~0ULL;
+
+    bool index();
+    bool stateAt(int frame, std::vector<quint64> &sizes) const;
+    // Calls `visit(id, size)` per listed cache, then `remove(id)` per cache a delta frame drops
+    template <typename Visit, typename Remove>
+    bool decode(int frame, Visit visit, Remove remove) const;
+};
+
+#endif // SCANHISTORY_H
@@ -0,0 +1,216 @@
+#include "ScanIndex.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+constexpr char kIndexMagic[4] = {'D', 'F', 'S', 'I'};
+constexpr quint32 kIndexVersion = 2;
+}
+
+ScanIndex::~ScanIndex() {
+    close();
+}
+
+bool ScanIndex::open(const QString &filePath) {
+    close();
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(sizeof(Header))) {
+        close();
+        return false;
+    }
+
+    const uchar *data = m_file.map(0, fileSize);
+    if (!data) {
+        close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+    const quint64 recordsEnd = sizeof(Header) + quint64(header.recordCount) * sizeof(Record);
+    if (std::memcmp(header.magic, kIndexMagic, 4) != 0 || header.version != kIndexVersion
+        || header.rootCount > header.recordCount || recordsEnd + header.namesSize != quint64(fileSize)) {
+        close();
+        return false;
+    }
+
+    m_records = reinterpret_cast<const Record *>(data + sizeof(Header));
+    m_recordCount = header.recordCount;
+    m_rootCount = header.rootCount;
+    m_names = reinterpret_cast<const char *>(data + recordsEnd);
+    m_namesSize = header.namesSize;
+    return true;
+}
+
+void ScanIndex::close() {
+    m_records = nullptr;
+    m_recordCount = 0;
+    m_rootCount = 0;
+    m_names = nullptr;
+    m_namesSize = 0;
+    if (m_file.isOpen()) m_file.close(); // also unmaps
+}
+
+QByteArray ScanIndex::nameBytes(qint32 index) const {
+    const Record &rec = m_records[index];
+    if (quint64(rec.nameOffset) + rec.nameLength > m_namesSize) return QByteArray();
+    return QByteArray::fromRawData(m_names + rec.nameOffset, rec.nameLength);
+}
+
+QString ScanIndex::name(qint32 index) const {
+    return QString::fromUtf8(nameBytes(index));
+}
+
+qint32 ScanIndex::findRoot(const QString &rootPath) const {
+    const QByteArray wanted = QDir::cleanPath(rootPath).toUtf8();
+    for (quint32 i = 0; i < m_rootCount; ++i) {
+        if (nameBytes(i) == wanted) return static_cast<qint32>(i);
+    }
+    return NoRecord;
+}
+
+// Children are written sorted by name, so this is a binary search.
+qint32 ScanIndex::findChild(qint32 parent, const QString &name) const {
+    if (!isOpen() || parent < 0) return NoRecord;
+    const Record &rec = m_records[parent];
+    if (quint64(rec.firstChild) + rec.childCount > m_recordCount) return NoRecord;
+
+    const QByteArray wanted = name.toUtf8();
+    quint32 lo = rec.firstChild;
+    quint32 hi = rec.firstChild + rec.childCount;
+    while (lo < hi) {
+        quint32 mid = lo + (hi - lo) / 2;
+        int cmp = nameBytes(mid).compare(wanted);
+        if (cmp == 0) return static_cast<qint32>(mid);
+        if (cmp < 0) lo = mid + 1; else hi = mid;
+    }
+    return NoRecord;
+}
+
+bool ScanIndex::matches(qint32 record, quint64 inode, qint64 mtimeNs) const {
+    if (!isOpen() || record < 0 || quint32(record) >= m_recordCount) return false;
+    const Record &rec = m_records[record];
+    return rec.inode == inode && rec.mtimeNs == mtimeNs
+        && quint64(rec.firstChild) + rec.childCount <= m_recordCount;
+}
+
+DirStat ScanIndex::statDirectory(const QString &path) {
+    DirStat result;
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::lstat(QFile::encodeName(path).constData(), &st) != 0 || !S_ISDIR(st.st_mode)) return result;
+    result.inode = static_cast<quint64>(st.st_ino);
+#ifdef Q_OS_DARWIN
+    result.mtimeNs = qint64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    result.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    result.size = static_cast<quint64>(st.st_size);
+    result.device = static_cast<quint64>(st.st_dev);
+#else
+    QFileInfo info(path);
+    if (!info.isDir() || info.isSymLink()) return result;
+    result.mtimeNs = info.lastModified().toMSecsSinceEpoch() * 1000000;
+    result.size = static_cast<quint64>(info.size());
+#endif
+    result.valid = true;
+    return result;
+}
+
+QString ScanIndex::joinPath(const QString &dir, const QString &name) {
+    return dir.endsWith(QLatin1Char('/')) ? dir + name : dir + QLatin1Char('/') + name;
+}
+
+ScanIndexBuilder::Node *ScanIndexBuilder::newNode(const QByteArray &name, const DirStat &stat) {
+    m_nodes.emplace_back();
+    Node *node = &m_nodes.back();
+    node->name = name;
+    node->inode = stat.inode;
+    node->mtimeNs = stat.mtimeNs;
+    return node;
+}
+
+ScanIndexBuilder::Node *ScanIndexBuilder::addRoot(const QString &path, const DirStat &stat) {
+    QMutexLocker locker(&m_mutex);
+    Node *node = newNode(QDir::cleanPath(path).toUtf8(), stat);
+    m_roots.append(node);
+    return node;
+}
+
+ScanIndexBuilder::Node *ScanIndexBuilder::addChild(Node *parent, const QString &name, const DirStat &stat) {
+    QMutexLocker locker(&m_mutex);
+    Node *node = newNode(name.toUtf8(), stat);
+    parent->children.append(node);
+    return node;
+}
+
+/*
+ * Lays the tree out breadth-first so every node's children occupy one contiguous
+ * run of records, then writes header, records and names through QSaveFile
+ * (write to temp + rename) so a crash never leaves a torn index behind.
+ */
+bool ScanIndexBuilder::write(const QString &filePath) {
+    QMutexLocker locker(&m_mutex);
+
+    QList<Node *> order = m_roots;
+    QList<ScanIndex::Record> records;
+    QByteArray names;
+    records.reserve(static_cast<qsizetype>(m_nodes.size()));
+
+    auto appendRecord = [&](Node *node) {
+        ScanIndex::Record rec = {};
+        rec.inode = node->inode;
+        rec.mtimeNs = node->mtimeNs;
+        rec.ownBytes = node->ownBytes;
+        rec.totalBytes = node->totalBytes;
+        rec.ownModified = node->ownModified;
+        rec.ownAccessed = node->ownAccessed;
+        rec.nameOffset = static_cast<quint32>(names.size());
+        rec.nameLength = static_cast<quint32>(node->name.size());
+        rec.flags = node->flags;
+        names.append(node->name);
+        records.append(rec);
+    };
+
+    for (Node *root : m_roots) appendRecord(root);
+
+    for (qsizetype i = 0; i < order.size(); ++i) {
+        Node *node = order[i];
+        std::sort(node->children.begin(), node->children.end(),
+                  [](const Node *a, const Node *b) { return a->name < b->name; });
+
+        records[i].firstChild = static_cast<quint32>(records.size());
+        records[i].childCount = static_cast<quint32>(node->children.size());
+        for (Node *child : node->children) {
+            appendRecord(child);
+            order.append(child);
+        }
+    }
+
+    ScanIndex::Header header = {};
+    std::memcpy(header.magic, kIndexMagic, 4);
+    header.version = kIndexVersion;
+    header.recordCount = static_cast<quint32>(records.size());
+    header.rootCount = static_cast<quint32>(m_roots.size());
+    header.namesSize = static_cast<quint64>(names.size());
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(records.constData()), records.size() * qsizetype(sizeof(ScanIndex::Record)));
+    file.write(names);
+    return file.commit();
+}
@@ -0,0 +1,128 @@
+#ifndef SCANINDEX_H
+#define SCANINDEX_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <deque>
+
+// Identity of a directory as seen by lstat(); inode is 0 where the platform has none.
+struct DirStat {
+    quint64 inode = 0;
+    qint64 mtimeNs = 0;
+    quint64 size = 0;
+    quint64 device = 0; // st_dev, not stored in the index
+    bool valid = false;
+};
+
+/*
+ * Read-only, memory-mapped index of the last completed scan.
+ *
+ * File layout (little endian, native struct layout):
+ *   Header
+ *   Record[recordCount]   roots first, then the children of every node stored contiguously
+ *   char names[]          UTF-8, not NUL-terminated; roots store the absolute path,
+ *                         every other record only its own directory name
+ *
+ * A directory whose inode and mtime still match its record has the same entries as
+ * last time, so its child list (and, for sized records, its own file bytes) can be
+ * reused without listing it. Files rewritten in place do not bump the directory
+ * mtime; such size drift is only picked up by a full rescan.
+ */
+class ScanIndex {
+public:
+    static constexpr qint32 NoRecord = -1;
+
+    enum Flag : quint32 {
+        ListedFlag = 0x1, // child list is complete
+        SizedFlag = 0x2   // ownBytes/totalBytes are valid
+    };
+
+    struct Header {
+        char magic[4];
+        quint32 version;
+        quint32 recordCount;
+        quint32 rootCount;
+        quint64 namesSize;
+    };
+
+    struct Record {
+        quint64 inode;
+        qint64 mtimeNs;
+        quint64 ownBytes;   // files and symlinks directly inside
+        quint64 totalBytes; // whole subtree, excluding the directory entry itself
+        qint64 ownModified; // newest mtime and atime of those files, seconds; 0 = none
+        qint64 ownAccessed;
+        quint32 nameOffset;
+        quint32 nameLength;
+        quint32 firstChild;
+        quint32 childCount;
+        quint32 flags;
+        quint32 reserved;
+    };
+
+    ScanIndex() = default;
+    ~ScanIndex();
+    ScanIndex(const ScanIndex &) = delete;
+    ScanIndex &operator=(const ScanIndex &) = delete;
+
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const { return m_records != nullptr; }
+
+    qint32 findRoot(const QString &rootPath) const;
+    qint32 findChild(qint32 parent, const QString &name) const;
+    bool matches(qint32 record, quint64 inode, qint64 mtimeNs) const;
+
+    const Record &record(qint32 index) const { return m_records[index]; }
+    QString name(qint32 index) const;
+
+    static DirStat statDirectory(const QString &path);
+    static QString joinPath(const QString &dir, const QString &name);
+
+private:
+    QFile m_file;
+    const Record *m_records = nullptr;
+    quint32 m_recordCount = 0;
+    quint32 m_rootCount = 0;
+    const char *m_names = nullptr;
+    quint64 m_namesSize = 0;
+
+    QByteArray nameBytes(qint32 index) const;
+};
+
+/*
+ * Collects the directory tree of the running scan and serializes it into the
+ * ScanIndex format. Nodes are filled in by the thread that owns the directory;
+ * only linking a child into its parent takes the lock.
+ */
+class ScanIndexBuilder {
+public:
+    struct Node {
+        QByteArray name;
+        quint64 inode = 0;
+        qint64 mtimeNs = 0;
+        quint64 ownBytes = 0;
+        quint64 totalBytes = 0;
+        qint64 ownModified = 0;
+        qint64 ownAccessed = 0;
+        quint32 flags = 0;
+        QList<Node *> children;
+    };
+
+    Node *addRoot(const QString &path, const DirStat &stat);
+    Node *addChild(Node *parent, const QString &name, const DirStat &stat);
+
+    bool write(const QString &filePath);
+
+private:
+    QMutex m_mutex;
+    std::deque<Node> m_nodes;
+    QList<Node *> m_roots;
+
+    Node *newNode(const QByteArray &name, const DirStat &stat);
+};
+
+#endif // SCANINDEX_H
@@ -0,0 +1,295 @@
+#include "ScanMetrics.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QSaveFile>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <deque>
+
+namespace {
+
+struct alignas(64) Slot {
+    std::atomic<quint64> counters[ScanMetrics::CounterCount] = {};
+    struct Timer {
+        std::atomic<quint64> buckets[ScanMetrics::BucketCount] = {};
+        std::atomic<quint64> count{0};
+        std::atomic<quint64> sumNs{0};
+    } timers[ScanMetrics::TimerCount];
+};
+
+struct Registry {
+    QMutex mutex;
+    std::deque<Slot> threadSlots; // deque: growing never moves existing slots
+};
+
+Registry &registry() {
+    static Registry instance;
+    return instance;
+}
+
+thread_local Slot *t_slot = nullptr;
+
+Slot &currentSlot() {
+    if (!t_slot) {
+        Registry &reg = registry();
+        QMutexLocker locker(&reg.mutex);
+        t_slot = &reg.threadSlots.emplace_back();
+    }
+    return *t_slot;
+}
+
+std::atomic<quint64> g_uiInFlight{0};
+std::atomic<quint64> g_uiInFlightMax{0};
+
+// Only the owning thread writes a slot, so a relaxed load + store is enough
+inline void bump(std::atomic<quint64> &value, quint64 amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct CounterInfo {
+    const char *name;
+    const char *help;
+};
+
+const CounterInfo kCounters[ScanMetrics::CounterCount] = {
+    {"dirs_opened", "Directories opened for listing."},
+    {"entries_read", "Directory entries read."},
+    {"stat_calls", "stat/statx calls and file size lookups."},
+    {"permission_errors", "Operations refused with EACCES or EPERM."},
+    {"other_errors", "Other failed file system operations."},
+    {"caches_sized", "Cache folders whose size was calculated."},
+    {"files_unlinked", "Files removed by the deletion service."},
+    {"dirs_removed", "Directories removed by the deletion service."},
+    {"bytes_freed", "Apparent size of the files removed by the deletion service."},
+    {"ui_batches", "Result batches emitted towards the UI."},
+    {"ui_batch_caches", "Caches carried by UI result batches."},
+    {"ui_progress_updates", "Progress snapshots emitted towards the UI."},
+};
+
+const CounterInfo kTimers[ScanMetrics::TimerCount] = {
+    {"list_directory", "Time to list one directory while scanning."},
+    {"size_cache", "Time to calculate the size of one cache folder."},
+    {"delete_path", "Time to delete one requested path."},
+};
+
+// Unsigned wrap-around makes subtraction exact as long as `from` is an earlier state of `into`
+void addValues(ScanMetrics::Values &into, const ScanMetrics::Values &from, bool subtract) {
+    auto apply = [subtract](quint64 &value, quint64 other) { value = subtract ? value - other : value + other; };
+    for (int i = 0; i < ScanMetrics::CounterCount; ++i) apply(into.counters[i], from.counters[i]);
+    for (int t = 0; t < ScanMetrics::TimerCount; ++t) {
+        ScanMetrics::Histogram &h = into.timers[t];
+        const ScanMetrics::Histogram &f = from.timers[t];
+        for (int b = 0; b < ScanMetrics::BucketCount; ++b) apply(h.buckets[b], f.buckets[b]);
+        apply(h.count, f.count);
+        apply(h.sumNs, f.sumNs);
+    }
+}
+
+QJsonObject valuesJson(const ScanMetrics::Values &values, bool withHistograms) {
+    QJsonObject object;
+    for (int i = 0; i < ScanMetrics::CounterCount; ++i) {
+        object[kCounters[i].name] = static_cast<qint64>(values.counters[i]);
+    }
+    for (int t = 0; t < ScanMetrics::TimerCount; ++t) {
+        const ScanMetrics::Histogram &h = values.timers[t];
+        QJsonObject timer;
+        timer["count"] = static_cast<qint64>(h.count);
+        timer["sum_seconds"] = h.sumNs / 1e9;
+        timer["p50_seconds"] = h.quantileSeconds(0.5);
+        timer["p99_seconds"] = h.quantileSeconds(0.99);
+        if (withHistograms) {
+            // Non-cumulative counts per bucket, keyed by the bucket's upper bound
+            QJsonObject buckets;
+            for (int b = 0; b < ScanMetrics::BucketCount; ++b) {
+                if (!h.buckets[b]) continue;
+                const QString le = b == ScanMetrics::BucketCount - 1
+                    ? QStringLiteral("+Inf") : QString::number(ScanMetrics::Histogram::bucketUpperSeconds(b), 'g', 6);
+                buckets[le] = static_cast<qint64>(h.buckets[b]);
+            }
+            timer["buckets"] = buckets;
+        }
+        object[kTimers[t].name] = timer;
+    }
+    return object;
+}
+
+QString formatSeconds(double seconds) {
+    if (seconds < 1e-3) return QString::number(seconds * 1e6, 'f', 0) + " us";
+    if (seconds < 1.0) return QString::number(seconds * 1e3, 'f', 1) + " ms";
+    return QString::number(seconds, 'f', 2) + " s";
+}
+
+}
+
+double ScanMetrics::Histogram::quantileSeconds(double q) const {
+    if (count == 0) return 0.0;
+    const quint64 rank = static_cast<quint64>(q * (count - 1)) + 1;
+    quint64 seen = 0;
+    for (int b = 0; b < BucketCount; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) return bucketUpperSeconds(b);
+    }
+    return bucketUpperSeconds(BucketCount - 1);
+}
+
+ScanMetrics::Snapshot ScanMetrics::Snapshot::operator-(const Snapshot &earlier) const {
+    Snapshot delta = *this;
+    addValues(delta.total, earlier.total, true);
+    for (int i = 0; i < qMin(delta.perThread.size(), earlier.perThread.size()); ++i) {
+        addValues(delta.perThread[i], earlier.perThread.at(i), true);
+    }
+    return delta;
+}
+
+void ScanMetrics::add(Counter counter, quint64 amount) {
+    bump(currentSlot().counters[counter], amount);
+}
+
+void ScanMetrics::record(Timer timer, qint64 elapsedNs) {
+    const quint64 ns = static_cast<quint64>(qMax<qint64>(0, elapsedNs));
+    const quint64 us = ns / 1000;
+    const int bucket = qMin(BucketCount - 1, static_cast<int>(std::bit_width(us)));
+
+    Slot::Timer &slot = currentSlot().timers[timer];
+    bump(slot.buckets[bucket], 1);
+    bump(slot.count, 1);
+    bump(slot.sumNs, ns);
+}
+
+void ScanMetrics::addError(int errorCode) {
+    add(errorCode == EACCES || errorCode == EPERM ? PermissionErrors : OtherErrors);
+}
+
+quint64 ScanMetrics::threadValue(Counter counter) {
+    return currentSlot().counters[counter].load(std::memory_order_relaxed);
+}
+
+void ScanMetrics::uiBatchQueued(int caches) {
+    add(UiBatches);
+    add(UiBatchCaches, static_cast<quint64>(caches));
+
+    const quint64 depth = g_uiInFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+    quint64 peak = g_uiInFlightMax.load(std::memory_order_relaxed);
+    while (depth > peak && !g_uiInFlightMax.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {}
+}
+
+void ScanMetrics::uiBatchDelivered() {
+    // Receivers may also get batches from emitters that do not count (e.g. the watcher)
+    quint64 depth = g_uiInFlight.load(std::memory_order_relaxed);
+    while (depth > 0 && !g_uiInFlight.compare_exchange_weak(depth, depth - 1, std::memory_order_relaxed)) {}
+}
+
+void ScanMetrics::resetPeaks() {
+    g_uiInFlightMax.store(g_uiInFlight.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+ScanMetrics::Snapshot ScanMetrics::snapshot() {
+    Snapshot result;
+    Registry &reg = registry();
+    QMutexLocker locker(&reg.mutex);
+    result.perThread.reserve(static_cast<qsizetype>(reg.threadSlots.size()));
+    for (const Slot &slot : reg.threadSlots) {
+        Values values;
+        for (int i = 0; i < CounterCount; ++i) values.counters[i] = slot.counters[i].load(std::memory_order_relaxed);
+        for (int t = 0; t < TimerCount; ++t) {
+            for (int b = 0; b < BucketCount; ++b) {
+                values.timers[t].buckets[b] = slot.timers[t].buckets[b].load(std::memory_order_relaxed);
+            }
+            values.timers[t].count = slot.timers[t].count.load(std::memory_order_relaxed);
+            values.timers[t].sumNs = slot.timers[t].sumNs.load(std::memory_order_relaxed);
+        }
+        addValues(result.total, values, false);
+        result.perThread.append(values);
+    }
+    result.uiBatchesInFlightMax = g_uiInFlightMax.load(std::memory_order_relaxed);
+    return result;
+}
+
+QString ScanMetrics::summary(const Snapshot &snapshot) {
+    const Values &v = snapshot.total;
+    const Histogram &list = v.timers[ListDirectory];
+    const Histogram &size = v.timers[SizeCache];
+
+    QStringList lines;
+    lines << QString("Directories opened: %1, entries read: %2, stat calls: %3")
+                 .arg(v.counters[DirsOpened]).arg(v.counters[EntriesRead]).arg(v.counters[StatCalls]);
+    lines << QString("Errors: %1 permission, %2 other")
+                 .arg(v.counters[PermissionErrors]).arg(v.counters[OtherErrors]);
+    lines << QString("Listing: %1 dirs, p50 %2, p99 %3")
+                 .arg(list.count).arg(formatSeconds(list.quantileSeconds(0.5)), formatSeconds(list.quantileSeconds(0.99)));
+    lines << QString("Sizing: %1 caches in %2, p50 %3, p99 %4")
+                 .arg(size.count).arg(formatSeconds(size.sumNs / 1e9),
+                                      formatSeconds(size.quantileSeconds(0.5)), formatSeconds(size.quantileSeconds(0.99)));
+    lines << QString("UI: %1 batches (%2 caches), %3 progress updates, max %4 batches queued")
+                 .arg(v.counters[UiBatches]).arg(v.counters[UiBatchCaches])
+                 .arg(v.counters[UiProgressUpdates]).arg(snapshot.uiBatchesInFlightMax);
+    if (v.timers[DeletePath].count > 0) {
+        lines << QString("Deletion: %1 files, %2 dirs, %3 paths in %4")
+                     .arg(v.counters[FilesUnlinked]).arg(v.counters[DirsRemoved])
+                     .arg(v.timers[DeletePath].count).arg(formatSeconds(v.timers[DeletePath].sumNs / 1e9));
+    }
+    return lines.join('\n');
+}
+
+QJsonObject ScanMetrics::toJson(const Snapshot &snapshot) {
+    QJsonObject object = valuesJson(snapshot.total, true);
+    object["ui_batches_in_flight_max"] = static_cast<qint64>(snapshot.uiBatchesInFlightMax);
+
+    // Threads that did nothing in this window are left out
+    QJsonArray threads;
+    for (int i = 0; i < snapshot.perThread.size(); ++i) {
+        const Values &values = snapshot.perThread.at(i);
+        bool active = false;
+        for (quint64 counter : values.counters) active |= counter != 0;
+        for (const Histogram &h : values.timers) active |= h.count != 0;
+        if (!active) continue;
+        QJsonObject thread = valuesJson(values, false);
+        thread["thread"] = i;
+        threads.append(thread);
+    }
+    object["threads"] = threads;
+    return object;
+}
+
+QByteArray ScanMetrics::toPrometheus(const Snapshot &snapshot) {
+    QByteArray out;
+    for (int i = 0; i < CounterCount; ++i) {
+        const QByteArray name = QByteArray("dfcache_") + kCounters[i].name + "_total";
+        out += "# HELP " + name + ' ' + kCounters[i].help + '\n';
+        out += "# TYPE " + name + " counter\n";
+        out += name + ' ' + QByteArray::number(snapshot.total.counters[i]) + '\n';
+    }
+    for (int t = 0; t < TimerCount; ++t) {
+        const QByteArray name = QByteArray("dfcache_") + kTimers[t].name + "_seconds";
+        const Histogram &h = snapshot.total.timers[t];
+        out += "# HELP " + name + ' ' + kTimers[t].help + '\n';
+        out += "# TYPE " + name + " histogram\n";
+        quint64 cumulative = 0;
+        for (int b = 0; b < BucketCount - 1; ++b) {
+            cumulative += h.buckets[b];
+            out += name + "_bucket{le=\"" + QByteArray::number(Histogram::bucketUpperSeconds(b), 'g', 6) + "\"} "
+                   + QByteArray::number(cumulative) + '\n';
+        }
+        out += name + "_bucket{le=\"+Inf\"} " + QByteArray::number(h.count) + '\n';
+        out += name + "_sum " + QByteArray::number(h.sumNs / 1e9, 'g', 9) + '\n';
+        out += name + "_count " + QByteArray::number(h.count) + '\n';
+    }
+    out += "# HELP dfcache_ui_batches_in_flight_max Most result batches waiting for the UI at once.\n";
+    out += "# TYPE dfcache_ui_batches_in_flight_max gauge\n";
+    out += "dfcache_ui_batches_in_flight_max " + QByteArray::number(snapshot.uiBatchesInFlightMax) + '\n';
+    return out;
+}
+
+bool ScanMetrics::writeFile(const QString &filePath, const Snapshot &snapshot) {
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    const QByteArray data = filePath.endsWith(".json", Qt::CaseInsensitive)
+        ? QJsonDocument(toJson(snapshot)).toJson(QJsonDocument::Indented) : toPrometheus(snapshot);
+    if (file.write(data) != data.size()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
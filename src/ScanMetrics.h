@@ -0,0 +1,102 @@
+#ifndef SCANMETRICS_H
+#define SCANMETRICS_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <array>
+
+/*
+ * Process-wide counters and timing histograms for the scan, sizing and deletion
+ * hot paths.
+ *
+ * Every thread writes only to its own cache-line aligned slot (found through a
+ * thread_local pointer), so recording is a relaxed add without contention. Slots
+ * are never freed: totals stay monotonic across threads coming and going, as
+ * Prometheus counters expect. A scan summary is the difference of two snapshots.
+ *
+ * Histograms use power-of-two microsecond buckets: bucket i counts durations
+ * below 2^i us, the last one everything longer.
+ */
+class ScanMetrics {
+public:
+    enum Counter {
+        DirsOpened,         // directories opened for listing
+        EntriesRead,        // directory entries returned by readdir/getdents
+        StatCalls,          // stat/statx/fstatat calls and QFileInfo size lookups
+        PermissionErrors,   // EACCES/EPERM while opening, listing or removing
+        OtherErrors,
+        CachesSized,
+        FilesUnlinked,
+        DirsRemoved,
+        BytesFreed,         // apparent size of the files unlinked
+        UiBatches,          // cachesFound batches emitted towards the UI
+        UiBatchCaches,      // caches carried by those batches
+        UiProgressUpdates,
+        CounterCount
+    };
+
+    enum Timer {
+        ListDirectory,      // one scanner directory listing
+        SizeCache,          // one calculateDirectorySize() call
+        DeletePath,         // one requested path, from start to result
+        TimerCount
+    };
+
+    static constexpr int BucketCount = 32;
+
+    struct Histogram {
+        std::array<quint64, BucketCount> buckets{};
+        quint64 count = 0;
+        quint64 sumNs = 0;
+
+        static double bucketUpperSeconds(int bucket) { return double(1ULL << bucket) / 1e6; }
+        double quantileSeconds(double q) const;
+    };
+
+    struct Values {
+        std::array<quint64, CounterCount> counters{};
+        std::array<Histogram, TimerCount> timers{};
+    };
+
+    struct Snapshot {
+        Values total;
+        QList<Values> perThread; // index = slot number, in order of first use
+        quint64 uiBatchesInFlightMax = 0;
+
+        Snapshot operator-(const Snapshot &earlier) const;
+    };
+
+    // Times its own scope into one histogram
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Timer timer) : m_timer(timer) { m_elapsed.start(); }
+        ~ScopedTimer() { ScanMetrics::record(m_timer, m_elapsed.nsecsElapsed()); }
+    private:
+        Timer m_timer;
+        QElapsedTimer m_elapsed;
+    };
+
+    static void add(Counter counter, quint64 amount = 1);
+    static void record(Timer timer, qint64 elapsedNs);
+    static void addError(int errorCode); // sorts errno into permission / other
+    // The calling thread's own total, without taking a snapshot
+    static quint64 threadValue(Counter counter);
+
+    // UI queue depth: batches emitted by a scanner but not yet handled by the receiver
+    static void uiBatchQueued(int caches);
+    static void uiBatchDelivered();
+    static void resetPeaks();
+
+    static Snapshot snapshot();
+
+    static QString summary(const Snapshot &snapshot);
+    static QJsonObject toJson(const Snapshot &snapshot);
+    static QByteArray toPrometheus(const Snapshot &snapshot);
+    // JSON when the file name ends in .json, Prometheus text otherwise
+    static bool writeFile(const QString &filePath, const Snapshot &snapshot);
+};
+
+#endif // SCANMETRICS_H
@@ -0,0 +1,58 @@
+#ifndef SCANTYPES_H
+#define SCANTYPES_H
+
+#include <QString>
+#include <QList>
+#include <memory>
+
+#include "PathStore.h"
+
+class SizeTree;
+
+struct CacheFolderInfo {
+    static constexpr quint64 UnknownSize = ~0ULL;
+
+    PathStore::Id pathId;                       // in PathStore::shared()
+    quint64 sizeBytes;                          // apparent size
+    quint64 reclaimableBytes = UnknownSize;     // only measured with allocated accounting
+    std::shared_ptr<SizeTree> tree;             // only built with size trees enabled
+    qint64 lastModified = 0;                    // newest of any entry inside, seconds since the epoch; 0 = unknown
+    qint64 lastAccessed = 0;                    // newest file access, see DirectorySizer::EntryTimes
+
+    QString path() const { return PathStore::shared().path(pathId); }
+    // Writing a file is using it too, also where access times are not kept (noatime)
+    qint64 lastUsed() const { return qMax(lastModified, lastAccessed); }
+};
+
+// Coalesced scan progress, emitted at a fixed rate instead of once per directory
+struct ScanProgress {
+    QString currentPath;
+    quint64 dirsVisited = 0;
+    double dirsPerSecond = 0.0;
+    quint64 cachesFound = 0;
+    quint64 bytesFound = 0;
+    qint64 elapsedMs = 0;
+};
+
+// Totals of one scan for one device (see DeviceScheduler)
+struct DeviceScanStats {
+    QString mountPoint;
+    QString fsType;
+    QString kind;               // ssd, hdd, network, pseudo or unknown
+    int concurrency = 0;        // worker limit on this device
+    int peakConcurrency = 0;
+    quint64 dirs = 0;
+    quint64 caches = 0;
+    quint64 bytes = 0;
+    quint64 skippedMounts = 0;  // pseudo filesystems, or other devices with one-filesystem
+    double busySeconds = 0;     // worker time spent listing and sizing here
+    double dirsPerSecond = 0;   // over the whole scan's wall-clock time
+};
+
+// Directories one prune rule kept the scan and sizing out of (see PruneRules)
+struct PruneRuleStats {
+    QString rule;
+    quint64 dirs = 0;
+};
+
+#endif // SCANTYPES_H
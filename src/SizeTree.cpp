@@ -0,0 +1,152 @@
+#include "SizeTree.h"
+#include <QFile>
+#include <QStringList>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kInitialSlots = 4096; // power of two
+
+}
+
+SizeTree::SizeTree(const QString &rootPath)
+    : m_rootPath(rootPath), m_count(0), m_complete(false), m_nameCount(0) {
+    addNode(NoNode, "", 0, 0, Directory);
+}
+
+// FNV-1a; names are short and this runs once per entry
+size_t SizeTree::hashName(const char *name, size_t length) {
+    quint64 hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+quint32 SizeTree::intern(const char *name, size_t length) {
+    length = std::min<size_t>(length, 0xffff);
+    if ((m_nameCount + 1) * 4 > m_slots.size() * 3) growSlots();
+
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = hashName(name, length) & mask;; i = (i + 1) & mask) {
+        const quint32 slot = m_slots[i];
+        if (slot == 0) {
+            const quint32 offset = static_cast<quint32>(m_names.size());
+            const quint16 stored = static_cast<quint16>(length);
+            m_names.insert(m_names.end(), reinterpret_cast<const char *>(&stored), reinterpret_cast<const char *>(&stored) + 2);
+            m_names.insert(m_names.end(), name, name + length);
+            m_slots[i] = offset + 1;
+            ++m_nameCount;
+            return offset;
+        }
+        quint16 stored;
+        std::memcpy(&stored, m_names.data() + slot - 1, 2);
+        if (stored == length && std::memcmp(m_names.data() + slot + 1, name, length) == 0) return slot - 1;
+    }
+}
+
+void SizeTree::growSlots() {
+    std::vector<quint32> old;
+    old.swap(m_slots);
+    m_slots.assign(old.empty() ? kInitialSlots : old.size() * 2, 0);
+
+    const size_t mask = m_slots.size() - 1;
+    for (quint32 slot : old) {
+        if (slot == 0) continue;
+        quint16 length;
+        std::memcpy(&length, m_names.data() + slot - 1, 2);
+        size_t i = hashName(m_names.data() + slot + 1, length) & mask;
+        while (m_slots[i] != 0) i = (i + 1) & mask;
+        m_slots[i] = slot;
+    }
+}
+
+quint32 SizeTree::addNode(quint32 parent, const char *name, size_t length, quint64 sizeBytes, quint32 flags) {
+    if ((m_count >> kChunkBits) == m_chunks.size()) {
+        m_chunks.push_back(std::make_unique<Node[]>(size_t(1) << kChunkBits));
+    }
+
+    const quint32 index = m_count++;
+    Node &node = mutableNode(index);
+    node.sizeBytes = sizeBytes;
+    node.name = intern(name, length);
+    node.parent = parent;
+    node.firstChild = NoNode;
+    node.nextSibling = NoNode;
+    node.items = 1;
+    node.flags = flags;
+    if (parent != NoNode) {
+        Node &parentNode = mutableNode(parent);
+        node.nextSibling = parentNode.firstChild;
+        parentNode.firstChild = index;
+    }
+    return index;
+}
+
+void SizeTree::addToSubtree(quint32 index, quint64 sizeBytes, quint32 items) {
+    Node &node = mutableNode(index);
+    node.sizeBytes += sizeBytes;
+    node.items += items;
+}
+
+qsizetype SizeTree::memoryBytes() const {
+    return static_cast<qsizetype>(m_chunks.size() * (sizeof(Node) << kChunkBits)
+                                  + m_names.capacity() + m_slots.size() * sizeof(quint32));
+}
+
+QString SizeTree::name(quint32 index) const {
+    if (index == root()) return m_rootPath;
+    const quint32 offset = node(index).name;
+    quint16 length;
+    std::memcpy(&length, m_names.data() + offset, 2);
+    return QFile::decodeName(QByteArray(m_names.data() + offset + 2, length));
+}
+
+QString SizeTree::path(quint32 index) const {
+    QStringList parts;
+    for (quint32 i = index; i != root(); i = node(i).parent) {
+        parts.prepend(name(i));
+    }
+    parts.prepend(m_rootPath);
+    return parts.join('/');
+}
+
+QList<quint32> SizeTree::children(quint32 index) const {
+    QList<quint32> result;
+    for (quint32 child = node(index).firstChild; child != NoNode; child = node(child).nextSibling) {
+        result.append(child);
+    }
+    std::stable_sort(result.begin(), result.end(), [this](quint32 a, quint32 b) {
+        return node(a).sizeBytes > node(b).sizeBytes;
+    });
+    return result;
+}
+
+void SizeTree::remove(quint32 index) {
+    const Node removed = node(index);
+    if (index == root()) {
+        // The cache itself is gone: keep an empty root
+        Node &rootNode = mutableNode(index);
+        rootNode.sizeBytes = 0;
+        rootNode.items = 1;
+        rootNode.firstChild = NoNode;
+        return;
+    }
+
+    Node &parent = mutableNode(removed.parent);
+    if (parent.firstChild == index) {
+        parent.firstChild = removed.nextSibling;
+    } else {
+        quint32 sibling = parent.firstChild;
+        while (node(sibling).nextSibling != index) sibling = node(sibling).nextSibling;
+        mutableNode(sibling).nextSibling = removed.nextSibling;
+    }
+
+    for (quint32 i = removed.parent; i != NoNode; i = node(i).parent) {
+        Node &ancestor = mutableNode(i);
+        ancestor.sizeBytes -= std::min(ancestor.sizeBytes, removed.sizeBytes);
+        ancestor.items -= std::min(ancestor.items, removed.items);
+    }
+}
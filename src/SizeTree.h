@@ -0,0 +1,81 @@
+#ifndef SIZETREE_H
+#define SIZETREE_H
+
+#include <QList>
+#include <QString>
+#include <memory>
+#include <vector>
+
+/*
+ * Size tree of one cache folder, ncdu style: every file and directory below it is
+ * a node holding the apparent size of its subtree.
+ *
+ * Nodes are 32 bytes, linked by index and allocated from fixed chunks of 64K, so
+ * they never move while the tree grows. Names are interned in one byte pool
+ * (length-prefixed, in the filesystem's encoding) behind an open-addressing table,
+ * so the thousands of "index", "package.json" or hash-prefix directories of a
+ * typical cache are stored once. A million entries take roughly 40 MB.
+ *
+ * DirectorySizer::buildTree fills it in one post-order pass: a directory's total
+ * is added once its last child is done. Afterwards only remove() changes it, and
+ * only on the thread that owns it.
+ */
+class SizeTree {
+public:
+    static constexpr quint32 NoNode = ~0u;
+    enum Flag : quint32 { Directory = 1, Unreadable = 2 };
+
+    struct Node {
+        quint64 sizeBytes;    // whole subtree
+        quint32 name;         // offset into the name pool
+        quint32 parent;
+        quint32 firstChild;
+        quint32 nextSibling;
+        quint32 items;        // nodes in the subtree, this one included
+        quint32 flags;
+    };
+    static_assert(sizeof(Node) == 32, "SizeTree nodes must stay 32 bytes");
+
+    explicit SizeTree(const QString &rootPath);
+
+    // Builder side: nodes are prepended to their parent's child list
+    quint32 addNode(quint32 parent, const char *name, size_t length, quint64 sizeBytes, quint32 flags);
+    void addToSubtree(quint32 index, quint64 sizeBytes, quint32 items);
+    void setComplete(bool complete) { m_complete = complete; }
+
+    quint32 root() const { return 0; }
+    bool isComplete() const { return m_complete; }
+    const QString &rootPath() const { return m_rootPath; }
+    const Node &node(quint32 index) const { return m_chunks[index >> kChunkBits][index & kChunkMask]; }
+    qsizetype nodeCount() const { return m_count; }
+    qsizetype memoryBytes() const;
+
+    QString name(quint32 index) const;
+    QString path(quint32 index) const;
+    // Largest first
+    QList<quint32> children(quint32 index) const;
+
+    // Forgets a deleted subtree: unlinks it and takes its size off every ancestor.
+    // Its nodes stay allocated until the tree goes away.
+    void remove(quint32 index);
+
+private:
+    static constexpr int kChunkBits = 16;
+    static constexpr quint32 kChunkMask = (1u << kChunkBits) - 1;
+
+    QString m_rootPath;
+    std::vector<std::unique_ptr<Node[]>> m_chunks;
+    quint32 m_count;
+    bool m_complete;
+
+    std::vector<char> m_names;     // [quint16 length][bytes] per distinct name
+    std::vector<quint32> m_slots;  // name offset + 1, 0 = empty
+    quint32 m_nameCount;
+
+    Node &mutableNode(quint32 index) { return m_chunks[index >> kChunkBits][index & kChunkMask]; }
+    quint32 intern(const char *name, size_t length);
+    void growSlots();
+    static size_t hashName(const char *name, size_t length);
+};
+
+#endif // SIZETREE_H
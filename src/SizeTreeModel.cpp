@@ -0,0 +1,179 @@
+#include "SizeTreeModel.h"
+#include "ResultsModel.h"
+#include <QBrush>
+#include <QStringList>
+
+SizeTreeModel::SizeTreeModel(std::shared_ptr<SizeTree> tree, QObject *parent)
+    : QAbstractItemModel(parent), m_tree(std::move(tree)) {
+    m_rowOf.insert(m_tree->root(), 0);
+}
+
+const QList<quint32> &SizeTreeModel::childrenOf(quint32 node) const {
+    auto it = m_children.find(node);
+    if (it == m_children.end()) {
+        it = m_children.insert(node, m_tree->children(node));
+        for (int row = 0; row < it->size(); ++row) {
+            m_rowOf.insert(it->at(row), row);
+        }
+    }
+    return *it;
+}
+
+QModelIndex SizeTreeModel::indexOf(quint32 node, int column) const {
+    return createIndex(m_rowOf.value(node), column, static_cast<quintptr>(node));
+}
+
+QModelIndex SizeTreeModel::index(int row, int column, const QModelIndex &parent) const {
+    if (column < 0 || column >= ColumnCount || row < 0) return QModelIndex();
+    if (!parent.isValid()) return row == 0 ? indexOf(m_tree->root(), column) : QModelIndex();
+
+    const QList<quint32> &children = childrenOf(static_cast<quint32>(parent.internalId()));
+    if (row >= children.size()) return QModelIndex();
+    return createIndex(row, column, static_cast<quintptr>(children.at(row)));
+}
+
+QModelIndex SizeTreeModel::parent(const QModelIndex &child) const {
+    if (!child.isValid()) return QModelIndex();
+    const quint32 parentNode = m_tree->node(static_cast<quint32>(child.internalId())).parent;
+    return parentNode == SizeTree::NoNode ? QModelIndex() : indexOf(parentNode);
+}
+
+int SizeTreeModel::rowCount(const QModelIndex &parent) const {
+    if (!parent.isValid()) return 1;
+    if (parent.column() != NameColumn) return 0;
+    return static_cast<int>(childrenOf(static_cast<quint32>(parent.internalId())).size());
+}
+
+int SizeTreeModel::columnCount(const QModelIndex &) const {
+    return ColumnCount;
+}
+
+// Answered from the node itself so the view can draw expanders without sorting anything
+bool SizeTreeModel::hasChildren(const QModelIndex &parent) const {
+    if (!parent.isValid()) return true;
+    if (parent.column() != NameColumn) return false;
+    return m_tree->node(static_cast<quint32>(parent.internalId())).firstChild != SizeTree::NoNode;
+}
+
+QVariant SizeTreeModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid()) return QVariant();
+    const quint32 nodeIndex = static_cast<quint32>(index.internalId());
+    const SizeTree::Node &node = m_tree->node(nodeIndex);
+    const bool unreadable = node.flags & SizeTree::Unreadable;
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case NameColumn: {
+            const QString name = m_tree->name(nodeIndex);
+            return (node.flags & SizeTree::Directory) && nodeIndex != m_tree->root() ? name + '/' : name;
+        }
+        case SizeColumn: return ResultsModel::formatSize(node.sizeBytes);
+        case ShareColumn: {
+            if (node.parent == SizeTree::NoNode) return QVariant();
+            const quint64 total = m_tree->node(node.parent).sizeBytes;
+            return total == 0 ? QStringLiteral("0 %") : QString::number(100.0 * node.sizeBytes / total, 'f', 1) + " %";
+        }
+        case ItemsColumn:
+            return (node.flags & SizeTree::Directory) ? QVariant(node.items - 1) : QVariant();
+        }
+        break;
+    case Qt::TextAlignmentRole:
+        if (index.column() != NameColumn) return int(Qt::AlignRight | Qt::AlignVCenter);
+        break;
+    case Qt::ToolTipRole:
+        if (unreadable) return QStringLiteral("Could not be opened; its size is unknown");
+        break;
+    case Qt::ForegroundRole:
+        if (unreadable) return QBrush(QColor(140, 140, 140));
+        break;
+    }
+    return QVariant();
+}
+
+QVariant SizeTreeModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractItemModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case NameColumn: return QStringLiteral("Name");
+    case SizeColumn: return QStringLiteral("Size");
+    case ShareColumn: return QStringLiteral("Of Parent");
+    case ItemsColumn: return QStringLiteral("Items");
+    }
+    return QVariant();
+}
+
+QString SizeTreeModel::pathAt(const QModelIndex &index) const {
+    return index.isValid() ? m_tree->path(static_cast<quint32>(index.internalId())) : QString();
+}
+
+bool SizeTreeModel::isRoot(const QModelIndex &index) const {
+    return index.isValid() && static_cast<quint32>(index.internalId()) == m_tree->root();
+}
+
+bool SizeTreeModel::isDirectory(const QModelIndex &index) const {
+    return index.isValid() && (m_tree->node(static_cast<quint32>(index.internalId())).flags & SizeTree::Directory);
+}
+
+quint32 SizeTreeModel::findPath(const QString &path) const {
+    const QString &rootPath = m_tree->rootPath();
+    if (path == rootPath) return m_tree->root();
+    if (!path.startsWith(rootPath + '/')) return SizeTree::NoNode;
+
+    quint32 node = m_tree->root();
+    const QStringList parts = path.mid(rootPath.size() + 1).split('/', Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        quint32 match = SizeTree::NoNode;
+        for (quint32 child = m_tree->node(node).firstChild; child != SizeTree::NoNode; child = m_tree->node(child).nextSibling) {
+            if (m_tree->name(child) == part) {
+                match = child;
+                break;
+            }
+        }
+        if (match == SizeTree::NoNode) return SizeTree::NoNode;
+        node = match;
+    }
+    return node;
+}
+
+bool SizeTreeModel::removePath(const QString &path) {
+    const quint32 node = findPath(path);
+    if (node == SizeTree::NoNode) return false;
+    if (node == m_tree->root()) {
+        beginResetModel();
+        m_tree->remove(node);
+        m_children.clear();
+        m_rowOf.clear();
+        m_rowOf.insert(m_tree->root(), 0);
+        endResetModel();
+        return true;
+    }
+
+    const quint32 parentNode = m_tree->node(node).parent;
+    if (!m_children.contains(parentNode)) {
+        // Never expanded, so no view row exists for it
+        m_tree->remove(node);
+    } else {
+        QList<quint32> &siblings = m_children[parentNode];
+        const int row = m_rowOf.value(node);
+        beginRemoveRows(indexOf(parentNode), row, row);
+        m_tree->remove(node);
+        siblings.removeAt(row);
+        for (int i = row; i < siblings.size(); ++i) {
+            m_rowOf.insert(siblings.at(i), i);
+        }
+        endRemoveRows();
+        if (!siblings.isEmpty()) {
+            emit dataChanged(index(0, ShareColumn, indexOf(parentNode)),
+                             index(static_cast<int>(siblings.size()) - 1, ShareColumn, indexOf(parentNode)));
+        }
+    }
+
+    // Every ancestor lost the subtree's size; their own order among siblings stays until reopened
+    for (quint32 ancestor = parentNode; ancestor != SizeTree::NoNode; ancestor = m_tree->node(ancestor).parent) {
+        if (!m_rowOf.contains(ancestor)) continue;
+        emit dataChanged(indexOf(ancestor, SizeColumn), indexOf(ancestor, ItemsColumn));
+    }
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef SIZETREEMODEL_H
+#define SIZETREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QList>
+#include <memory>
+
+#include "SizeTree.h"
+
+/*
+ * Drill-down view of one cache's SizeTree. The only top-level row is the cache
+ * itself; children are listed largest first. Child lists are sorted the first time
+ * a directory is expanded and kept, so a tree with millions of nodes costs nothing
+ * beyond the parts that were actually looked at.
+ */
+class SizeTreeModel : public QAbstractItemModel {
+    Q_OBJECT
+public:
+    enum Column { NameColumn = 0, SizeColumn, ShareColumn, ItemsColumn, ColumnCount };
+
+    explicit SizeTreeModel(std::shared_ptr<SizeTree> tree, QObject *parent = nullptr);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    const std::shared_ptr<SizeTree> &tree() const { return m_tree; }
+    QString pathAt(const QModelIndex &index) const;
+    bool isRoot(const QModelIndex &index) const;
+    bool isDirectory(const QModelIndex &index) const;
+
+    // Drops a subtree that was deleted on disk; false when `path` is not below the root
+    bool removePath(const QString &path);
+
+private:
+    std::shared_ptr<SizeTree> m_tree;
+    mutable QHash<quint32, QList<quint32>> m_children; // sorted child lists of expanded nodes
+    mutable QHash<quint32, int> m_rowOf;               // node -> row below its parent
+
+    const QList<quint32> &childrenOf(quint32 node) const;
+    QModelIndex indexOf(quint32 node, int column = 0) const;
+    quint32 findPath(const QString &path) const;
+};
+
+#endif // SIZETREEMODEL_H
@@ -0,0 +1,304 @@
+#include "StagingPurger.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStorageInfo>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#endif
+
+StagingPurger::StagingPurger(QObject *parent)
+    : QObject(parent), m_deleter(new DeletionService(this)), m_counter(0) {
+    const QString appDataLocation = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    m_journalPath = appDataLocation + "/purge-journal.json";
+    m_defaultStagingDir = appDataLocation + "/" + StagingDirName;
+
+    // One thread at the lowest CPU and I/O priority: freeing space is never urgent
+    m_deleter->setThreadCount(1);
+    m_deleter->setLowPriority(true);
+    connect(m_deleter, &DeletionService::progress, this, [this](quint64 bytesFreed, quint64) {
+        emit progress(bytesFreed, pendingCount());
+    });
+    connect(m_deleter, &DeletionService::pathFinished, this, &StagingPurger::onPathFinished);
+    connect(m_deleter, &DeletionService::finished, this, &StagingPurger::onDeleterFinished);
+    loadJournal();
+}
+
+StagingPurger::~StagingPurger() {
+    // Whatever is left stays journalled for the next resume()
+    m_deleter->cancel();
+}
+
+void StagingPurger::cancel() {
+    m_deleter->cancel();
+}
+
+QStringList StagingPurger::stage(const QStringList &paths) {
+    QStringList notStaged;
+    QList<Entry> planned;
+    const QDateTime now = QDateTime::currentDateTime();
+    for (const QString &path : paths) {
+        const QString cleanPath = QDir::cleanPath(path);
+        const QString dir = stagingDirFor(cleanPath);
+        if (dir.isEmpty() || cleanPath == dir || cleanPath.startsWith(dir + '/') || !makeStagingDir(dir)) {
+            notStaged.append(path);
+            continue;
+        }
+
+        // Keeps the folder's name recognisable and never collides with an earlier entry
+        Entry entry;
+        entry.stagedPath = QString("%1/%2-%3-%4").arg(dir).arg(now.toMSecsSinceEpoch()).arg(m_counter++)
+                                                 .arg(QFileInfo(cleanPath).fileName());
+        entry.originalPath = path;
+        entry.stagedAt = now;
+        planned.append(entry);
+        if (!m_stagingDirs.contains(dir)) m_stagingDirs.append(dir);
+    }
+    if (planned.isEmpty()) return notStaged;
+
+    for (const Entry &entry : planned) m_entries.insert(entry.stagedPath, entry);
+    writeJournal();
+
+    QStringList staged;
+    for (const Entry &entry : planned) {
+        if (renameDir(entry.originalPath, entry.stagedPath)) {
+            staged.append(entry.stagedPath);
+        } else {
+            m_entries.remove(entry.stagedPath);
+            notStaged.append(entry.originalPath);
+        }
+    }
+    if (staged.size() != planned.size()) writeJournal();
+
+    purge(staged);
+    return notStaged;
+}
+
+void StagingPurger::resume() {
+    QStringList leftovers;
+    bool changed = false;
+    for (const QString &dir : std::as_const(m_stagingDirs)) {
+        // Swapped for someone else's directory or a link since: nothing in it is ours to purge
+        if (!isPrivateDir(dir)) continue;
+        const QFileInfoList children = QDir(dir).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot
+                                                               | QDir::Hidden | QDir::System);
+        for (const QFileInfo &child : children) {
+            const QString path = child.filePath();
+            if (!child.isDir() || child.isSymLink()) {
+                // Only folders are staged; anything else is a stray and goes right away
+                QFile::remove(path);
+                continue;
+            }
+            if (!m_entries.contains(path)) {
+                // Renamed just before the journal could record it
+                Entry entry;
+                entry.stagedPath = path;
+                entry.stagedAt = child.lastModified();
+                m_entries.insert(path, entry);
+                changed = true;
+            }
+            leftovers.append(path);
+        }
+    }
+
+    // Journalled but never renamed, or purged just before the journal could forget it
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (leftovers.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_entries.erase(it);
+            changed = true;
+        }
+    }
+    if (changed) writeJournal();
+
+    if (leftovers.isEmpty()) {
+        onDeleterFinished(false);
+        return;
+    }
+    purge(leftovers);
+}
+
+void StagingPurger::purge(const QStringList &stagedPaths) {
+    if (stagedPaths.isEmpty()) return;
+    m_deleter->start(stagedPaths);
+}
+
+void StagingPurger::onPathFinished(const DeletionResult &result) {
+    const Entry entry = m_entries.value(result.path);
+    if (result.success) {
+        m_entries.remove(result.path);
+        writeJournal();
+    } else {
+        qWarning() << "Failed to purge" << result.path << ":" << result.error;
+    }
+    emit purged(entry.originalPath, result.success);
+}
+
+// Staging directories with nothing left in them are removed and forgotten
+void StagingPurger::onDeleterFinished(bool cancelled) {
+    if (cancelled) return;
+
+    QStringList stillUsed;
+    for (const Entry &entry : std::as_const(m_entries)) stillUsed.append(QFileInfo(entry.stagedPath).absolutePath());
+
+    bool changed = false;
+    for (auto it = m_stagingDirs.begin(); it != m_stagingDirs.end();) {
+        if (!stillUsed.contains(*it) && (QDir().rmdir(*it) || !QFileInfo::exists(*it))) {
+            it = m_stagingDirs.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    if (changed) writeJournal();
+    emit idle();
+}
+
+/*
+ * A rename only works within one filesystem. The app data directory is preferred when
+ * it is on the cache's; otherwise the staging directory goes into the highest writable
+ * directory above the cache on that filesystem, so every cache on it shares one.
+ * Shared directories such as /tmp are passed over: another user could have put a
+ * directory or a link of their own under the staging name there.
+ */
+QString StagingPurger::stagingDirFor(const QString &path) {
+    const QStorageInfo storage(path);
+    if (!storage.isValid()) return QString();
+    const QString root = storage.rootPath();
+    auto it = m_stagingByRoot.constFind(root);
+    if (it != m_stagingByRoot.constEnd()) return *it;
+
+    QString dir;
+    if (QDir().mkpath(QFileInfo(m_defaultStagingDir).absolutePath()) && makeStagingDir(m_defaultStagingDir)
+        && QStorageInfo(m_defaultStagingDir).rootPath() == root) {
+        dir = m_defaultStagingDir;
+    } else {
+        QString highest;
+        QDir up(QFileInfo(path).absolutePath());
+        for (;;) {
+            const QString current = up.absolutePath();
+            if (!current.startsWith(root) || QStorageInfo(current).rootPath() != root) break;
+            if (QFileInfo(current).isWritable() && !isSharedDir(current)) highest = current;
+            if (up.isRoot() || !up.cdUp()) break;
+        }
+        if (!highest.isEmpty() && makeStagingDir(QDir(highest).filePath(StagingDirName))) {
+            dir = QDir(highest).filePath(StagingDirName);
+        }
+    }
+    m_stagingByRoot.insert(root, dir);
+    return dir;
+}
+
+// World-writable or sticky, like /tmp: anyone may create entries in it
+bool StagingPurger::isSharedDir(const QString &dir) {
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(dir).constData(), &st) != 0) return true;
+    return (st.st_mode & (S_IWOTH | S_ISVTX)) != 0;
+#else
+    Q_UNUSED(dir);
+    return false;
+#endif
+}
+
+/*
+ * A real directory (not a link to one) owned by the caller, and then mode 0700. One an
+ * earlier version created with the default mode is tightened through its descriptor,
+ * so a link swapped in meanwhile is never followed.
+ */
+bool StagingPurger::isPrivateDir(const QString &dir) {
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::lstat(QFile::encodeName(dir).constData(), &st) != 0) return false;
+    if (!S_ISDIR(st.st_mode) || st.st_uid != ::geteuid()) return false;
+    if ((st.st_mode & 07777) == S_IRWXU) return true;
+
+    const int fd = ::open(QFile::encodeName(dir).constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return false;
+    const bool ok = ::fstat(fd, &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == ::geteuid()
+                    && ::fchmod(fd, S_IRWXU) == 0;
+    ::close(fd);
+    return ok;
+#else
+    const QFileInfo info(dir);
+    return info.isDir() && !info.isSymLink();
+#endif
+}
+
+// mkdir rather than mkpath, so nothing is created on the way, and checked afterwards:
+// an existing entry under that name may belong to someone else
+bool StagingPurger::makeStagingDir(const QString &dir) {
+#ifdef Q_OS_UNIX
+    if (::mkdir(QFile::encodeName(dir).constData(), S_IRWXU) != 0 && errno != EEXIST) return false;
+#else
+    QDir().mkdir(dir);
+#endif
+    if (isPrivateDir(dir)) return true;
+    qWarning() << "Not staging into" << dir << ": not a private directory of this user";
+    return false;
+}
+
+bool StagingPurger::renameDir(const QString &from, const QString &to) {
+#ifdef Q_OS_UNIX
+    // A plain rename(2): fails with EXDEV instead of copying, and moves a symlink rather than its target
+    return std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#else
+    return QDir().rename(from, to);
+#endif
+}
+
+void StagingPurger::loadJournal() {
+    QFile file(m_journalPath);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    for (const QJsonValue &value : root["staging"].toArray()) {
+        const QString dir = value.toString();
+        if (!dir.isEmpty() && !m_stagingDirs.contains(dir)) m_stagingDirs.append(dir);
+    }
+    for (const QJsonValue &value : root["entries"].toArray()) {
+        const QJsonObject object = value.toObject();
+        Entry entry;
+        entry.stagedPath = object["staged"].toString();
+        entry.originalPath = object["original"].toString();
+        entry.stagedAt = QDateTime::fromMSecsSinceEpoch(object["staged_at"].toInteger());
+        if (!entry.stagedPath.isEmpty()) m_entries.insert(entry.stagedPath, entry);
+    }
+}
+
+// Small and written at most once per stage() batch or purged folder, so synchronously
+void StagingPurger::writeJournal() const {
+    QDir().mkpath(QFileInfo(m_journalPath).absolutePath());
+
+    QJsonArray staging;
+    for (const QString &dir : m_stagingDirs) staging.append(dir);
+    QJsonArray entries;
+    for (const Entry &entry : m_entries) {
+        QJsonObject object;
+        object["staged"] = entry.stagedPath;
+        object["original"] = entry.originalPath;
+        object["staged_at"] = entry.stagedAt.toMSecsSinceEpoch();
+        entries.append(object);
+    }
+
+    QJsonObject root;
+    root["staging"] = staging;
+    root["entries"] = entries;
+
+    QSaveFile file(m_journalPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson()) < 0 || !file.commit()) {
+        qWarning() << "Failed to save the purge journal to" << m_journalPath << ":" << file.errorString();
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef STAGINGPURGER_H
+#define STAGINGPURGER_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "DeletionService.h"
+
+/*
+ * Instant deletion. stage() renames each cache folder into a staging directory on
+ * its own filesystem, which takes a moment however big the folder is, and a
+ * low-priority DeletionService purges the staged folders in the background.
+ *
+ * The staging directory is .dfcache-staging in the app data directory when that is
+ * on the same filesystem, otherwise in the highest writable directory above the
+ * cache that still is, leaving out world-writable and sticky ones. It must be a real
+ * directory owned by the user with mode 0700, or nothing is staged into it and the
+ * caches are deleted in place. Scans skip directories with that name.
+ *
+ * The journal (purge-journal.json next to favorites.json) lists the staging
+ * directories in use and what was moved into each. It is written before any rename,
+ * so resume() finds every staged folder after a crash or an early exit, including
+ * one that was renamed but never journalled.
+ */
+class StagingPurger : public QObject {
+    Q_OBJECT
+public:
+    static constexpr const char *StagingDirName = ".dfcache-staging";
+
+    explicit StagingPurger(QObject *parent = nullptr);
+    ~StagingPurger();
+
+    // Returns the paths that could not be staged (no staging directory on their
+    // filesystem, mount points, ...); delete those in place
+    QStringList stage(const QStringList &paths);
+    // Purges whatever an earlier run left in the staging directories
+    void resume();
+    void cancel();
+
+    bool isPurging() const { return m_deleter->isRunning(); }
+    int pendingCount() const { return static_cast<int>(m_entries.size()); }
+
+signals:
+    void progress(quint64 bytesFreed, int remaining);
+    // Failed purges stay staged and are retried by the next resume()
+    void purged(const QString &originalPath, bool success);
+    void idle();
+
+private:
+    struct Entry {
+        QString stagedPath;
+        QString originalPath; // empty when found in a staging directory but not in the journal
+        QDateTime stagedAt;
+    };
+
+    DeletionService *m_deleter;
+    QString m_journalPath;
+    QString m_defaultStagingDir;
+    QStringList m_stagingDirs;
+    QHash<QString, Entry> m_entries;          // by staged path
+    QHash<QString, QString> m_stagingByRoot;  // volume root -> staging directory, empty = none
+    quint64 m_counter;
+
+    QString stagingDirFor(const QString &path);
+    static bool isSharedDir(const QString &dir);
+    static bool isPrivateDir(const QString &dir);
+    static bool makeStagingDir(const QString &dir);
+    void purge(const QStringList &stagedPaths);
+    void onPathFinished(const DeletionResult &result);
+    void onDeleterFinished(bool cancelled);
+    void loadJournal();
+    void writeJournal() const;
+    static bool renameDir(const QString &from, const QString &to);
+};
+
+#endif // STAGINGPURGER_H
@@ -0,0 +1,51 @@
+#ifndef WORKSTEALINGQUEUE_H
+#define WORKSTEALINGQUEUE_H
+
+#include <QList>
+#include <QMutex>
+
+/*
+ * Per-worker job queue used by the parallel scanner.
+ * The owning worker pushes and pops at the back (LIFO, keeps the walk depth-first
+ * and cache-friendly), idle workers steal from the front, which tends to hand
+ * them the largest unexplored subtrees.
+ */
+template <typename T>
+class WorkStealingQueue {
+public:
+    void push(T item) {
+        QMutexLocker locker(&m_mutex);
+        m_items.append(std::move(item));
+    }
+
+    bool pop(T &out) {
+        QMutexLocker locker(&m_mutex);
+        if (m_items.isEmpty()) return false;
+        out = m_items.takeLast();
+        return true;
+    }
+
+    bool steal(T &out) {
+        QMutexLocker locker(&m_mutex);
+        if (m_items.isEmpty()) return false;
+        out = m_items.takeFirst();
+        return true;
+    }
+
+    // Front first
+    QList<T> items() const {
+        QMutexLocker locker(&m_mutex);
+        return m_items;
+    }
+
+    qsizetype size() const {
+        QMutexLocker locker(&m_mutex);
+        return m_items.size();
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QList<T> m_items;
+};
+
+#endif // WORKSTEALINGQUEUE_H
@@ -0,0 +1,231 @@
+#include "CliRunner.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QStandardPaths>
+#include <cstdio>
+
+namespace {
+
+// Plain bytes, or a number with a K/M/G/T suffix (powers of 1024)
+bool parseSize(const QString &text, quint64 &bytes) {
+    QString number = text.trimmed().toUpper();
+    if (number.endsWith('B')) number.chop(1);
+
+    quint64 unit = 1;
+    if (!number.isEmpty()) {
+        switch (number.back().toLatin1()) {
+        case 'K': unit = 1ULL << 10; break;
+        case 'M': unit = 1ULL << 20; break;
+        case 'G': unit = 1ULL << 30; break;
+        case 'T': unit = 1ULL << 40; break;
+        default: break;
+        }
+        if (unit != 1) number.chop(1);
+    }
+
+    bool ok = false;
+    const double value = number.toDouble(&ok);
+    if (!ok || value < 0) return false;
+    bytes = static_cast<quint64>(value * unit);
+    return true;
+}
+
+int usageError(const QString &message) {
+    std::fprintf(stderr, "%s\n", qPrintable(message));
+    return 2;
+}
+
+// Lock and default checkpoint of unattended runs, named like the GUI's per-root state files
+QString unattendedStatePath(const QString &rootPath, const char *suffix) {
+    const QByteArray key = QDir::cleanPath(rootPath).toUtf8();
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/unattended/"
+           + QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex().left(16) + suffix;
+}
+
+constexpr double kLowImpactOpsPerSecond = 1000;
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("DFCacheDelete");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Finds cache folders and streams them as NDJSON, one JSON object per line.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("root", "Directory to scan.");
+
+    QCommandLineOption minSizeOption({"m", "min-size"}, "Only report caches of at least <size> (bytes, or with K/M/G/T suffix).", "size", "50M");
+    QCommandLineOption threadsOption({"j", "threads"}, "Worker threads for scanning and deleting, 0 = one per core.", "count", "0");
+    QCommandLineOption progressOption("progress", "Also emit progress lines.");
+    QCommandLineOption deleteOption("delete", "Delete every reported cache once the scan is done.");
+    QCommandLineOption dryRunOption("dry-run", "With --delete, only report what would be deleted.");
+    QCommandLineOption indexOption("index", "Scan index to reuse and update for incremental rescans.", "file");
+    QCommandLineOption patternOption({"p", "pattern"}, "Cache folder pattern, repeatable: substring, =exact, glob, or a path tail like .gradle/caches (default: cache).", "pattern");
+    QCommandLineOption allocatedOption("allocated", "Also report reclaimable bytes: allocated blocks, hardlinked files counted once and only when all links are inside the cache.");
+    QCommandLineOption treeOption("tree", "Add each cache's size tree, <depth> levels deep, largest 20 entries per folder.", "depth");
+    QCommandLineOption oneFileSystemOption({"x", "one-file-system"}, "Do not descend into other filesystems, also while sizing caches.");
+    QCommandLineOption perDeviceOption("per-device", "Workers allowed on one device at a time, 0 = by device kind (2 for disks and network mounts).", "count", "0");
+    QCommandLineOption sizeBackendOption("size-backend", "How caches are sized: auto, native, qt or uring (io_uring batches, native when unavailable).", "backend", "auto");
+    QCommandLineOption queueDepthOption("queue-depth", "Operations per io_uring batch with --size-backend uring.", "count",
+                                        QString::number(DirectorySizer::kDefaultQueueDepth));
+    QCommandLineOption metricsOption("metrics", "Emit a metrics line with I/O counters and timings after each phase.");
+    QCommandLineOption metricsFileOption("metrics-file", "Write metrics on exit: JSON if <file> ends in .json, Prometheus text otherwise.", "file");
+    QCommandLineOption checkpointOption("checkpoint", "Save the scan's progress to <file> periodically and continue from it when the same scan is run again.", "file");
+    QCommandLineOption excludeOption("exclude", "Skip directories without reading them, repeatable: /full/path, a name or glob like .git, a path tail like .git/objects, or !/full/path to scan a path an exclusion covers. Adds to the rules saved for this root.", "rule");
+    QCommandLineOption noSavedRulesOption("no-saved-rules", "Ignore the skip rules saved in prune-rules.json.");
+    QCommandLineOption checkpointIntervalOption("checkpoint-interval", "Seconds between checkpoints.", "seconds", "60");
+    QCommandLineOption historyOption("history", "Append the cache sizes of every complete scan to <file>, the same file for every run of this root.", "file");
+    QCommandLineOption trendOption("trend", "With --history, report how each cache grew since the scan <days> days ago (at least the previous one).", "days");
+    QCommandLineOption lowImpactOption("low-impact", "Idle I/O class and a nice level for the whole run, and at most 1000 file system operations per second unless --max-ops or --max-bytes sets the ceiling.");
+    QCommandLineOption niceOption("nice", "Nice level with --low-impact.", "level", "19");
+    QCommandLineOption maxOpsOption("max-ops", "Ceiling on file system operations per second (directory opens, stats, unlinks); lowered further while operations take longer than the latency target.", "count");
+    QCommandLineOption maxBytesOption("max-bytes", "Ceiling on bytes deleted per second (bytes, or with K/M/G/T suffix).", "size");
+    QCommandLineOption latencyTargetOption("latency-target", "Per-operation latency above which a throttled run slows down (default: 4x the quietest latency seen, at least 1 ms).", "ms");
+    QCommandLineOption olderThanOption("older-than", "With --delete, only delete caches with nothing inside changed for <days> days.", "days");
+    QCommandLineOption freeOption("free", "With --delete, only delete the fewest, oldest and largest caches on the root's volume that free <size>; favorites are kept.", "size");
+    QCommandLineOption keepFreeOption("keep-free", "Like --free, for whatever is missing to <size> available on the root's volume.", "size");
+    QCommandLineOption maxRuntimeOption("max-runtime", "Stop after <minutes>. A scan cut short deletes nothing; with a checkpoint the next run continues it.", "minutes");
+    QCommandLineOption unattendedOption("unattended", "For cron jobs and systemd timers: implies --low-impact, a checkpoint and a history per root, and exits at once while another unattended run of the same root is still going.");
+    parser.addOptions({minSizeOption, threadsOption, progressOption, deleteOption, dryRunOption, indexOption,
+                       patternOption, allocatedOption, treeOption, oneFileSystemOption, perDeviceOption, sizeBackendOption,
+                       queueDepthOption, metricsOption, metricsFileOption, checkpointOption, checkpointIntervalOption,
+                       historyOption, trendOption,
+                       excludeOption, noSavedRulesOption, lowImpactOption, niceOption, maxOpsOption, maxBytesOption,
+                       latencyTargetOption, olderThanOption, freeOption, keepFreeOption, maxRuntimeOption, unattendedOption});
+    parser.process(app);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1) return usageError("Expected exactly one root directory; see --help.");
+
+    CliRunner::Options options;
+    options.rootPath = QDir(positional.first()).absolutePath();
+    if (!QFileInfo(options.rootPath).isDir()) return usageError("Not a directory: " + positional.first());
+
+    if (!parseSize(parser.value(minSizeOption), options.minSizeBytes)) {
+        return usageError("Invalid --min-size: " + parser.value(minSizeOption));
+    }
+
+    bool ok = false;
+    options.threads = parser.value(threadsOption).toInt(&ok);
+    if (!ok || options.threads < 0) return usageError("Invalid --threads: " + parser.value(threadsOption));
+
+    options.progress = parser.isSet(progressOption);
+    options.deleteFound = parser.isSet(deleteOption);
+    options.dryRun = parser.isSet(dryRunOption);
+    options.indexPath = parser.value(indexOption);
+    options.allocated = parser.isSet(allocatedOption);
+    if (parser.isSet(treeOption)) {
+        options.treeDepth = parser.value(treeOption).toInt(&ok);
+        if (!ok || options.treeDepth < 1) return usageError("Invalid --tree: " + parser.value(treeOption));
+    }
+    options.oneFileSystem = parser.isSet(oneFileSystemOption);
+    options.perDevice = parser.value(perDeviceOption).toInt(&ok);
+    if (!ok || options.perDevice < 0) return usageError("Invalid --per-device: " + parser.value(perDeviceOption));
+    const QString backend = parser.value(sizeBackendOption).toLower();
+    if (backend == "native") options.sizeBackend = DirectorySizer::Backend::Native;
+    else if (backend == "qt") options.sizeBackend = DirectorySizer::Backend::QtIterator;
+    else if (backend == "uring") options.sizeBackend = DirectorySizer::Backend::IoUring;
+    else if (backend != "auto") return usageError("Invalid --size-backend: " + parser.value(sizeBackendOption));
+    options.queueDepth = parser.value(queueDepthOption).toUInt(&ok);
+    if (!ok || options.queueDepth < 1 || options.queueDepth > 4096) {
+        return usageError("Invalid --queue-depth: " + parser.value(queueDepthOption));
+    }
+    if (parser.isSet(patternOption)) {
+        options.cachePatterns = parser.values(patternOption);
+        if (CacheMatcher(options.cachePatterns).isEmpty()) return usageError("--pattern must not be empty.");
+    }
+    if (!parser.isSet(noSavedRulesOption)) options.pruneRules = PruneRules::configuredRules(options.rootPath);
+    options.pruneRules += parser.values(excludeOption);
+    options.metrics = parser.isSet(metricsOption);
+    options.metricsFile = parser.value(metricsFileOption);
+    options.checkpointPath = parser.value(checkpointOption);
+    options.checkpointInterval = parser.value(checkpointIntervalOption).toInt(&ok);
+    if (!ok || options.checkpointInterval < 1) {
+        return usageError("Invalid --checkpoint-interval: " + parser.value(checkpointIntervalOption));
+    }
+    options.historyPath = parser.value(historyOption);
+    if (parser.isSet(trendOption)) {
+        options.trendDays = parser.value(trendOption).toInt(&ok);
+        if (!ok || options.trendDays < 1) return usageError("Invalid --trend: " + parser.value(trendOption));
+    }
+    if (options.dryRun && !options.deleteFound) return usageError("--dry-run only makes sense with --delete.");
+
+    if (parser.isSet(maxOpsOption)) {
+        options.throttle.opsPerSecond = parser.value(maxOpsOption).toDouble(&ok);
+        if (!ok || options.throttle.opsPerSecond <= 0) return usageError("Invalid --max-ops: " + parser.value(maxOpsOption));
+    }
+    if (parser.isSet(maxBytesOption)) {
+        quint64 bytes = 0;
+        if (!parseSize(parser.value(maxBytesOption), bytes) || bytes == 0) {
+            return usageError("Invalid --max-bytes: " + parser.value(maxBytesOption));
+        }
+        options.throttle.bytesPerSecond = static_cast<double>(bytes);
+    }
+    if (parser.isSet(latencyTargetOption)) {
+        options.throttle.latencyTargetMs = parser.value(latencyTargetOption).toDouble(&ok);
+        if (!ok || options.throttle.latencyTargetMs <= 0) {
+            return usageError("Invalid --latency-target: " + parser.value(latencyTargetOption));
+        }
+    }
+    if (parser.isSet(olderThanOption)) {
+        options.olderThanDays = parser.value(olderThanOption).toInt(&ok);
+        if (!ok || options.olderThanDays < 1) return usageError("Invalid --older-than: " + parser.value(olderThanOption));
+        if (!options.deleteFound) return usageError("--older-than only makes sense with --delete.");
+    }
+    if (parser.isSet(freeOption) && parser.isSet(keepFreeOption)) return usageError("Use either --free or --keep-free.");
+    if (parser.isSet(freeOption)) {
+        if (!parseSize(parser.value(freeOption), options.freeBytes) || options.freeBytes == 0) {
+            return usageError("Invalid --free: " + parser.value(freeOption));
+        }
+        if (!options.deleteFound) return usageError("--free only makes sense with --delete.");
+    }
+    if (parser.isSet(keepFreeOption)) {
+        if (!parseSize(parser.value(keepFreeOption), options.keepAvailableBytes) || options.keepAvailableBytes == 0) {
+            return usageError("Invalid --keep-free: " + parser.value(keepFreeOption));
+        }
+        if (!options.deleteFound) return usageError("--keep-free only makes sense with --delete.");
+    }
+    if (parser.isSet(maxRuntimeOption)) {
+        const int minutes = parser.value(maxRuntimeOption).toInt(&ok);
+        if (!ok || minutes < 1) return usageError("Invalid --max-runtime: " + parser.value(maxRuntimeOption));
+        options.maxRuntimeSeconds = minutes * 60;
+    }
+
+    // Held until exit. Only a dead owner makes it stale, never its age: runs may take hours
+    const bool unattended = parser.isSet(unattendedOption);
+    QLockFile lock(unattendedStatePath(options.rootPath, ".lock"));
+    lock.setStaleLockTime(0);
+    if (unattended) {
+        QDir().mkpath(QFileInfo(lock.fileName()).absolutePath());
+        if (!lock.tryLock(0)) {
+            std::printf("{\"type\":\"skipped\",\"reason\":\"another unattended run of this root is still going\"}\n");
+            return 0;
+        }
+        if (options.checkpointPath.isEmpty()) options.checkpointPath = unattendedStatePath(options.rootPath, ".ckpt");
+        if (options.historyPath.isEmpty()) options.historyPath = unattendedStatePath(options.rootPath, ".hist");
+    }
+    if (options.trendDays > 0 && options.historyPath.isEmpty()) return usageError("--trend needs --history.");
+
+    if (unattended || parser.isSet(lowImpactOption)) {
+        const int niceLevel = parser.value(niceOption).toInt(&ok);
+        if (!ok || niceLevel < -20 || niceLevel > 19) return usageError("Invalid --nice: " + parser.value(niceOption));
+        // Before any worker thread exists, so every one of them inherits it
+        QString error;
+        if (!IoThrottle::lowerProcessPriority(niceLevel, &error)) {
+            std::fprintf(stderr, "Could not lower the process priority: %s\n", qPrintable(error));
+        }
+        if (options.throttle.opsPerSecond <= 0 && options.throttle.bytesPerSecond <= 0) {
+            options.throttle.opsPerSecond = kLowImpactOpsPerSecond;
+        }
+    }
+
+    CliRunner runner(options);
+    QObject::connect(&runner, &CliRunner::finished, &app, &QCoreApplication::exit, Qt::QueuedConnection);
+    runner.start();
+    return app.exec();
+}